@@ -0,0 +1,42 @@
+#!/usr/bin/env bash
+#
+# Compares the semispace collector with the mark-region one. For each, prints
+# the run time with the default heap and the smallest heap, in 8KB steps, that
+# the workload completes in.
+#
+# The workload keeps a fixed set of objects alive while every round leaves
+# garbage behind and holds on to its newest list until the next one, so
+# survivors end up scattered between dead objects.
+#
+# Usage: benchmarks/gc_footprint.sh (from the repository root, after `make`)
+
+set -e
+
+VM=vm/target/debug/vm
+PROGRAM=.build/benchmarks/GcFootprint.owlc
+STEP=8192
+
+compiler/target/debug/owlc benchmarks -o .build/benchmarks
+
+fits() {
+  OWL_GC=$1 OWL_HEAP_SIZE=$2 $VM $PROGRAM > /dev/null 2>&1
+}
+
+for mode in semispace immix; do
+  echo "== $mode"
+
+  TIMEFORMAT="time=%Rs"
+  time OWL_GC=$mode $VM $PROGRAM | grep collections
+
+  low=1
+  high=32
+  while [ $low -lt $high ]; do
+    mid=$(( (low + high) / 2 ))
+    if fits $mode $(( mid * STEP )); then
+      high=$mid
+    else
+      low=$(( mid + 1 ))
+    fi
+  done
+  echo "smallest heap=$(( low * STEP )) bytes"
+done
@@ -0,0 +1,20 @@
+#!/usr/bin/env bash
+#
+# Compares the native List.map, filter, reduce, each, contains?, find and
+# reverse with the Owl versions they replaced. Both run the same workload from
+# ListFunctions, which prints a total that has to match between the two.
+#
+# Usage: benchmarks/list_functions.sh (from the repository root, after `make`)
+
+set -e
+
+VM=vm/target/debug/vm
+
+compiler/target/debug/owlc benchmarks -o .build/benchmarks
+
+for program in ListFunctions ListFunctionsInterpreted; do
+  echo "== $program"
+
+  TIMEFORMAT="time=%Rs"
+  time OWL_LOAD_PATH=.build/benchmarks $VM .build/benchmarks/$program.owlc
+done
@@ -0,0 +1,21 @@
+#!/usr/bin/env bash
+#
+# Compares List.sum, max, index_of and list equality, which go through the int
+# kernels for lists of ints, with the same functions built on List.reduce and
+# List.nth. Both run the same workload from ListNumeric, which prints a total
+# that has to match between the two.
+#
+# Usage: benchmarks/list_numeric.sh (from the repository root, after `make`)
+
+set -e
+
+VM=vm/target/debug/vm
+
+compiler/target/debug/owlc benchmarks -o .build/benchmarks
+
+for program in ListNumeric ListNumericReduce; do
+  echo "== $program"
+
+  TIMEFORMAT="time=%Rs"
+  time OWL_LOAD_PATH=.build/benchmarks $VM .build/benchmarks/$program.owlc
+done
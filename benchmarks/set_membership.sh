@@ -0,0 +1,21 @@
+#!/usr/bin/env bash
+#
+# Compares Set with deduplicating lists and testing membership with
+# List.contains?, which is what programs did before there were sets. Both run
+# the same workload from SetMembership, which prints a total that has to match
+# between the two.
+#
+# Usage: benchmarks/set_membership.sh (from the repository root, after `make`)
+
+set -e
+
+VM=vm/target/debug/vm
+
+compiler/target/debug/owlc benchmarks -o .build/benchmarks
+
+for program in SetMembership SetMembershipList; do
+  echo "== $program"
+
+  TIMEFORMAT="time=%Rs"
+  time OWL_LOAD_PATH=.build/benchmarks $VM .build/benchmarks/$program.owlc
+done
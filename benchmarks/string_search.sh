@@ -0,0 +1,20 @@
+#!/usr/bin/env bash
+#
+# Compares the substring search behind String.contains?, index_of and split
+# with strstr and with the memchr loop that String.contains? used before, over
+# haystacks and needles of several sizes, see vm/tools/string_search_bench.c.
+# Arguments are passed on to it.
+#
+# The tool is built here with optimisations rather than with the VM, which is
+# built with AddressSanitizer, and that intercepts strstr, memchr and memcmp.
+#
+# Usage: benchmarks/string_search.sh [bytes to search per cell] (from the repository root)
+
+set -e
+
+BENCH=.build/benchmarks/string_search_bench
+
+mkdir -p .build/benchmarks
+cc -O2 -std=c99 -D_DEFAULT_SOURCE -Ivm/src vm/tools/string_search_bench.c vm/src/util/string_search.c -o $BENCH
+
+$BENCH "$@"
@@ -34,6 +34,72 @@ impl fmt::Display for VarRef {
     }
 }
 
+/// A literal made up of nothing but other literals. The VM builds each one once,
+/// when the module is loaded, outside of the garbage collected heap.
+#[derive(Debug, Eq, PartialEq, Clone)]
+pub enum Constant {
+    Int(u16),
+    True,
+    False,
+    Nil,
+    Str(String),
+    Tuple(Vec<Constant>),
+    List(Vec<Constant>),
+}
+
+impl Constant {
+    #[allow(unused_must_use)]
+    fn emit<T: Write>(&self, out: &mut T) {
+        match self {
+            &Constant::Int(val) => {
+                out.write(&[opcodes::CONST_INT]);
+                out.write(&int_bytes(val));
+            }
+            &Constant::True => { out.write(&[opcodes::CONST_TRUE]); }
+            &Constant::False => { out.write(&[opcodes::CONST_FALSE]); }
+            &Constant::Nil => { out.write(&[opcodes::CONST_NIL]); }
+            &Constant::Str(ref content) => {
+                out.write(&[opcodes::CONST_STRING, content.len() as u8 + 1]); // +1 accounts for null termination
+                out.write(&content.as_bytes());
+                out.write(&[0]);
+            }
+            &Constant::Tuple(ref elems) => {
+                out.write(&[opcodes::CONST_TUPLE, elems.len() as u8]);
+                for elem in elems { elem.emit(out); }
+            }
+            &Constant::List(ref elems) => {
+                out.write(&[opcodes::CONST_LIST, elems.len() as u8]);
+                for elem in elems { elem.emit(out); }
+            }
+        }
+    }
+}
+
+impl fmt::Display for Constant {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        match self {
+            &Constant::Int(val) => write!(f, "{}", val),
+            &Constant::True => write!(f, "true"),
+            &Constant::False => write!(f, "false"),
+            &Constant::Nil => write!(f, "nil"),
+            &Constant::Str(ref content) => write!(f, "\"{}\"", content),
+            &Constant::Tuple(ref elems) => {
+                let elems: Vec<_> = elems.iter().map(|elem| format!("{}", elem)).collect();
+                write!(f, "({})", elems.join(", "))
+            }
+            &Constant::List(ref elems) => {
+                let elems: Vec<_> = elems.iter().map(|elem| format!("{}", elem)).collect();
+                write!(f, "[{}]", elems.join(", "))
+            }
+        }
+    }
+}
+
+/// Low byte first, the VM reads them back as `first + 256 * second`
+fn int_bytes(val: u16) -> [u8; 2] {
+    [(val % 256) as u8, (val / 256) as u8]
+}
+
 #[derive(Debug, Eq, PartialEq)]
 pub enum Instruction {
     Exit(VarRef),
@@ -73,6 +139,46 @@ pub enum Instruction {
     ToString(VarRef, VarRef),
     AnonFn(VarRef, Jump, Arity, Vec<VarRef>),
     GcCollect(VarRef),
+    GcStats(VarRef),
+    HeapDump(VarRef, VarRef),
+    LoadConst(VarRef, Constant),
+    ListBuilder(VarRef, VarRef),
+    ListBuilderPush(VarRef, VarRef, VarRef),
+    ListBuilderFreeze(VarRef, VarRef),
+    ListMap(VarRef, VarRef, VarRef),
+    ListFilter(VarRef, VarRef, VarRef),
+    ListReduce(VarRef, VarRef, VarRef, VarRef),
+    ListEach(VarRef, VarRef, VarRef),
+    ListFind(VarRef, VarRef, VarRef),
+    ListContains(VarRef, VarRef, VarRef),
+    ListReverse(VarRef, VarRef),
+    ListPmap(VarRef, VarRef, VarRef),
+    ListPreduce(VarRef, VarRef, VarRef, VarRef),
+    ListSum(VarRef, VarRef),
+    ListMax(VarRef, VarRef),
+    ListMin(VarRef, VarRef),
+    ListIndexOf(VarRef, VarRef, VarRef),
+    MapNew(VarRef),
+    MapGet(VarRef, VarRef, VarRef),
+    MapPut(VarRef, VarRef, VarRef, VarRef),
+    MapRemove(VarRef, VarRef, VarRef),
+    MapHasKey(VarRef, VarRef, VarRef),
+    MapCount(VarRef, VarRef),
+    MapToList(VarRef, VarRef),
+    SetNew(VarRef),
+    SetPut(VarRef, VarRef, VarRef),
+    SetRemove(VarRef, VarRef, VarRef),
+    SetMember(VarRef, VarRef, VarRef),
+    SetCount(VarRef, VarRef),
+    SetUnion(VarRef, VarRef, VarRef),
+    SetIntersection(VarRef, VarRef, VarRef),
+    SetDifference(VarRef, VarRef, VarRef),
+    SetToList(VarRef, VarRef),
+    ListSort(VarRef, VarRef),
+    ListSortBy(VarRef, VarRef, VarRef),
+    StringIndexOf(VarRef, VarRef, VarRef),
+    StringSplit(VarRef, VarRef, VarRef),
+    LiveMap(Vec<VarRef>),
 }
 
 impl Instruction {
@@ -86,9 +192,8 @@ impl Instruction {
                 out.write(&[opcodes::SUB, to.byte(), arg1.byte(), arg2.byte()]).unwrap();
             },
             &Instruction::StoreInt(to, val) => {
-                let first = val % 250;
-                let second = val / 250;
-                out.write(&[opcodes::STORE_INT, to.byte(), first as u8, second as u8]).unwrap();
+                out.write(&[opcodes::STORE_INT, to.byte()]).unwrap();
+                out.write(&int_bytes(val)).unwrap();
             }
             &Instruction::Mov(to, from) => {
                 out.write(&[opcodes::MOV, to.byte(), from.byte()]).unwrap();
@@ -173,6 +278,124 @@ impl Instruction {
             &Instruction::GcCollect(reg) => {
                 out.write(&[opcodes::GC_COLLECT, reg.byte()]).unwrap();
             }
+            &Instruction::GcStats(reg) => {
+                out.write(&[opcodes::GC_STATS, reg.byte()]).unwrap();
+            }
+            &Instruction::HeapDump(reg, path) => {
+                out.write(&[opcodes::HEAP_DUMP, reg.byte(), path.byte()]).unwrap();
+            }
+            &Instruction::LoadConst(to, ref constant) => {
+                out.write(&[opcodes::LOAD_CONST, to.byte()]).unwrap();
+                constant.emit(out);
+            }
+            &Instruction::ListBuilder(to, list) => {
+                out.write(&[opcodes::LIST_BUILDER, to.byte(), list.byte()]).unwrap();
+            }
+            &Instruction::ListBuilderPush(to, builder, elem) => {
+                out.write(&[opcodes::LIST_BUILDER_PUSH, to.byte(), builder.byte(), elem.byte()]).unwrap();
+            }
+            &Instruction::ListBuilderFreeze(to, builder) => {
+                out.write(&[opcodes::LIST_BUILDER_FREEZE, to.byte(), builder.byte()]).unwrap();
+            }
+            &Instruction::ListMap(to, list, fun) => {
+                out.write(&[opcodes::LIST_MAP, to.byte(), list.byte(), fun.byte()]).unwrap();
+            }
+            &Instruction::ListFilter(to, list, fun) => {
+                out.write(&[opcodes::LIST_FILTER, to.byte(), list.byte(), fun.byte()]).unwrap();
+            }
+            &Instruction::ListReduce(to, list, acc, fun) => {
+                out.write(&[opcodes::LIST_REDUCE, to.byte(), list.byte(), acc.byte(), fun.byte()]).unwrap();
+            }
+            &Instruction::ListEach(to, list, fun) => {
+                out.write(&[opcodes::LIST_EACH, to.byte(), list.byte(), fun.byte()]).unwrap();
+            }
+            &Instruction::ListFind(to, list, fun) => {
+                out.write(&[opcodes::LIST_FIND, to.byte(), list.byte(), fun.byte()]).unwrap();
+            }
+            &Instruction::ListContains(to, list, elem) => {
+                out.write(&[opcodes::LIST_CONTAINS, to.byte(), list.byte(), elem.byte()]).unwrap();
+            }
+            &Instruction::ListReverse(to, list) => {
+                out.write(&[opcodes::LIST_REVERSE, to.byte(), list.byte()]).unwrap();
+            }
+            &Instruction::ListPmap(to, list, fun) => {
+                out.write(&[opcodes::LIST_PMAP, to.byte(), list.byte(), fun.byte()]).unwrap();
+            }
+            &Instruction::ListPreduce(to, list, acc, fun) => {
+                out.write(&[opcodes::LIST_PREDUCE, to.byte(), list.byte(), acc.byte(), fun.byte()]).unwrap();
+            }
+            &Instruction::ListSum(to, list) => {
+                out.write(&[opcodes::LIST_SUM, to.byte(), list.byte()]).unwrap();
+            }
+            &Instruction::ListMax(to, list) => {
+                out.write(&[opcodes::LIST_MAX, to.byte(), list.byte()]).unwrap();
+            }
+            &Instruction::ListMin(to, list) => {
+                out.write(&[opcodes::LIST_MIN, to.byte(), list.byte()]).unwrap();
+            }
+            &Instruction::ListIndexOf(to, list, elem) => {
+                out.write(&[opcodes::LIST_INDEX_OF, to.byte(), list.byte(), elem.byte()]).unwrap();
+            }
+            &Instruction::MapNew(to) => {
+                out.write(&[opcodes::MAP_NEW, to.byte()]).unwrap();
+            }
+            &Instruction::MapGet(to, map, key) => {
+                out.write(&[opcodes::MAP_GET, to.byte(), map.byte(), key.byte()]).unwrap();
+            }
+            &Instruction::MapPut(to, map, key, value) => {
+                out.write(&[opcodes::MAP_PUT, to.byte(), map.byte(), key.byte(), value.byte()]).unwrap();
+            }
+            &Instruction::MapRemove(to, map, key) => {
+                out.write(&[opcodes::MAP_REMOVE, to.byte(), map.byte(), key.byte()]).unwrap();
+            }
+            &Instruction::MapHasKey(to, map, key) => {
+                out.write(&[opcodes::MAP_HAS_KEY, to.byte(), map.byte(), key.byte()]).unwrap();
+            }
+            &Instruction::MapCount(to, map) => {
+                out.write(&[opcodes::MAP_COUNT, to.byte(), map.byte()]).unwrap();
+            }
+            &Instruction::MapToList(to, map) => {
+                out.write(&[opcodes::MAP_TO_LIST, to.byte(), map.byte()]).unwrap();
+            }
+            &Instruction::SetNew(to) => {
+                out.write(&[opcodes::SET_NEW, to.byte()]).unwrap();
+            }
+            &Instruction::SetPut(to, set, elem) => {
+                out.write(&[opcodes::SET_PUT, to.byte(), set.byte(), elem.byte()]).unwrap();
+            }
+            &Instruction::SetRemove(to, set, elem) => {
+                out.write(&[opcodes::SET_REMOVE, to.byte(), set.byte(), elem.byte()]).unwrap();
+            }
+            &Instruction::SetMember(to, set, elem) => {
+                out.write(&[opcodes::SET_MEMBER, to.byte(), set.byte(), elem.byte()]).unwrap();
+            }
+            &Instruction::SetCount(to, set) => {
+                out.write(&[opcodes::SET_COUNT, to.byte(), set.byte()]).unwrap();
+            }
+            &Instruction::SetUnion(to, left, right) => {
+                out.write(&[opcodes::SET_UNION, to.byte(), left.byte(), right.byte()]).unwrap();
+            }
+            &Instruction::SetIntersection(to, left, right) => {
+                out.write(&[opcodes::SET_INTERSECTION, to.byte(), left.byte(), right.byte()]).unwrap();
+            }
+            &Instruction::SetDifference(to, left, right) => {
+                out.write(&[opcodes::SET_DIFFERENCE, to.byte(), left.byte(), right.byte()]).unwrap();
+            }
+            &Instruction::SetToList(to, set) => {
+                out.write(&[opcodes::SET_TO_LIST, to.byte(), set.byte()]).unwrap();
+            }
+            &Instruction::ListSort(to, list) => {
+                out.write(&[opcodes::LIST_SORT, to.byte(), list.byte()]).unwrap();
+            }
+            &Instruction::ListSortBy(to, list, fun) => {
+                out.write(&[opcodes::LIST_SORT_BY, to.byte(), list.byte(), fun.byte()]).unwrap();
+            }
+            &Instruction::StringIndexOf(to, string, substr) => {
+                out.write(&[opcodes::STRING_INDEX_OF, to.byte(), string.byte(), substr.byte()]).unwrap();
+            }
+            &Instruction::StringSplit(to, string, separator) => {
+                out.write(&[opcodes::STRING_SPLIT, to.byte(), string.byte(), separator.byte()]).unwrap();
+            }
             &Instruction::StoreFalse(reg) => {
                 out.write(&[opcodes::STORE_FALSE, reg.byte()]).unwrap();
             }
@@ -226,6 +449,13 @@ impl Instruction {
                     out.write(&[reg.byte()]);
                 }
             }
+            &Instruction::LiveMap(ref regs) => {
+                out.write(&[opcodes::LIVE_MAP, regs.len() as u8]).unwrap();
+
+                for reg in regs {
+                    out.write(&[reg.byte()]);
+                }
+            }
         }
     }
 
@@ -335,6 +565,162 @@ impl Instruction {
                 let string = format!("{} = gc_collect\n", reg);
                 out.write(&string.as_bytes()).unwrap();
             },
+            &Instruction::GcStats(reg) => {
+                let string = format!("{} = gc_stats\n", reg);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::HeapDump(reg, path) => {
+                let string = format!("{} = heap_dump {}\n", reg, path);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::LoadConst(to, ref constant) => {
+                let string = format!("{} = load_const {}\n", to, constant);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListBuilder(to, list) => {
+                let string = format!("{} = list_builder {}\n", to, list);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListBuilderPush(to, builder, elem) => {
+                let string = format!("{} = list_builder_push {}, {}\n", to, builder, elem);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListBuilderFreeze(to, builder) => {
+                let string = format!("{} = list_builder_freeze {}\n", to, builder);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListMap(to, list, fun) => {
+                let string = format!("{} = list_map {}, {}\n", to, list, fun);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListFilter(to, list, fun) => {
+                let string = format!("{} = list_filter {}, {}\n", to, list, fun);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListReduce(to, list, acc, fun) => {
+                let string = format!("{} = list_reduce {}, {}, {}\n", to, list, acc, fun);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListEach(to, list, fun) => {
+                let string = format!("{} = list_each {}, {}\n", to, list, fun);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListFind(to, list, fun) => {
+                let string = format!("{} = list_find {}, {}\n", to, list, fun);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListContains(to, list, elem) => {
+                let string = format!("{} = list_contains {}, {}\n", to, list, elem);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListReverse(to, list) => {
+                let string = format!("{} = list_reverse {}\n", to, list);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListPmap(to, list, fun) => {
+                let string = format!("{} = list_pmap {}, {}\n", to, list, fun);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListPreduce(to, list, acc, fun) => {
+                let string = format!("{} = list_preduce {}, {}, {}\n", to, list, acc, fun);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListSum(to, list) => {
+                let string = format!("{} = list_sum {}\n", to, list);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListMax(to, list) => {
+                let string = format!("{} = list_max {}\n", to, list);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListMin(to, list) => {
+                let string = format!("{} = list_min {}\n", to, list);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListIndexOf(to, list, elem) => {
+                let string = format!("{} = list_index_of {}, {}\n", to, list, elem);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::MapNew(to) => {
+                let string = format!("{} = map_new\n", to);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::MapGet(to, map, key) => {
+                let string = format!("{} = map_get {}, {}\n", to, map, key);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::MapPut(to, map, key, value) => {
+                let string = format!("{} = map_put {}, {}, {}\n", to, map, key, value);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::MapRemove(to, map, key) => {
+                let string = format!("{} = map_remove {}, {}\n", to, map, key);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::MapHasKey(to, map, key) => {
+                let string = format!("{} = map_has_key {}, {}\n", to, map, key);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::MapCount(to, map) => {
+                let string = format!("{} = map_count {}\n", to, map);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::MapToList(to, map) => {
+                let string = format!("{} = map_to_list {}\n", to, map);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::SetNew(to) => {
+                let string = format!("{} = set_new\n", to);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::SetPut(to, set, elem) => {
+                let string = format!("{} = set_put {}, {}\n", to, set, elem);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::SetRemove(to, set, elem) => {
+                let string = format!("{} = set_remove {}, {}\n", to, set, elem);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::SetMember(to, set, elem) => {
+                let string = format!("{} = set_member {}, {}\n", to, set, elem);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::SetCount(to, set) => {
+                let string = format!("{} = set_count {}\n", to, set);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::SetUnion(to, left, right) => {
+                let string = format!("{} = set_union {}, {}\n", to, left, right);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::SetIntersection(to, left, right) => {
+                let string = format!("{} = set_intersection {}, {}\n", to, left, right);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::SetDifference(to, left, right) => {
+                let string = format!("{} = set_difference {}, {}\n", to, left, right);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::SetToList(to, set) => {
+                let string = format!("{} = set_to_list {}\n", to, set);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListSort(to, list) => {
+                let string = format!("{} = list_sort {}\n", to, list);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::ListSortBy(to, list, fun) => {
+                let string = format!("{} = list_sort_by {}, {}\n", to, list, fun);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::StringIndexOf(to, string, substr) => {
+                let string = format!("{} = string_index_of {}, {}\n", to, string, substr);
+                out.write(&string.as_bytes()).unwrap();
+            },
+            &Instruction::StringSplit(to, string, separator) => {
+                let string = format!("{} = string_split {}, {}\n", to, string, separator);
+                out.write(&string.as_bytes()).unwrap();
+            },
             &Instruction::StoreFalse(reg) => {
                 let string = format!("{} = store_false\n", reg);
                 out.write(&string.as_bytes()).unwrap();
@@ -392,6 +778,11 @@ impl Instruction {
                 let string = format!("{} = anon_fn {}, {}, [{}; {}]\n", to, jmp, arity, upvals.len(), formatted_upvals.join(", "));
                 out.write(&string.as_bytes()).unwrap();
             }
+            &Instruction::LiveMap(ref regs) => {
+                let live: Vec<_> = regs.iter().map(|int| format!("{}", int)).collect();
+                let string = format!("live_map [{}; {}]\n", regs.len(), live.join(", "));
+                out.write(&string.as_bytes()).unwrap();
+            }
         }
     }
 
@@ -434,6 +825,46 @@ impl Instruction {
             &Instruction::ToString(_, _)        => 3,
             &Instruction::AnonFn(_, _, _, ref upvals) => 5 + (upvals.len() as u8),
             &Instruction::GcCollect(_)          => 2,
+            &Instruction::GcStats(_)            => 2,
+            &Instruction::HeapDump(_, _)        => 3,
+            &Instruction::LoadConst(_, _)       => 4, // Refers to the constant by a two byte index once loaded
+            &Instruction::ListBuilder(_, _)     => 3,
+            &Instruction::ListBuilderPush(_, _, _) => 4,
+            &Instruction::ListBuilderFreeze(_, _) => 3,
+            &Instruction::ListMap(_, _, _)      => 4,
+            &Instruction::ListFilter(_, _, _)   => 4,
+            &Instruction::ListReduce(_, _, _, _) => 5,
+            &Instruction::ListEach(_, _, _)     => 4,
+            &Instruction::ListFind(_, _, _)     => 4,
+            &Instruction::ListContains(_, _, _) => 4,
+            &Instruction::ListReverse(_, _)     => 3,
+            &Instruction::ListPmap(_, _, _)     => 4,
+            &Instruction::ListPreduce(_, _, _, _) => 5,
+            &Instruction::ListSum(_, _)         => 3,
+            &Instruction::ListMax(_, _)         => 3,
+            &Instruction::ListMin(_, _)         => 3,
+            &Instruction::ListIndexOf(_, _, _)  => 4,
+            &Instruction::MapNew(_)             => 2,
+            &Instruction::MapGet(_, _, _)       => 4,
+            &Instruction::MapPut(_, _, _, _)    => 5,
+            &Instruction::MapRemove(_, _, _)    => 4,
+            &Instruction::MapHasKey(_, _, _)    => 4,
+            &Instruction::MapCount(_, _)        => 3,
+            &Instruction::MapToList(_, _)       => 3,
+            &Instruction::SetNew(_)             => 2,
+            &Instruction::SetPut(_, _, _)       => 4,
+            &Instruction::SetRemove(_, _, _)    => 4,
+            &Instruction::SetMember(_, _, _)    => 4,
+            &Instruction::SetCount(_, _)        => 3,
+            &Instruction::SetUnion(_, _, _)     => 4,
+            &Instruction::SetIntersection(_, _, _) => 4,
+            &Instruction::SetDifference(_, _, _) => 4,
+            &Instruction::SetToList(_, _)       => 3,
+            &Instruction::ListSort(_, _)        => 3,
+            &Instruction::ListSortBy(_, _, _)   => 4,
+            &Instruction::StringIndexOf(_, _, _) => 4,
+            &Instruction::StringSplit(_, _, _)  => 4,
+            &Instruction::LiveMap(_)            => 0, // Consumed by the loader, does not end up in the code array
         }
     }
 }
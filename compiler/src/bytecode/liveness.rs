@@ -0,0 +1,205 @@
+use std::collections::{BTreeSet, HashMap};
+use bytecode::instruction::{Bytecode, Instruction, VarRef};
+
+type RegisterSet = BTreeSet<u8>;
+
+/// Inserts a `LiveMap` after every instruction at which the VM may run the garbage
+/// collector, suspend the current frame or otherwise walk the roots (calls, list
+/// functions that call back into Owl, explicit collections and heap dumps). Each
+/// map lists the registers that are read by the instruction or later on in the
+/// function. The collector only treats those registers as roots, so anything else
+/// left behind in a frame is free to be collected.
+///
+/// Jumps in the generated code only ever go forward, so a single backwards pass over
+/// the instructions is enough to compute exact liveness. Code of nested anonymous
+/// functions is skipped, it has already been annotated when it was generated.
+pub fn annotate(code: Bytecode) -> Bytecode {
+    let offsets = byte_offsets(&code);
+    let index_at: HashMap<usize, usize> = offsets.iter().enumerate().map(|(i, &o)| (o, i)).collect();
+    let nested = nested_function_code(&code, &offsets);
+
+    let mut live_in: Vec<RegisterSet> = vec![RegisterSet::new(); code.len() + 1];
+
+    for i in (0..code.len()).rev() {
+        if nested[i] { continue; }
+
+        let mut live = RegisterSet::new();
+        for offset in successors(&code[i], offsets[i]) {
+            let successor = index_at[&offset];
+            live = live.union(&live_in[successor]).cloned().collect();
+        }
+
+        let (defs, uses) = defs_and_uses(&code[i]);
+        for reg in defs { live.remove(&reg); }
+        for reg in uses { live.insert(reg); }
+        live_in[i] = live;
+    }
+
+    let mut annotated = Vec::with_capacity(code.len());
+    for (i, instr) in code.into_iter().enumerate() {
+        let is_safepoint = !nested[i] && is_safepoint(&instr);
+        annotated.push(instr);
+
+        if is_safepoint {
+            let live = live_in[i].iter().map(|&reg| VarRef::Register(reg)).collect();
+            annotated.push(Instruction::LiveMap(live));
+        }
+    }
+    annotated
+}
+
+fn is_safepoint(instr: &Instruction) -> bool {
+    match instr {
+        &Instruction::Call(_, _, _, _) => true,
+        &Instruction::CallLocal(_, _, _) => true,
+        &Instruction::GcCollect(_) => true,
+        &Instruction::HeapDump(_, _) => true,
+        &Instruction::ListMap(_, _, _) => true,
+        &Instruction::ListFilter(_, _, _) => true,
+        &Instruction::ListReduce(_, _, _, _) => true,
+        &Instruction::ListEach(_, _, _) => true,
+        &Instruction::ListFind(_, _, _) => true,
+        &Instruction::ListPmap(_, _, _) => true,
+        &Instruction::ListPreduce(_, _, _, _) => true,
+        &Instruction::ListSortBy(_, _, _) => true,
+        _ => false
+    }
+}
+
+/// Byte offset of every instruction, plus the offset just past the last one
+fn byte_offsets(code: &Bytecode) -> Vec<usize> {
+    let mut offsets = Vec::with_capacity(code.len() + 1);
+    let mut offset = 0;
+    for instr in code.iter() {
+        offsets.push(offset);
+        offset += instr.byte_size() as usize;
+    }
+    offsets.push(offset);
+    offsets
+}
+
+fn nested_function_code(code: &Bytecode, offsets: &Vec<usize>) -> Vec<bool> {
+    let mut nested = vec![false; code.len()];
+    let mut nested_end = 0;
+
+    for (i, instr) in code.iter().enumerate() {
+        if offsets[i] < nested_end {
+            nested[i] = true;
+        } else if let &Instruction::AnonFn(_, jmp, _, _) = instr {
+            nested_end = offsets[i + 1] + jmp as usize - 1;
+        }
+    }
+    nested
+}
+
+/// Byte offsets at which execution can continue after `instr`. Mirrors how the VM
+/// advances the instruction pointer in `op_test`, `op_jmp` and `op_anon_fn`.
+fn successors(instr: &Instruction, offset: usize) -> Vec<usize> {
+    let next = offset + instr.byte_size() as usize;
+
+    match instr {
+        &Instruction::Return => vec![],
+        &Instruction::Exit(_) => vec![],
+        &Instruction::Jmp(jump) => vec![offset + 1 + jump as usize],
+        &Instruction::Test(_, jump) => vec![next, offset + 2 + jump as usize],
+        &Instruction::AnonFn(_, jump, _, _) => vec![next - 1 + jump as usize],
+        _ => vec![next]
+    }
+}
+
+fn registers(refs: Vec<VarRef>) -> Vec<u8> {
+    refs.into_iter().filter_map(|var_ref| {
+        match var_ref {
+            VarRef::Register(reg) => Some(reg),
+            VarRef::Upvalue(_) => None
+        }
+    }).collect()
+}
+
+fn defs_and_uses(instr: &Instruction) -> (Vec<u8>, Vec<u8>) {
+    let (defs, uses) = match instr {
+        &Instruction::Exit(reg) => (vec![], vec![reg]),
+        &Instruction::StoreInt(to, _) => (vec![to], vec![]),
+        &Instruction::Print(reg) => (vec![], vec![reg]),
+        &Instruction::Test(reg, _) => (vec![], vec![reg]),
+        &Instruction::Add(to, a, b) => (vec![to], vec![a, b]),
+        &Instruction::Sub(to, a, b) => (vec![to], vec![a, b]),
+        &Instruction::Call(to, _, _, ref args) => (vec![to], args.clone()),
+        &Instruction::Return => (vec![], vec![VarRef::Register(0)]),
+        &Instruction::Mov(to, from) => (vec![to], vec![from]),
+        &Instruction::Jmp(_) => (vec![], vec![]),
+        &Instruction::Tuple(to, _, ref elems) => (vec![to], elems.clone()),
+        &Instruction::TupleNth(to, tuple, index) => (vec![to], vec![tuple, index]),
+        &Instruction::List(to, _, ref elems) => (vec![to], elems.clone()),
+        &Instruction::ListNth(to, list, index) => (vec![to], vec![list, index]),
+        &Instruction::StoreTrue(to) => (vec![to], vec![]),
+        &Instruction::StoreFalse(to) => (vec![to], vec![]),
+        &Instruction::StoreNil(to) => (vec![to], vec![]),
+        &Instruction::Eq(to, a, b) => (vec![to], vec![a, b]),
+        &Instruction::NotEq(to, a, b) => (vec![to], vec![a, b]),
+        &Instruction::Not(to, a) => (vec![to], vec![a]),
+        &Instruction::GreaterThan(to, a, b) => (vec![to], vec![a, b]),
+        &Instruction::LoadString(to, _) => (vec![to], vec![]),
+        &Instruction::FilePwd(to) => (vec![to], vec![]),
+        &Instruction::FileLs(to, path) => (vec![to], vec![path]),
+        &Instruction::Concat(to, a, b) => (vec![to], vec![a, b]),
+        &Instruction::Capture(to, _, _) => (vec![to], vec![]),
+        &Instruction::CallLocal(to, fun, ref args) => {
+            let mut uses = args.clone();
+            uses.push(fun);
+            (vec![to], uses)
+        },
+        &Instruction::ListCount(to, list) => (vec![to], vec![list]),
+        &Instruction::ListSlice(to, list, from, until) => (vec![to], vec![list, from, until]),
+        &Instruction::StringSlice(to, string, from, until) => (vec![to], vec![string, from, until]),
+        &Instruction::CodeLoad(to, filename) => (vec![to], vec![filename]),
+        &Instruction::FunctionName(to, fun) => (vec![to], vec![fun]),
+        &Instruction::StringCount(to, string) => (vec![to], vec![string]),
+        &Instruction::StringContains(to, string, substr) => (vec![to], vec![string, substr]),
+        &Instruction::ToString(to, term) => (vec![to], vec![term]),
+        &Instruction::AnonFn(to, _, _, ref upvals) => (vec![to], upvals.clone()),
+        &Instruction::GcCollect(to) => (vec![to], vec![]),
+        &Instruction::GcStats(to) => (vec![to], vec![]),
+        &Instruction::HeapDump(to, path) => (vec![to], vec![path]),
+        &Instruction::LoadConst(to, _) => (vec![to], vec![]),
+        &Instruction::ListBuilder(to, list) => (vec![to], vec![list]),
+        &Instruction::ListBuilderPush(to, builder, elem) => (vec![to], vec![builder, elem]),
+        &Instruction::ListBuilderFreeze(to, builder) => (vec![to], vec![builder]),
+        &Instruction::ListMap(to, list, fun) => (vec![to], vec![list, fun]),
+        &Instruction::ListFilter(to, list, fun) => (vec![to], vec![list, fun]),
+        &Instruction::ListReduce(to, list, acc, fun) => (vec![to], vec![list, acc, fun]),
+        &Instruction::ListEach(to, list, fun) => (vec![to], vec![list, fun]),
+        &Instruction::ListFind(to, list, fun) => (vec![to], vec![list, fun]),
+        &Instruction::ListContains(to, list, elem) => (vec![to], vec![list, elem]),
+        &Instruction::ListReverse(to, list) => (vec![to], vec![list]),
+        &Instruction::ListPmap(to, list, fun) => (vec![to], vec![list, fun]),
+        &Instruction::ListPreduce(to, list, acc, fun) => (vec![to], vec![list, acc, fun]),
+        &Instruction::ListSum(to, list) => (vec![to], vec![list]),
+        &Instruction::ListMax(to, list) => (vec![to], vec![list]),
+        &Instruction::ListMin(to, list) => (vec![to], vec![list]),
+        &Instruction::ListIndexOf(to, list, elem) => (vec![to], vec![list, elem]),
+        &Instruction::MapNew(to) => (vec![to], vec![]),
+        &Instruction::MapGet(to, map, key) => (vec![to], vec![map, key]),
+        &Instruction::MapPut(to, map, key, value) => (vec![to], vec![map, key, value]),
+        &Instruction::MapRemove(to, map, key) => (vec![to], vec![map, key]),
+        &Instruction::MapHasKey(to, map, key) => (vec![to], vec![map, key]),
+        &Instruction::MapCount(to, map) => (vec![to], vec![map]),
+        &Instruction::MapToList(to, map) => (vec![to], vec![map]),
+        &Instruction::SetNew(to) => (vec![to], vec![]),
+        &Instruction::SetPut(to, set, elem) => (vec![to], vec![set, elem]),
+        &Instruction::SetRemove(to, set, elem) => (vec![to], vec![set, elem]),
+        &Instruction::SetMember(to, set, elem) => (vec![to], vec![set, elem]),
+        &Instruction::SetCount(to, set) => (vec![to], vec![set]),
+        &Instruction::SetUnion(to, left, right) => (vec![to], vec![left, right]),
+        &Instruction::SetIntersection(to, left, right) => (vec![to], vec![left, right]),
+        &Instruction::SetDifference(to, left, right) => (vec![to], vec![left, right]),
+        &Instruction::SetToList(to, set) => (vec![to], vec![set]),
+        &Instruction::ListSort(to, list) => (vec![to], vec![list]),
+        &Instruction::ListSortBy(to, list, fun) => (vec![to], vec![list, fun]),
+        &Instruction::StringIndexOf(to, string, substr) => (vec![to], vec![string, substr]),
+        &Instruction::StringSplit(to, string, separator) => (vec![to], vec![string, separator]),
+        &Instruction::LiveMap(_) => (vec![], vec![]),
+    };
+
+    (registers(defs), registers(uses))
+}
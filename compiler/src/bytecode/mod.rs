@@ -7,8 +7,9 @@ mod opcodes;
 mod function;
 mod module;
 mod instruction;
+mod liveness;
 
-pub use self::instruction::{Bytecode, Instruction, VarRef};
+pub use self::instruction::{Bytecode, Constant, Instruction, VarRef};
 pub use self::function::Function;
 pub use self::module::Module;
 
@@ -60,7 +61,7 @@ impl<'a> FnGenerator<'a> {
         let mut code = self.generate_block(VarRef::Register(0), self.body);
 
         code.push(Instruction::Return);
-        code
+        liveness::annotate(code)
     }
 
     fn search_parent_env(&self, identifier: &str) -> Option<VarRef> {
@@ -148,6 +149,9 @@ impl<'a> FnGenerator<'a> {
                 self.gen_branch_into(&mut res, condition_out, &mut then_branch, &mut else_branch);
                 res
             },
+            &ast::Expr::Tuple(_) | &ast::Expr::List(_) if constant_of(expr).is_some() => {
+                vec![Instruction::LoadConst(out, constant_of(expr).unwrap())]
+            },
             &ast::Expr::Tuple(ref t) => {
                 let mut res = Vec::new();
                 for elem in t.elems.iter() {
@@ -243,6 +247,44 @@ impl<'a> FnGenerator<'a> {
             "string_contains" => vec![Instruction::StringContains(ret_loc, args[0], args[1])],
             "term_to_string" => vec![Instruction::ToString(ret_loc, args[0])],
             "gc_collect" => vec![Instruction::GcCollect(ret_loc)],
+            "gc_stats" => vec![Instruction::GcStats(ret_loc)],
+            "heap_dump" => vec![Instruction::HeapDump(ret_loc, args[0])],
+            "list_builder" => vec![Instruction::ListBuilder(ret_loc, args[0])],
+            "list_builder_push" => vec![Instruction::ListBuilderPush(ret_loc, args[0], args[1])],
+            "list_builder_freeze" => vec![Instruction::ListBuilderFreeze(ret_loc, args[0])],
+            "list_map" => vec![Instruction::ListMap(ret_loc, args[0], args[1])],
+            "list_filter" => vec![Instruction::ListFilter(ret_loc, args[0], args[1])],
+            "list_reduce" => vec![Instruction::ListReduce(ret_loc, args[0], args[1], args[2])],
+            "list_each" => vec![Instruction::ListEach(ret_loc, args[0], args[1])],
+            "list_find" => vec![Instruction::ListFind(ret_loc, args[0], args[1])],
+            "list_contains" => vec![Instruction::ListContains(ret_loc, args[0], args[1])],
+            "list_reverse" => vec![Instruction::ListReverse(ret_loc, args[0])],
+            "list_pmap" => vec![Instruction::ListPmap(ret_loc, args[0], args[1])],
+            "list_preduce" => vec![Instruction::ListPreduce(ret_loc, args[0], args[1], args[2])],
+            "list_sum" => vec![Instruction::ListSum(ret_loc, args[0])],
+            "list_max" => vec![Instruction::ListMax(ret_loc, args[0])],
+            "list_min" => vec![Instruction::ListMin(ret_loc, args[0])],
+            "list_index_of" => vec![Instruction::ListIndexOf(ret_loc, args[0], args[1])],
+            "map_new" => vec![Instruction::MapNew(ret_loc)],
+            "map_get" => vec![Instruction::MapGet(ret_loc, args[0], args[1])],
+            "map_put" => vec![Instruction::MapPut(ret_loc, args[0], args[1], args[2])],
+            "map_remove" => vec![Instruction::MapRemove(ret_loc, args[0], args[1])],
+            "map_has_key" => vec![Instruction::MapHasKey(ret_loc, args[0], args[1])],
+            "map_count" => vec![Instruction::MapCount(ret_loc, args[0])],
+            "map_to_list" => vec![Instruction::MapToList(ret_loc, args[0])],
+            "set_new" => vec![Instruction::SetNew(ret_loc)],
+            "set_put" => vec![Instruction::SetPut(ret_loc, args[0], args[1])],
+            "set_remove" => vec![Instruction::SetRemove(ret_loc, args[0], args[1])],
+            "set_member" => vec![Instruction::SetMember(ret_loc, args[0], args[1])],
+            "set_count" => vec![Instruction::SetCount(ret_loc, args[0])],
+            "set_union" => vec![Instruction::SetUnion(ret_loc, args[0], args[1])],
+            "set_intersection" => vec![Instruction::SetIntersection(ret_loc, args[0], args[1])],
+            "set_difference" => vec![Instruction::SetDifference(ret_loc, args[0], args[1])],
+            "set_to_list" => vec![Instruction::SetToList(ret_loc, args[0])],
+            "list_sort" => vec![Instruction::ListSort(ret_loc, args[0])],
+            "list_sort_by" => vec![Instruction::ListSortBy(ret_loc, args[0], args[1])],
+            "string_index_of" => vec![Instruction::StringIndexOf(ret_loc, args[0], args[1])],
+            "string_split" => vec![Instruction::StringSplit(ret_loc, args[0], args[1])],
             _   => {
                 self.generic_apply(ap, ret_loc, args)
             }
@@ -325,6 +367,29 @@ impl<'a> FnGenerator<'a> {
     }
 }
 
+/// Literals that only contain other literals are built once by the VM instead of
+/// every time the code runs. Lengths are written as a single byte, so anything
+/// that does not fit is left to the regular instructions.
+fn constant_of(expr: &ast::Expr) -> Option<Constant> {
+    match expr {
+        &ast::Expr::Int(ref i) => Some(Constant::Int(i.value.parse::<u16>().unwrap())),
+        &ast::Expr::True => Some(Constant::True),
+        &ast::Expr::False => Some(Constant::False),
+        &ast::Expr::Nil => Some(Constant::Nil),
+        // The length byte also counts the null terminator
+        &ast::Expr::Str(ref string) if string.value.len() < u8::MAX as usize => {
+            Some(Constant::Str(string.value.to_string()))
+        },
+        &ast::Expr::Tuple(ref t) if t.elems.len() <= u8::MAX as usize => {
+            t.elems.iter().map(constant_of).collect::<Option<Vec<_>>>().map(Constant::Tuple)
+        },
+        &ast::Expr::List(ref l) if l.elems.len() <= u8::MAX as usize => {
+            l.elems.iter().map(constant_of).collect::<Option<Vec<_>>>().map(Constant::List)
+        },
+        _ => None
+    }
+}
+
 pub fn generate_function(f: &ast::Function) -> Function {
     FnGenerator::new("unknown", f.name, &f.args, &f.body, None).generate()
 }
@@ -36,3 +36,52 @@ pub const STRING_CONTAINS: u8 = 0x22;
 pub const TO_STRING: u8       = 0x23;
 pub const ANON_FN: u8         = 0x24;
 pub const GC_COLLECT: u8      = 0x25;
+pub const LIVE_MAP: u8        = 0x26;
+pub const GC_STATS: u8        = 0x27;
+pub const HEAP_DUMP: u8       = 0x28;
+pub const LOAD_CONST: u8      = 0x29;
+pub const LIST_BUILDER: u8    = 0x2a;
+pub const LIST_BUILDER_PUSH: u8 = 0x2b;
+pub const LIST_BUILDER_FREEZE: u8 = 0x2c;
+pub const LIST_MAP: u8        = 0x2d;
+pub const LIST_FILTER: u8     = 0x2e;
+pub const LIST_REDUCE: u8     = 0x2f;
+pub const LIST_EACH: u8       = 0x30;
+pub const LIST_FIND: u8       = 0x31;
+pub const LIST_CONTAINS: u8   = 0x32;
+pub const LIST_REVERSE: u8    = 0x33;
+pub const LIST_PMAP: u8       = 0x34;
+pub const LIST_PREDUCE: u8    = 0x35;
+pub const LIST_SUM: u8        = 0x36;
+pub const LIST_MAX: u8        = 0x37;
+pub const LIST_MIN: u8        = 0x38;
+pub const LIST_INDEX_OF: u8   = 0x39;
+pub const MAP_NEW: u8         = 0x3a;
+pub const MAP_GET: u8         = 0x3b;
+pub const MAP_PUT: u8         = 0x3c;
+pub const MAP_REMOVE: u8      = 0x3d;
+pub const MAP_HAS_KEY: u8     = 0x3e;
+pub const MAP_COUNT: u8       = 0x3f;
+pub const MAP_TO_LIST: u8     = 0x40;
+pub const SET_NEW: u8         = 0x41;
+pub const SET_PUT: u8         = 0x42;
+pub const SET_REMOVE: u8      = 0x43;
+pub const SET_MEMBER: u8      = 0x44;
+pub const SET_COUNT: u8       = 0x45;
+pub const SET_UNION: u8       = 0x46;
+pub const SET_INTERSECTION: u8 = 0x47;
+pub const SET_DIFFERENCE: u8  = 0x48;
+pub const SET_TO_LIST: u8     = 0x49;
+pub const LIST_SORT: u8       = 0x4a;
+pub const LIST_SORT_BY: u8    = 0x4b;
+pub const STRING_INDEX_OF: u8 = 0x4c;
+pub const STRING_SPLIT: u8    = 0x4d;
+
+// Kinds of value in the constant encoded after LOAD_CONST
+pub const CONST_INT: u8       = 0x00;
+pub const CONST_TRUE: u8      = 0x01;
+pub const CONST_FALSE: u8     = 0x02;
+pub const CONST_NIL: u8       = 0x03;
+pub const CONST_STRING: u8    = 0x04;
+pub const CONST_TUPLE: u8     = 0x05;
+pub const CONST_LIST: u8      = 0x06;
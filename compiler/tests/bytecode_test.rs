@@ -1,7 +1,7 @@
 extern crate owlc;
 
 use owlc::ast::*;
-use owlc::bytecode::{Instruction, VarRef};
+use owlc::bytecode::{Constant, Instruction, VarRef};
 use owlc::bytecode;
 
 #[test]
@@ -122,6 +122,38 @@ fn generates_file_pwd() {
     )
 }
 
+#[test]
+fn generates_gc_stats() {
+    let ast = mk_function("main", Vec::new(), vec![
+        mk_apply(None, "gc_stats", vec![])
+    ]);
+
+    let res = bytecode::generate_function(&ast);
+
+    assert_eq!(res.code, vec![
+            Instruction::GcStats(VarRef::Register(0)),
+            Instruction::Return
+        ]
+    )
+}
+
+#[test]
+fn generates_heap_dump() {
+    let ast = mk_function("main", Vec::new(), vec![
+        mk_apply(None, "heap_dump", vec![mk_string("heap.dump")])
+    ]);
+
+    let res = bytecode::generate_function(&ast);
+
+    assert_eq!(res.code, vec![
+            Instruction::LoadString(VarRef::Register(1), "heap.dump".to_string()),
+            Instruction::HeapDump(VarRef::Register(0), VarRef::Register(1)),
+            Instruction::LiveMap(vec![VarRef::Register(1)]),
+            Instruction::Return
+        ]
+    )
+}
+
 #[test]
 fn generates_file_ls() {
     let ast = mk_function("main", Vec::new(), vec![
@@ -138,6 +170,120 @@ fn generates_file_ls() {
     )
 }
 
+#[test]
+fn generates_list_builder() {
+    let ast = mk_function("main", vec![mk_argument("list")], vec![
+        mk_apply(None, "list_builder_freeze", vec![
+            mk_apply(None, "list_builder_push", vec![
+                mk_apply(None, "list_builder", vec![mk_ident("list")]),
+                mk_int("1")
+            ])
+        ])
+    ]);
+
+    let res = bytecode::generate_function(&ast);
+
+    assert_eq!(res.code, vec![
+            Instruction::Mov(VarRef::Register(4), VarRef::Register(1)),
+            Instruction::ListBuilder(VarRef::Register(3), VarRef::Register(4)),
+            Instruction::StoreInt(VarRef::Register(4), 1),
+            Instruction::ListBuilderPush(VarRef::Register(2), VarRef::Register(3), VarRef::Register(4)),
+            Instruction::ListBuilderFreeze(VarRef::Register(0), VarRef::Register(2)),
+            Instruction::Return
+        ]
+    )
+}
+
+#[test]
+fn generates_list_reduce_as_safepoint() {
+    let ast = mk_function("main", vec![mk_argument("list"), mk_argument("fun")], vec![
+        mk_apply(None, "list_reduce", vec![mk_ident("list"), mk_int("0"), mk_ident("fun")])
+    ]);
+
+    let res = bytecode::generate_function(&ast);
+
+    assert_eq!(res.code, vec![
+            Instruction::Mov(VarRef::Register(3), VarRef::Register(1)),
+            Instruction::StoreInt(VarRef::Register(4), 0),
+            Instruction::Mov(VarRef::Register(5), VarRef::Register(2)),
+            Instruction::ListReduce(VarRef::Register(0), VarRef::Register(3), VarRef::Register(4), VarRef::Register(5)),
+            Instruction::LiveMap(vec![VarRef::Register(3), VarRef::Register(4), VarRef::Register(5)]),
+            Instruction::Return
+        ]
+    )
+}
+
+#[test]
+fn generates_list_pmap_as_safepoint() {
+    let ast = mk_function("main", vec![mk_argument("list"), mk_argument("fun")], vec![
+        mk_apply(None, "list_pmap", vec![mk_ident("list"), mk_ident("fun")])
+    ]);
+
+    let res = bytecode::generate_function(&ast);
+
+    assert_eq!(res.code, vec![
+            Instruction::Mov(VarRef::Register(3), VarRef::Register(1)),
+            Instruction::Mov(VarRef::Register(4), VarRef::Register(2)),
+            Instruction::ListPmap(VarRef::Register(0), VarRef::Register(3), VarRef::Register(4)),
+            Instruction::LiveMap(vec![VarRef::Register(3), VarRef::Register(4)]),
+            Instruction::Return
+        ]
+    )
+}
+
+#[test]
+fn generates_list_sort_by_as_safepoint() {
+    let ast = mk_function("main", vec![mk_argument("list"), mk_argument("fun")], vec![
+        mk_apply(None, "list_sort_by", vec![mk_ident("list"), mk_ident("fun")])
+    ]);
+
+    let res = bytecode::generate_function(&ast);
+
+    assert_eq!(res.code, vec![
+            Instruction::Mov(VarRef::Register(3), VarRef::Register(1)),
+            Instruction::Mov(VarRef::Register(4), VarRef::Register(2)),
+            Instruction::ListSortBy(VarRef::Register(0), VarRef::Register(3), VarRef::Register(4)),
+            Instruction::LiveMap(vec![VarRef::Register(3), VarRef::Register(4)]),
+            Instruction::Return
+        ]
+    )
+}
+
+#[test]
+fn generates_map_put() {
+    let ast = mk_function("main", vec![mk_argument("map")], vec![
+        mk_apply(None, "map_put", vec![mk_ident("map"), mk_string("key"), mk_int("1")])
+    ]);
+
+    let res = bytecode::generate_function(&ast);
+
+    assert_eq!(res.code, vec![
+            Instruction::Mov(VarRef::Register(2), VarRef::Register(1)),
+            Instruction::LoadString(VarRef::Register(3), "key".to_string()),
+            Instruction::StoreInt(VarRef::Register(4), 1),
+            Instruction::MapPut(VarRef::Register(0), VarRef::Register(2), VarRef::Register(3), VarRef::Register(4)),
+            Instruction::Return
+        ]
+    )
+}
+
+#[test]
+fn generates_set_union() {
+    let ast = mk_function("main", vec![mk_argument("left"), mk_argument("right")], vec![
+        mk_apply(None, "set_union", vec![mk_ident("left"), mk_ident("right")])
+    ]);
+
+    let res = bytecode::generate_function(&ast);
+
+    assert_eq!(res.code, vec![
+            Instruction::Mov(VarRef::Register(3), VarRef::Register(1)),
+            Instruction::Mov(VarRef::Register(4), VarRef::Register(2)),
+            Instruction::SetUnion(VarRef::Register(0), VarRef::Register(3), VarRef::Register(4)),
+            Instruction::Return
+        ]
+    )
+}
+
 #[test]
 fn generates_concat() {
     let ast = mk_function("main", Vec::new(), vec![
@@ -247,6 +393,7 @@ fn generates_function_call_in_same_module() {
 
     assert_eq!(res.functions[0].code, vec![
         Instruction::Call(VarRef::Register(0), "mod.wut".to_string(), 0, Vec::new()),
+        Instruction::LiveMap(vec![]),
         Instruction::Return,
     ])
 }
@@ -263,24 +410,25 @@ fn generates_function_call_in_different_module() {
 
     assert_eq!(res.functions[0].code, vec![
         Instruction::Call(VarRef::Register(0), "other_module.wut".to_string(), 0, Vec::new()),
+        Instruction::LiveMap(vec![]),
         Instruction::Return,
     ])
 }
 
 #[test]
 fn generates_tuple() {
-    let main = mk_function("main", Vec::new(), vec![
-        mk_tuple(vec![mk_int("1"), mk_int("2")])
+    let main = mk_function("main", vec![mk_argument("a")], vec![
+        mk_tuple(vec![mk_ident("a"), mk_int("2")])
     ]);
 
     let res = bytecode::generate_function(&main);
 
     assert_eq!(res.code, vec![
-        Instruction::StoreInt(VarRef::Register(1), 1),
-        Instruction::StoreInt(VarRef::Register(2), 2),
+        Instruction::Mov(VarRef::Register(2), VarRef::Register(1)),
+        Instruction::StoreInt(VarRef::Register(3), 2),
         Instruction::Tuple(VarRef::Register(0), 2, vec![
-             VarRef::Register(1),
-             VarRef::Register(2)
+             VarRef::Register(2),
+             VarRef::Register(3)
         ]),
         Instruction::Return,
     ])
@@ -288,23 +436,87 @@ fn generates_tuple() {
 
 #[test]
 fn generates_list() {
-    let main = mk_function("main", Vec::new(), vec![
-        mk_list(vec![mk_int("1"), mk_int("2")])
+    let main = mk_function("main", vec![mk_argument("a")], vec![
+        mk_list(vec![mk_ident("a"), mk_int("2")])
     ]);
 
     let res = bytecode::generate_function(&main);
 
     assert_eq!(res.code, vec![
-        Instruction::StoreInt(VarRef::Register(1), 1),
-        Instruction::StoreInt(VarRef::Register(2), 2),
+        Instruction::Mov(VarRef::Register(2), VarRef::Register(1)),
+        Instruction::StoreInt(VarRef::Register(3), 2),
         Instruction::List(VarRef::Register(0), 2, vec![
-             VarRef::Register(1),
-             VarRef::Register(2)
+             VarRef::Register(2),
+             VarRef::Register(3)
         ]),
         Instruction::Return,
     ])
 }
 
+#[test]
+fn generates_constant_tuple() {
+    let main = mk_function("main", Vec::new(), vec![
+        mk_tuple(vec![mk_int("1"), mk_string("Hello")])
+    ]);
+
+    let res = bytecode::generate_function(&main);
+
+    assert_eq!(res.code, vec![
+        Instruction::LoadConst(VarRef::Register(0), Constant::Tuple(vec![
+            Constant::Int(1),
+            Constant::Str("Hello".to_string())
+        ])),
+        Instruction::Return,
+    ])
+}
+
+#[test]
+fn generates_constant_nested_list() {
+    let main = mk_function("main", Vec::new(), vec![
+        mk_list(vec![mk_list(vec![mk_true(), mk_nil()]), mk_int("300")])
+    ]);
+
+    let res = bytecode::generate_function(&main);
+
+    assert_eq!(res.code, vec![
+        Instruction::LoadConst(VarRef::Register(0), Constant::List(vec![
+            Constant::List(vec![Constant::True, Constant::Nil]),
+            Constant::Int(300)
+        ])),
+        Instruction::Return,
+    ])
+}
+
+#[test]
+fn generates_constant_list_of_maximum_length() {
+    let main = mk_function("main", Vec::new(), vec![
+        mk_list((0..255).map(|_| mk_int("1")).collect())
+    ]);
+
+    let res = bytecode::generate_function(&main);
+
+    assert_eq!(res.code, vec![
+        Instruction::LoadConst(VarRef::Register(0), Constant::List(vec![Constant::Int(1); 255])),
+        Instruction::Return,
+    ])
+}
+
+#[test]
+fn does_not_generate_constant_with_string_too_long_to_encode() {
+    let long = "a".repeat(255);
+    let main = mk_function("main", Vec::new(), vec![
+        mk_tuple(vec![mk_string(&long)])
+    ]);
+
+    let res = bytecode::generate_function(&main);
+
+    assert_eq!(res.code, vec![
+        Instruction::LoadString(VarRef::Register(1), long.clone()),
+        Instruction::Tuple(VarRef::Register(0), 1, vec![VarRef::Register(1)]),
+        Instruction::Return,
+    ])
+}
+
 #[test]
 fn generates_true() {
     let main = mk_function("main", Vec::new(), vec![
@@ -459,6 +671,7 @@ fn generates_calling_function_indirectly() {
     assert_eq!(res.code, vec![
         Instruction::Capture(VarRef::Register(1), "unknown.some_function".to_string(), 0),
         Instruction::CallLocal(VarRef::Register(0), VarRef::Register(1), Vec::new()),
+        Instruction::LiveMap(vec![VarRef::Register(1)]),
         Instruction::Return,
     ])
 }
@@ -475,6 +688,7 @@ fn does_not_call_locally_when_module_is_provided() {
     assert_eq!(res.code, vec![
         Instruction::Capture(VarRef::Register(1), "unknown.some_function".to_string(), 0),
         Instruction::Call(VarRef::Register(0), "Module.captured".to_string(), 0, Vec::new()),
+        Instruction::LiveMap(vec![]),
         Instruction::Return,
     ])
 }
@@ -545,3 +759,59 @@ fn generates_anonymous_function_with_upvalues() {
         Instruction::Return
     ])
 }
+
+#[test]
+fn generates_live_map_after_calls() {
+    let main = mk_function("main", vec![mk_argument("a")], vec![
+        mk_let(mk_ident("b"), mk_int("1")),
+        mk_let(mk_ident("c"), mk_apply(None, "wut", vec![mk_ident("a")])),
+        mk_apply(None, "+", vec![mk_ident("b"), mk_ident("c")])
+    ]);
+
+    let res = bytecode::generate_function(&main);
+
+    assert_eq!(res.code, vec![
+        Instruction::StoreInt(VarRef::Register(2), 1),
+        Instruction::Mov(VarRef::Register(4), VarRef::Register(1)),
+        Instruction::Call(VarRef::Register(3), "unknown.wut".to_string(), 1, vec![VarRef::Register(4)]),
+        Instruction::LiveMap(vec![VarRef::Register(2), VarRef::Register(4)]),
+        Instruction::Mov(VarRef::Register(4), VarRef::Register(2)),
+        Instruction::Mov(VarRef::Register(5), VarRef::Register(3)),
+        Instruction::Add(VarRef::Register(0), VarRef::Register(4), VarRef::Register(5)),
+        Instruction::Return,
+    ])
+}
+
+#[test]
+fn generates_live_map_across_branches() {
+    let main = mk_function("main", vec![mk_argument("a"), mk_argument("b")], vec![
+        mk_apply(None, "gc_collect", vec![]),
+        mk_if(mk_ident("a"), vec![mk_ident("b")], vec![mk_int("1")])
+    ]);
+
+    let res = bytecode::generate_function(&main);
+
+    assert_eq!(res.code[0], Instruction::GcCollect(VarRef::Register(0)));
+    assert_eq!(res.code[1], Instruction::LiveMap(vec![VarRef::Register(1), VarRef::Register(2)]));
+}
+
+#[test]
+fn generates_live_maps_for_anonymous_function_separately() {
+    let main = mk_function("main", vec![mk_argument("a")], vec![
+        mk_anon_fn(vec![], vec![mk_apply(None, "wut", vec![])]),
+        mk_apply(None, "wut", vec![mk_ident("a")])
+    ]);
+
+    let res = bytecode::generate_function(&main);
+
+    assert_eq!(res.code, vec![
+        Instruction::AnonFn(VarRef::Register(0), 6, 0, vec![]),
+        Instruction::Call(VarRef::Register(0), "unknown.wut".to_string(), 0, vec![]),
+        Instruction::LiveMap(vec![]),
+        Instruction::Return,
+        Instruction::Mov(VarRef::Register(2), VarRef::Register(1)),
+        Instruction::Call(VarRef::Register(0), "unknown.wut".to_string(), 1, vec![VarRef::Register(2)]),
+        Instruction::LiveMap(vec![VarRef::Register(2)]),
+        Instruction::Return,
+    ])
+}
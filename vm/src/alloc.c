@@ -1,12 +1,31 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
 #include "std/owl_list.h"
+#include "std/owl_function.h"
+#include "std/owl_map.h"
+#include "std/owl_string.h"
 #include "alloc.h"
+#include "heap_profile.h"
+#include "parallel.h"
 #include "term.h"
+#include "util/int_kernels.h"
 
 // Using a standard Chaney's copying garbage collector
 // https://en.wikipedia.org/wiki/Cheney%27s_algorithm
+//
+// When more than one GC thread is configured, the copying is shared between a
+// pool of workers instead, see `parallel_collect` below. When a pause budget is
+// configured, collection is done incrementally, see `incremental_step`.
+//
+// Objects of LARGE_OBJECT_SIZE bytes or more never enter the semispaces. They
+// are mapped on their own and marked in place instead of being copied.
+//
+// OWL_GC=immix swaps the semispaces for a mark-region heap, see `immix_collect`.
 
 #define ALIGNMENT 8
 #define ENFORE_MINIMUM(size) size < 8 ? 8 : size
@@ -17,10 +36,20 @@
 #define SET_FORWARD_FLAG(ptr, val) FORWARD_FLAG(ptr) = val
 #define FORWARD_ADDRESS(ptr) *((void**) ptr)
 #define SET_FORWARD_ADDRESS(ptr, val) FORWARD_ADDRESS(ptr) = val
-#define ON_HEAP(gc, ptr) (((uint8_t*) ptr) >= gc->from_space && ((uint8_t*) ptr) <= gc->from_space + gc->size)
+#define ON_HEAP(gc, ptr) (((uint8_t*) ptr) >= gc->from_space && ((uint8_t*) ptr) < gc->from_space + gc->size / 2)
+
+#define LIVE_MAP_WORD(reg) ((reg) / 64)
+#define LIVE_MAP_BIT(reg) (1ULL << ((reg) % 64))
+#define LIVE_MAP_HAS(map, reg) ((map)->live[LIVE_MAP_WORD(reg)] & LIVE_MAP_BIT(reg))
 
 uint64_t bytes_allocated = 0;
 static owl_term copy(owl_term term, vm_t* vm);
+static void parallel_collect(vm_t *vm);
+static void start_cycle(vm_t *vm);
+static void finish_cycle(vm_t *vm);
+static void incremental_step(vm_t *vm);
+static void immix_collect(vm_t *vm);
+static bool nearly_full(GCState *gc);
 
 static inline uint32_t align(uint32_t size) {
   return size % ALIGNMENT == 0 ? size : size + (ALIGNMENT - (size % ALIGNMENT));
@@ -43,6 +72,46 @@ void forward(void* old, void* new) {
   SET_FORWARD_FLAG(old, true);
 }
 
+// Called on every object that a collector copies, with the original left as it
+// was apart from its forwarding address. Small lists point their tail at their
+// own copy of it.
+static inline void moved(owl_term term, void *from, void *to) {
+  if (owl_tag_of(term) == LIST && rrb_is_small((RRB*) from)) {
+    ((RRB*) to)->tail = rrb_inline_tail(to);
+  }
+}
+
+// Whether the collectors need to look inside the term. Strings hold no
+// references, unless they are ropes or slices.
+static inline bool has_refs(owl_term term) {
+  return owl_tag_of(term) != STRING || owl_string_kind(term) != FLAT_STRING;
+}
+
+// A slice keeps all of the string it was sliced out of alive. The copying
+// collectors copy the bytes of a slice that is only a small part of it out
+// into a flat string instead, so that the rest can go if nothing else needs
+// it. The mark-region collector leaves slices as they are.
+#define SLICE_DETACH_RATIO 4
+
+static inline bool detaches(owl_term term) {
+  return owl_tag_of(term) == STRING && owl_string_kind(term) == SLICE_STRING &&
+    (uint64_t) owl_string_length(term) * SLICE_DETACH_RATIO < owl_string_length(owl_to_slice(term)->parent);
+}
+
+// Fills in `to`, of owl_string_size bytes, as a flat string with the bytes of
+// `slice`
+static void detach(OwlString *to, owl_term slice) {
+  const OwlSlice *from = owl_to_slice(slice);
+
+  to->hash = from->hash;
+  to->length = from->length;
+  to->hashed = from->hashed;
+  to->kind = FLAT_STRING;
+  to->depth = 0;
+  memcpy(to->chars, owl_string_bytes(slice), from->length);
+  to->chars[from->length] = '\0';
+}
+
 // Returns the number of bytes that this term takes up on the heap
 // For terms that are not heap-allocated, returns 0
 static uint32_t heap_size_of(owl_term term) {
@@ -58,7 +127,13 @@ static uint32_t heap_size_of(owl_term term) {
         return align((tuple_length + 1) * sizeof(owl_term));
       }
     case STRING:
-      return align(strlen(owl_extract_ptr(term)));
+      if (owl_string_kind(term) == ROPE_STRING) {
+        return align(sizeof(OwlRope));
+      }
+      if (owl_string_kind(term) == SLICE_STRING) {
+        return align(sizeof(OwlSlice));
+      }
+      return align(owl_string_size(owl_string_length(term)));
     case FUNCTION:
       {
         Function* fun = owl_extract_ptr(term);
@@ -67,9 +142,17 @@ static uint32_t heap_size_of(owl_term term) {
     case LIST:
       if (owl_list_is_empty(term)) {
         return 0;
+      } else if (rrb_is_small(list_to_rrb(term))) {
+        return align(sizeof(RRB) + sizeof(LeafNode) + list_to_rrb(term)->tail_len * sizeof(void *));
       } else {
         return align(sizeof(RRB));
       }
+    case MAP:
+      if (owl_map_is_empty(term)) {
+        return 0;
+      } else {
+        return align(map_node_size(map_to_node(term)->len));
+      }
     case POINTER:
       die("POINTER");
     default:
@@ -77,6 +160,347 @@ static uint32_t heap_size_of(owl_term term) {
   }
 }
 
+// Large object space
+
+#define LARGE_OBJECT_SIZE 4096
+
+struct LargeObject {
+  uint64_t size;                       // Bytes mapped, including this header
+  uint8_t marked;
+  uint8_t padding[7];
+};
+
+#define LARGE_OBJECT_DATA(large) ((void*) ((large) + 1))
+
+static void* large_alloc(GCState *gc, uint32_t size) {
+  uint64_t mapped_size = sizeof(LargeObject) + size;
+  LargeObject *large = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+
+  if (large == MAP_FAILED) {
+    die("Insufficient memory");
+  }
+  large->size = mapped_size;
+  large->marked = false;
+
+  if (gc->large_count == gc->large_capacity) {
+    gc->large_capacity = gc->large_capacity == 0 ? 16 : gc->large_capacity * 2;
+    gc->large_objects = realloc(gc->large_objects, gc->large_capacity * sizeof(LargeObject*));
+  }
+
+  uint32_t index = gc->large_count;
+  while (index > 0 && gc->large_objects[index - 1] > large) {
+    gc->large_objects[index] = gc->large_objects[index - 1];
+    index--;
+  }
+  gc->large_objects[index] = large;
+  gc->large_count++;
+  gc->large_bytes += mapped_size;
+
+  return LARGE_OBJECT_DATA(large);
+}
+
+static LargeObject* large_object_of(GCState *gc, owl_term term) {
+  if (gc->large_count == 0 || owl_tag_of(term) == INT) {
+    return NULL;
+  }
+
+  LargeObject *wanted = ((LargeObject*) owl_extract_ptr(term)) - 1;
+  uint32_t low = 0;
+  uint32_t high = gc->large_count;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (gc->large_objects[mid] == wanted) {
+      return wanted;
+    } else if (gc->large_objects[mid] < wanted) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  return NULL;
+}
+
+// Unmaps everything that was not marked during the collection that just ended
+static void large_sweep(GCState *gc) {
+  uint32_t kept = 0;
+  gc->large_bytes = 0;
+
+  for (uint32_t i = 0; i < gc->large_count; i++) {
+    LargeObject *large = gc->large_objects[i];
+
+    if (large->marked) {
+      large->marked = false;
+      gc->large_bytes += large->size;
+      gc->large_objects[kept++] = large;
+    } else {
+      munmap(large, large->size);
+    }
+  }
+
+  gc->large_count = kept;
+  gc->large_limit = gc->large_bytes * 2 > gc->size ? gc->large_bytes * 2 : gc->size;
+}
+
+// Mark-region collection
+//
+// With OWL_GC=immix the heap is not split into two semispaces. The whole of it
+// is divided into blocks, and blocks into lines. The allocator bumps through
+// runs of free lines, a collection marks live objects along with the lines they
+// cover, and every line left unmarked is handed out again afterwards.
+//
+// Objects normally stay where they are. When the live lines of a block were
+// left mostly empty by the previous collection, its live objects are moved into
+// an empty block instead, as long as one is available, so that fragmented
+// blocks free up. Should a collection still leave the heap nearly full, a second
+// pass right away moves objects out of the sparsest blocks into the holes that
+// the first pass found in the others.
+
+#define IMMIX_BLOCK_SIZE 8192
+#define IMMIX_LINE_SIZE 128
+#define IMMIX_LINES_PER_BLOCK (IMMIX_BLOCK_SIZE / IMMIX_LINE_SIZE)
+#define IMMIX_EVACUATE_PERCENT 50     // Blocks whose live lines are less full than this get evacuated
+#define IMMIX_HEADROOM_PERCENT 12     // Empty blocks kept back from the program for evacuation
+#define IMMIX_NO_BLOCK UINT32_MAX
+
+// Mark values count up, so that no collection reuses the one before it even
+// when it makes two passes, and unreached objects never look marked
+#define IMMIX_FIRST_MARK 2
+
+#define IN_IMMIX(heap, ptr) (((uint8_t*) ptr) >= heap->start && ((uint8_t*) ptr) < heap->start + heap->size)
+
+typedef struct ImmixBlock {
+  uint32_t live_lines;                 // As of the last collection
+  uint32_t live_bytes;                 // As of the last collection, counted again while marking
+  bool touched;                        // Claimed by an allocator since the last collection
+  bool evacuate;                       // Live objects are moved out during this collection
+} ImmixBlock;
+
+typedef struct ImmixAllocator {
+  uint32_t block;                      // Block being allocated into
+  uint32_t line;                       // First line of it not handed out yet
+  uint8_t *cursor;
+  uint8_t *limit;
+  bool empty_only;                     // Only claims blocks without any live lines
+} ImmixAllocator;
+
+struct ImmixHeap {
+  uint8_t *start;
+  uint64_t size;
+  uint32_t n_blocks;
+  ImmixBlock *blocks;
+  uint8_t *line_marks;                 // One per line, set for lines live after the last collection
+  uint8_t *next_marks;                 // Lines marked by the collection in progress
+  uint8_t mark;                        // Header value of objects marked by the last collection
+  uint64_t available;                  // Free bytes in blocks no allocator has claimed
+  uint32_t headroom;                   // Number of empty blocks kept back for evacuation
+  uint32_t *candidates;                // Scratch space for picking blocks to evacuate
+  ImmixAllocator small;
+  ImmixAllocator overflow;             // Objects larger than a line that did not fit the current hole
+  ImmixAllocator evacuator;
+};
+
+// List compaction
+//
+// Concatenating and slicing lists leaves their trees with leaves that are not
+// full, and size tables that every lookup has to search through. With
+// OWL_GC_COMPACT_LISTS set, the serial collector rebuilds such lists once
+// everything live has been copied: elements are packed into full leaves, and
+// the internal nodes above them need no size tables, so indexing goes back to
+// plain radix steps.
+//
+// Lists that share any node with another live list are left alone, as a
+// rebuilt list would no longer share it. Sharing only shows once every
+// reference has been followed, which is why rebuilding waits until the end,
+// and the nodes a rebuilt list used to have stay behind in to-space until the
+// next collection.
+
+struct ListCompaction {
+  owl_term *relaxed;                   // Copies of lists with size tables, candidates for rebuilding
+  uint32_t relaxed_count;
+  uint32_t relaxed_capacity;
+  void **shared;                       // Open addressing set of copied nodes reached more than once
+  uint64_t shared_count;
+  uint64_t shared_capacity;
+};
+
+ListCompaction* gc_compaction_new(void) {
+  ListCompaction *compaction = calloc(1, sizeof(ListCompaction));
+
+  compaction->shared_capacity = 256;
+  compaction->shared = calloc(compaction->shared_capacity, sizeof(void*));
+  return compaction;
+}
+
+// Whether the collections that run rebuild lists, only serial ones do
+bool gc_compacts_lists(GCState *gc) {
+  return gc->compaction && !gc->immix && !gc->pause_budget && gc->threads <= 1;
+}
+
+static uint64_t shared_slot(void *node, uint64_t capacity) {
+  return ((uint64_t) node * 0x9E3779B97F4A7C15ULL >> 17) & (capacity - 1);
+}
+
+static bool is_shared(ListCompaction *compaction, void *node) {
+  uint64_t slot = shared_slot(node, compaction->shared_capacity);
+
+  while (compaction->shared[slot]) {
+    if (compaction->shared[slot] == node) {
+      return true;
+    }
+    slot = (slot + 1) & (compaction->shared_capacity - 1);
+  }
+  return false;
+}
+
+static void remember_shared(ListCompaction *compaction, void *node) {
+  if (is_shared(compaction, node)) {
+    return;
+  }
+
+  if ((compaction->shared_count + 1) * 2 > compaction->shared_capacity) {
+    void **old = compaction->shared;
+    uint64_t old_capacity = compaction->shared_capacity;
+
+    compaction->shared_capacity *= 2;
+    compaction->shared = calloc(compaction->shared_capacity, sizeof(void*));
+    compaction->shared_count = 0;
+    for (uint64_t i = 0; i < old_capacity; i++) {
+      if (old[i]) {
+        remember_shared(compaction, old[i]);
+      }
+    }
+    free(old);
+  }
+
+  uint64_t slot = shared_slot(node, compaction->shared_capacity);
+  while (compaction->shared[slot]) {
+    slot = (slot + 1) & (compaction->shared_capacity - 1);
+  }
+  compaction->shared[slot] = node;
+  compaction->shared_count++;
+}
+
+static void remember_relaxed(ListCompaction *compaction, owl_term list) {
+  if (compaction->relaxed_count == compaction->relaxed_capacity) {
+    compaction->relaxed_capacity = compaction->relaxed_capacity == 0 ? 64 : compaction->relaxed_capacity * 2;
+    compaction->relaxed = realloc(compaction->relaxed, compaction->relaxed_capacity * sizeof(owl_term));
+  }
+  compaction->relaxed[compaction->relaxed_count++] = list;
+}
+
+static bool list_is_relaxed(RRB *rrb) {
+  return rrb->root && rrb->root->type == INTERNAL_NODE && ((InternalNode*) rrb->root)->size_table;
+}
+
+// Returns false if any node under `node` is shared, otherwise adds up the
+// leaves and copies out the elements in order
+static bool gather_elements(ListCompaction *compaction, TreeNode *node, owl_term *elements, uint32_t *n) {
+  if (is_shared(compaction, node)) {
+    return false;
+  }
+
+  if (node->type == LEAF_NODE) {
+    LeafNode *leaf = (LeafNode*) node;
+    memcpy(elements + *n, leaf->child, leaf->len * sizeof(owl_term));
+    *n += leaf->len;
+    return true;
+  }
+
+  InternalNode *internal = (InternalNode*) node;
+  for (uint32_t i = 0; i < internal->len; i++) {
+    if (!gather_elements(compaction, (TreeNode*) internal->child[i], elements, n)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void* bump_node(vm_t *vm, uint32_t size) {
+  memset(vm->gc->alloc_ptr, 0, size + 1);
+  void* node = vm->gc->alloc_ptr + 1;
+  vm->gc->alloc_ptr += size + 1;
+  return node;
+}
+
+static void compact_list(vm_t *vm, RRB *rrb, owl_term *elements) {
+  // Every leaf in the tree is full, whatever is left over goes in the tail
+  uint32_t tail_len = rrb->cnt - (rrb->cnt - 1) / RRB_BRANCHING * RRB_BRANCHING;
+  uint32_t n_nodes = (rrb->cnt - tail_len) / RRB_BRANCHING;
+  uint32_t node_size = sizeof(InternalNode) + RRB_BRANCHING * sizeof(void*) + 1;
+
+  // A node for every leaf, and fewer than one for every leaf above them
+  if (vm->gc->alloc_ptr + (2 * n_nodes + RRB_MAX_HEIGHT + 1) * node_size > vm->gc->to_space + vm->gc->size / 2) {
+    return;
+  }
+
+  TreeNode **nodes = malloc((n_nodes + 1) * sizeof(TreeNode*));
+  for (uint32_t i = 0; i < n_nodes; i++) {
+    LeafNode *leaf = bump_node(vm, sizeof(LeafNode) + RRB_BRANCHING * sizeof(void*));
+    leaf->type = LEAF_NODE;
+    leaf->len = RRB_BRANCHING;
+    leaf->flags = ints_only(elements + i * RRB_BRANCHING, RRB_BRANCHING) ? LEAF_INTS : 0;
+    memcpy(leaf->child, elements + i * RRB_BRANCHING, RRB_BRANCHING * sizeof(void*));
+    nodes[i] = (TreeNode*) leaf;
+  }
+
+  LeafNode *tail = bump_node(vm, sizeof(LeafNode) + tail_len * sizeof(void*));
+  tail->type = LEAF_NODE;
+  tail->len = tail_len;
+  tail->flags = ints_only(elements + rrb->cnt - tail_len, tail_len) ? LEAF_INTS : 0;
+  memcpy(tail->child, elements + rrb->cnt - tail_len, tail_len * sizeof(void*));
+
+  uint32_t shift = 0;
+  while (n_nodes > 1) {
+    uint32_t n_parents = (n_nodes - 1) / RRB_BRANCHING + 1;
+
+    for (uint32_t i = 0; i < n_parents; i++) {
+      uint32_t remaining = n_nodes - i * RRB_BRANCHING;
+      uint32_t len = remaining < RRB_BRANCHING ? remaining : RRB_BRANCHING;
+      InternalNode *parent = bump_node(vm, sizeof(InternalNode) + len * sizeof(InternalNode*));
+      parent->type = INTERNAL_NODE;
+      parent->len = len;
+      memcpy(parent->child, nodes + i * RRB_BRANCHING, len * sizeof(InternalNode*));
+      nodes[i] = (TreeNode*) parent;
+    }
+
+    n_nodes = n_parents;
+    shift += RRB_BITS;
+  }
+
+  rrb->root = n_nodes > 0 ? nodes[0] : NULL;
+  rrb->shift = shift;
+  rrb->tail = tail;
+  rrb->tail_len = tail_len;
+  vm->gc->stats.lists_compacted++;
+
+  free(nodes);
+}
+
+// Runs after everything live has been copied, when the copies of lists hold
+// nothing but to-space references
+static void compact_relaxed_lists(vm_t *vm) {
+  ListCompaction *compaction = vm->gc->compaction;
+
+  for (uint32_t i = 0; i < compaction->relaxed_count; i++) {
+    RRB *rrb = owl_extract_ptr(compaction->relaxed[i]);
+    owl_term *elements = malloc(rrb->cnt * sizeof(owl_term));
+    uint32_t n = 0;
+
+    if (gather_elements(compaction, rrb->root, elements, &n) &&
+        gather_elements(compaction, (TreeNode*) rrb->tail, elements, &n)) {
+      compact_list(vm, rrb, elements);
+    }
+    free(elements);
+  }
+
+  compaction->relaxed_count = 0;
+  if (compaction->shared_count > 0) {
+    memset(compaction->shared, 0, compaction->shared_capacity * sizeof(void*));
+    compaction->shared_count = 0;
+  }
+}
+
 static void* bump_cpy(vm_t *vm, void *from, uint32_t size) {
   uint32_t block_size = ENFORE_MINIMUM(size);
 
@@ -89,14 +513,24 @@ static void* bump_cpy(vm_t *vm, void *from, uint32_t size) {
 }
 
 static TreeNode* copy_list_node(TreeNode *node, vm_t* vm) {
+  // Nodes outside of the heap, like the empty leaf that new builders start
+  // with or those of constants, are left where they are
+  if (!ON_HEAP(vm->gc, node)) {
+    return node;
+  }
+
   if (FORWARD_FLAG(node)) {
+    if (vm->gc->compaction) {
+      remember_shared(vm->gc->compaction, FORWARD_ADDRESS(node));
+    }
     return (TreeNode*) FORWARD_ADDRESS(node);
   }
 
   if (node->type == LEAF_NODE) {
     LeafNode *leaf = (LeafNode*) node;
 
-    for (uint32_t i = 0; i < leaf->len; i++) {
+    // Ints are copied along with the leaf
+    for (uint32_t i = 0; !(leaf->flags & LEAF_INTS) && i < leaf->len; i++) {
       leaf->child[i] = (void*) copy((owl_term) leaf->child[i], vm);
     }
 
@@ -108,7 +542,7 @@ static TreeNode* copy_list_node(TreeNode *node, vm_t* vm) {
       internal->child[i] = (InternalNode*) copy_list_node((TreeNode*) internal->child[i], vm);
     }
 
-    if (internal->size_table) {
+    if (internal->size_table && ON_HEAP(vm->gc, internal->size_table)) {
       internal->size_table = bump_cpy(vm, internal->size_table, sizeof(RRBSizeTable) + internal->len * sizeof(uint32_t));
     }
     return bump_cpy(vm, internal, sizeof(InternalNode) + internal->len * sizeof(InternalNode *));
@@ -118,7 +552,21 @@ static TreeNode* copy_list_node(TreeNode *node, vm_t* vm) {
 static void copy_refs(owl_term term, vm_t *vm) {
   switch(owl_tag_of(term)) {
     case STRING:
-      return;
+      {
+        if (owl_string_kind(term) == SLICE_STRING) {
+          owl_to_slice(term)->parent = copy(owl_to_slice(term)->parent, vm);
+        }
+        if (!owl_string_is_rope(term)) {
+          return;
+        }
+        OwlRope *rope = owl_to_rope(term);
+        if (rope->flat) {
+          rope->flat = copy(rope->flat, vm);
+        }
+        rope->left = copy(rope->left, vm);
+        rope->right = copy(rope->right, vm);
+        return;
+      }
     case TUPLE:
       {
         owl_term *ary = owl_extract_ptr(term);
@@ -142,21 +590,159 @@ static void copy_refs(owl_term term, vm_t *vm) {
     case LIST:
       {
         RRB *rrb = owl_extract_ptr(term);
+        if (vm->gc->compaction && list_is_relaxed(rrb)) {
+          remember_relaxed(vm->gc->compaction, term);
+        }
+        if (rrb_is_small(rrb)) {
+          for (uint32_t i = 0; !(rrb->tail->flags & LEAF_INTS) && i < rrb->tail_len; i++) {
+            rrb->tail->child[i] = (void*) copy((owl_term) rrb->tail->child[i], vm);
+          }
+          return;
+        }
         if (rrb->root) {
           rrb->root = copy_list_node(rrb->root, vm);
         }
         rrb->tail = (LeafNode*) copy_list_node((TreeNode*) rrb->tail, vm);
         return;
       }
+    case MAP:
+      {
+        MapNode *node = owl_extract_ptr(term);
+        for (uint32_t i = 0; i < node->len * 2; i++) {
+          if (node->slots[i]) {
+            node->slots[i] = copy(node->slots[i], vm);
+          }
+        }
+        return;
+      }
     default:
       die("Cannot copy refs");
   }
 }
 
+// String deduplication
+//
+// With OWL_GC_DEDUP=<min length> set, strings at least that long are looked up
+// by their contents as they are copied. A string equal to one already copied
+// during the same collection is forwarded to that copy instead of getting its
+// own. Strings are immutable, so nothing can tell the two apart afterwards.
+//
+// Only the serial and incremental collectors deduplicate. Parallel workers
+// copy at the same time without coordinating, and mark-region collections
+// leave most strings where they are.
+
+typedef struct DedupEntry {
+  uint64_t hash;
+  OwlString *string;                   // Copy in to-space, NULL marks a free slot
+} DedupEntry;
+
+struct StringDedup {
+  uint32_t min_length;
+  DedupEntry *entries;
+  uint64_t count;
+  uint64_t capacity;
+};
+
+StringDedup* gc_dedup_new(uint32_t min_length) {
+  StringDedup *dedup = calloc(1, sizeof(StringDedup));
+
+  dedup->min_length = min_length;
+  dedup->capacity = 1024;
+  dedup->entries = calloc(dedup->capacity, sizeof(DedupEntry));
+  return dedup;
+}
+
+// Length from which the collections that run share equal strings, 0 if they
+// share none. OWL_GC_DEDUP=0 reads as 1, sharing empty strings saves nothing.
+uint32_t gc_dedup_min_length(GCState *gc) {
+  if (!gc->dedup || gc->immix || (!gc->pause_budget && gc->threads > 1)) {
+    return 0;
+  }
+  return gc->dedup->min_length > 0 ? gc->dedup->min_length : 1;
+}
+
+// FNV-1a
+static uint64_t hash_string(const OwlString *string) {
+  uint64_t hash = 0xCBF29CE484222325ULL;
+
+  for (uint32_t i = 0; i < string->length; i++) {
+    hash ^= (uint8_t) string->chars[i];
+    hash *= 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+// Copies from an earlier collection are about to be freed
+static void dedup_reset(GCState *gc) {
+  if (gc->dedup && gc->dedup->count > 0) {
+    memset(gc->dedup->entries, 0, gc->dedup->capacity * sizeof(DedupEntry));
+    gc->dedup->count = 0;
+  }
+}
+
+static bool dedup_candidate(GCState *gc, owl_term term) {
+  return gc->dedup && owl_tag_of(term) == STRING && owl_string_kind(term) == FLAT_STRING &&
+    owl_string_length(term) >= gc->dedup->min_length;
+}
+
+// Returns the copy of an equal string made earlier in this collection, or
+// NULL if `string` needs a copy of its own
+static OwlString* dedup_find(GCState *gc, const OwlString *string, uint64_t hash, uint32_t heap_size) {
+  StringDedup *dedup = gc->dedup;
+  uint64_t slot = hash & (dedup->capacity - 1);
+
+  while (dedup->entries[slot].string) {
+    DedupEntry *entry = &dedup->entries[slot];
+    if (entry->hash == hash && entry->string->length == string->length &&
+        memcmp(entry->string->chars, string->chars, string->length) == 0) {
+      gc->stats.strings_deduped++;
+      gc->stats.cycle_deduped += heap_size + 1;
+      return entry->string;
+    }
+    slot = (slot + 1) & (dedup->capacity - 1);
+  }
+
+  return NULL;
+}
+
+static void dedup_remember(GCState *gc, OwlString *copied, uint64_t hash) {
+  StringDedup *dedup = gc->dedup;
+
+  if ((dedup->count + 1) * 2 > dedup->capacity) {
+    DedupEntry *old = dedup->entries;
+    uint64_t old_capacity = dedup->capacity;
+
+    dedup->capacity *= 2;
+    dedup->entries = calloc(dedup->capacity, sizeof(DedupEntry));
+    for (uint64_t i = 0; i < old_capacity; i++) {
+      if (old[i].string) {
+        uint64_t slot = old[i].hash & (dedup->capacity - 1);
+        while (dedup->entries[slot].string) {
+          slot = (slot + 1) & (dedup->capacity - 1);
+        }
+        dedup->entries[slot] = old[i];
+      }
+    }
+    free(old);
+  }
+
+  uint64_t slot = hash & (dedup->capacity - 1);
+  while (dedup->entries[slot].string) {
+    slot = (slot + 1) & (dedup->capacity - 1);
+  }
+  dedup->entries[slot] = (DedupEntry) {hash, copied};
+  dedup->count++;
+}
+
 static owl_term copy(owl_term term, vm_t* vm) {
   void* object = owl_extract_ptr(term);
 
   if(!ON_HEAP(vm->gc, object)) {
+    LargeObject *large = large_object_of(vm->gc, term);
+    if (large && !large->marked) {
+      large->marked = true;
+      copy_refs(term, vm);
+    }
     return term;
   }
 
@@ -171,15 +757,41 @@ static owl_term copy(owl_term term, vm_t* vm) {
     return term;
   }
 
+  if (detaches(term)) {
+    uint32_t detached_size = align(owl_string_size(owl_string_length(term)));
+    gc_check_overlflow(vm, detached_size);
+
+    OwlString *detached = (OwlString*) (vm->gc->alloc_ptr + 1);
+    vm->gc->alloc_ptr += detached_size + 1;
+    detach(detached, term);
+    forward(object, detached);
+    return string_to_owl(detached);
+  }
+
+  bool dedup = dedup_candidate(vm->gc, term);
+  uint64_t hash = 0;
+  if (dedup) {
+    hash = hash_string(object);
+    OwlString *shared = dedup_find(vm->gc, object, hash, heap_size);
+    if (shared) {
+      forward(object, shared);
+      return owl_tag_as(shared, STRING);
+    }
+  }
+
   gc_check_overlflow(vm, heap_size);
 
   void* copied = vm->gc->alloc_ptr + 1;
   vm->gc->alloc_ptr += heap_size + 1;
   memcpy(copied, object, heap_size);
+  moved(term, object, copied);
   owl_term copied_term = owl_tag_as(copied, owl_tag_of(term));
   copy_refs(copied_term, vm);
 
   forward(object, copied);
+  if (dedup) {
+    dedup_remember(vm->gc, copied, hash);
+  }
 
   return copied_term;
 }
@@ -192,45 +804,1427 @@ static void swap_spaces(GCState* gc) {
 }
 
 uint32_t gc_usage(vm_t *vm) {
-  return vm->gc->alloc_ptr - vm->gc->to_space;
+  if (vm->gc->immix) {
+    return vm->gc->immix->size - vm->gc->immix->available + vm->gc->large_bytes;
+  }
+  return vm->gc->alloc_ptr - vm->gc->to_space + vm->gc->large_bytes;
 }
 
-void gc_collect(vm_t *vm) {
-  swap_spaces(vm->gc);
+void gc_add_live_map(vm_t *vm, uint64_t call_site, uint64_t return_address, uint8_t *registers, uint8_t n_registers) {
+  if (vm->live_map_count == vm->live_map_capacity) {
+    vm->live_map_capacity = vm->live_map_capacity == 0 ? 64 : vm->live_map_capacity * 2;
+    vm->live_maps = realloc(vm->live_maps, vm->live_map_capacity * sizeof(LiveMap));
+  }
+
+  LiveMap *map = &vm->live_maps[vm->live_map_count++];
+  memset(map, 0, sizeof(LiveMap));
+  map->call_site = call_site;
+  map->return_address = return_address;
+
+  for (uint8_t i = 0; i < n_registers; i++) {
+    map->live[LIVE_MAP_WORD(registers[i])] |= LIVE_MAP_BIT(registers[i]);
+  }
+}
+
+static LiveMap* search_live_map(vm_t *vm, uint64_t location, bool at_call_site) {
+  uint64_t low = 0;
+  uint64_t high = vm->live_map_count;
+  while (low < high) {
+    uint64_t mid = low + (high - low) / 2;
+    LiveMap *map = &vm->live_maps[mid];
+    uint64_t key = at_call_site ? map->call_site : map->return_address;
+
+    if (key == location) {
+      return map;
+    } else if (key < location) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  die("No live map for call site");
+  return NULL;
+}
+
+// The frame on top of the stack is stopped at the safepoint instruction itself,
+// every frame below it is waiting for the call it made to return.
+static LiveMap* find_live_map(vm_t *vm, uint32_t frame) {
+  bool top = frame == vm->current_frame;
+  uint64_t location = top ? vm->ip : vm->frames[frame + 1].ret_address;
+
+  return search_live_map(vm, location, top);
+}
+
+// Where execution continues after the safepoint instruction at `call_site`
+uint64_t gc_return_address(vm_t *vm, uint64_t call_site) {
+  return search_live_map(vm, call_site, true)->return_address;
+}
 
+// Only registers that the compiler marked as live are roots, along with the
+// terms rooted by native code. Anything else left behind in a frame is garbage
+// and never looked at. Each root is replaced with whatever `visit` returns for it.
+void gc_visit_roots(vm_t *vm, root_visitor visit, void *context) {
   for (uint32_t i = 0; i <= vm->current_frame; i++) {
-    for (uint32_t j = 0; j < REGISTER_COUNT; j++) {
-      owl_term object = vm->frames[i].registers[j];
-      if (object) {
-        vm->frames[i].registers[j] = copy(object, vm);
+    frame_t *frame = &vm->frames[i];
+    LiveMap *map = find_live_map(vm, i);
+
+    for (uint32_t reg = 0; reg < REGISTER_COUNT; reg++) {
+      if (LIVE_MAP_HAS(map, reg) && frame->registers[reg]) {
+        frame->registers[reg] = visit(context, frame->registers[reg]);
       }
     }
+
+    // Anonymous functions are kept alive by the frames executing them
+    if (frame->function) {
+      frame->function = owl_term_to_function(visit(context, owl_function_from(frame->function)));
+    }
   }
+
+  for (uint32_t i = 0; i < vm->native_root_count; i++) {
+    if (vm->native_roots[i]) {
+      vm->native_roots[i] = visit(context, vm->native_roots[i]);
+    }
+  }
+
+  vm->current_function = vm->frames[vm->current_frame].function;
 }
 
-void gc_safepoint(vm_t* vm) {
-  uint64_t space_size = vm->gc->size / 2;
-  uint64_t end = (uint64_t) vm->gc->to_space + space_size;
-  uint64_t buffer = space_size * (BUFFER_PERCENT / 100.0);
+static owl_term copy_root(void *vm, owl_term term) {
+  return copy(term, vm);
+}
 
-  if ((uint64_t) vm->gc->alloc_ptr + buffer > end) {
-    gc_collect(vm);
+// List nodes are queued tagged as POINTER
+void gc_scan_refs(owl_term item, const Tracer *tracer, void *context) {
+  switch(owl_tag_of(item)) {
+    case STRING:
+      {
+        if (owl_string_kind(item) == SLICE_STRING) {
+          owl_to_slice(item)->parent = tracer->term(context, owl_to_slice(item)->parent);
+        }
+        if (!owl_string_is_rope(item)) {
+          return;
+        }
+        OwlRope *rope = owl_to_rope(item);
+        if (rope->flat) {
+          rope->flat = tracer->term(context, rope->flat);
+        }
+        rope->left = tracer->term(context, rope->left);
+        rope->right = tracer->term(context, rope->right);
+        return;
+      }
+    case TUPLE:
+      {
+        owl_term *ary = owl_extract_ptr(item);
+        uint32_t tuple_length = ary[0];
+        for(uint32_t i = 1; i <= tuple_length; i++) {
+          ary[i] = tracer->term(context, ary[i]);
+        }
+        return;
+      }
+    case FUNCTION:
+      {
+        Function *fun = owl_extract_ptr(item);
+        for(int i = 0; i < fun->n_upvalues; i++) {
+          if (fun->upvalues[i]) {
+            fun->upvalues[i] = tracer->term(context, fun->upvalues[i]);
+          }
+        }
+        return;
+      }
+    case LIST:
+      {
+        RRB *rrb = owl_extract_ptr(item);
+        if (rrb_is_small(rrb)) {
+          for (uint32_t i = 0; !(rrb->tail->flags & LEAF_INTS) && i < rrb->tail_len; i++) {
+            rrb->tail->child[i] = (void*) tracer->term(context, (owl_term) rrb->tail->child[i]);
+          }
+          return;
+        }
+        if (rrb->root) {
+          rrb->root = tracer->node(context, rrb->root);
+        }
+        rrb->tail = tracer->node(context, (TreeNode*) rrb->tail);
+        return;
+      }
+    case MAP:
+      {
+        MapNode *node = owl_extract_ptr(item);
+        for (uint32_t i = 0; i < node->len * 2; i++) {
+          if (node->slots[i]) {
+            node->slots[i] = tracer->term(context, node->slots[i]);
+          }
+        }
+        return;
+      }
+    case POINTER:
+      {
+        TreeNode *node = owl_extract_ptr(item);
+        if (node->type == LEAF_NODE) {
+          LeafNode *leaf = (LeafNode*) node;
+          for (uint32_t i = 0; !(leaf->flags & LEAF_INTS) && i < leaf->len; i++) {
+            leaf->child[i] = (void*) tracer->term(context, (owl_term) leaf->child[i]);
+          }
+        } else {
+          InternalNode *internal = (InternalNode*) node;
+          for (uint32_t i = 0; i < internal->len; i++) {
+            internal->child[i] = tracer->node(context, (TreeNode*) internal->child[i]);
+          }
+          if (internal->size_table) {
+            internal->size_table = tracer->size_table(context, internal->size_table, internal->len);
+          }
+        }
+        return;
+      }
+    default:
+      die("Cannot copy refs");
   }
 }
 
-uint64_t gc_bytes_allocated() {
-  return bytes_allocated;
+// Size of a list node, which does not carry a tag of its own
+static uint32_t node_size_of(TreeNode *node) {
+  return node->type == LEAF_NODE
+    ? sizeof(LeafNode) + node->len * sizeof(void *)
+    : sizeof(InternalNode) + node->len * sizeof(InternalNode *);
 }
 
-void* owl_alloc(vm_t *vm, uint32_t N) {
-  uint32_t block_size = align(N) + 1;
+// Bytes taken up by a term, or by a list node tagged as POINTER. Zero for
+// terms that are not allocated at all.
+uint32_t gc_object_size(owl_term term) {
+  if (owl_tag_of(term) == POINTER) {
+    return node_size_of(owl_extract_ptr(term));
+  }
+  return owl_tag_of(term) == INT ? 0 : heap_size_of(term);
+}
 
-  gc_check_overlflow(vm, block_size);
+uint64_t gc_clock(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000000000ULL + time.tv_nsec;
+}
 
-  uint8_t* object = vm->gc->alloc_ptr;
-  vm->gc->alloc_ptr += block_size;
+static void record_pause(GCState *gc, uint64_t nanoseconds) {
+  uint32_t bucket = 0;
+  while (bucket < GC_PAUSE_BUCKETS - 1 && (1000ULL << bucket) <= nanoseconds) {
+    bucket++;
+  }
+
+  gc->pauses[bucket]++;
+  gc->stats.cycle_pause += nanoseconds;
+  if (nanoseconds > gc->max_pause) {
+    gc->max_pause = nanoseconds;
+  }
+}
+
+static void begin_collection(vm_t *vm) {
+  GCStats *stats = &vm->gc->stats;
+
+  stats->usage_before = gc_usage(vm);
+  stats->cycle_copied = 0;
+  stats->cycle_deduped = 0;
+  stats->cycle_pause = 0;
+  if (stats->usage_before > stats->usage_peak) {
+    stats->usage_peak = stats->usage_before;
+  }
+}
+
+static void end_collection(vm_t *vm) {
+  GCState *gc = vm->gc;
+  GCStats *stats = &gc->stats;
+
+  stats->collections++;
+  stats->pause_last = stats->cycle_pause;
+  stats->pause_total += stats->cycle_pause;
+  stats->bytes_copied += stats->cycle_copied;
+  stats->bytes_deduped += stats->cycle_deduped;
+  stats->usage_after = gc_usage(vm);
+
+  // Mark-region collections report to the profiler after each of their passes
+  if (gc->profile && !gc->immix) {
+    heap_profile_collected(vm);
+  }
+
+  if (gc->log) {
+    const char *mode = gc->immix ? "immix" : gc->pause_budget ? "incremental" : gc->threads > 1 ? "parallel" : "serial";
+    fprintf(stderr, "[gc] #%llu %s pause=%lluus used=%llu->%llu copied=%llu large=%llu survival=%llu%%",
+            (unsigned long long) stats->collections, mode,
+            (unsigned long long) stats->pause_last / 1000,
+            (unsigned long long) stats->usage_before,
+            (unsigned long long) stats->usage_after,
+            (unsigned long long) stats->cycle_copied,
+            (unsigned long long) gc->large_bytes,
+            (unsigned long long) gc_survival_rate(vm));
+    if (gc->dedup) {
+      fprintf(stderr, " deduped=%llu", (unsigned long long) stats->cycle_deduped);
+    }
+    fprintf(stderr, "\n");
+  }
+}
+
+uint64_t gc_survival_rate(vm_t *vm) {
+  GCStats *stats = &vm->gc->stats;
+
+  if (stats->usage_before == 0) {
+    return 100;
+  }
+
+  // Survivors of a mark-region collection mostly stay where they are
+  uint64_t survived = vm->gc->immix ? stats->usage_after : stats->cycle_copied + vm->gc->large_bytes;
+  return survived * 100 / stats->usage_before;
+}
+
+void gc_print_pauses(vm_t *vm) {
+  GCState *gc = vm->gc;
+
+  printf("GC pauses (max %lluus):\n", (unsigned long long) gc->max_pause / 1000);
+  for (uint32_t i = 0; i < GC_PAUSE_BUCKETS; i++) {
+    if (gc->pauses[i] == 0) {
+      continue;
+    }
+
+    if (i == GC_PAUSE_BUCKETS - 1) {
+      printf("  >= %6lluus: %llu\n", 1ULL << (i - 1), (unsigned long long) gc->pauses[i]);
+    } else {
+      printf("  <  %6lluus: %llu\n", 1ULL << i, (unsigned long long) gc->pauses[i]);
+    }
+  }
+}
+
+void gc_collect(vm_t *vm) {
+  // Workers of parallel list functions share the heap with a VM that is suspended
+  if (vm->worker) {
+    parallel_bail(vm);
+  }
+
+  uint64_t start = gc_clock();
+
+  if (vm->gc->immix) {
+    begin_collection(vm);
+    immix_collect(vm);
+  } else if (vm->gc->pause_budget) {
+    if (vm->gc->cycle_active) {
+      finish_cycle(vm);
+      end_collection(vm);
+    }
+    start_cycle(vm);
+    finish_cycle(vm);
+  } else {
+    begin_collection(vm);
+    swap_spaces(vm->gc);
+
+    if (vm->gc->threads > 1) {
+      parallel_collect(vm);
+    } else {
+      dedup_reset(vm->gc);
+      gc_visit_roots(vm, copy_root, vm);
+      if (vm->gc->compaction) {
+        compact_relaxed_lists(vm);
+      }
+      large_sweep(vm->gc);
+    }
+    vm->gc->stats.cycle_copied = vm->gc->alloc_ptr - vm->gc->to_space;
+  }
+
+  record_pause(vm->gc, gc_clock() - start);
+  end_collection(vm);
+}
+
+// Parallel collection
+//
+// Every worker owns a queue of copied objects that still need their references
+// scanned. Workers take from the end of their own queue and, once it runs dry,
+// steal half of somebody else's from the front. The thread that triggered the
+// collection copies the roots into its own queue and then works alongside the
+// others.
+//
+// Objects are claimed by moving their forward flag from 0 to FORWARD_BUSY with a
+// compare-and-swap, so each object is copied exactly once. Whoever loses the race
+// waits for the flag to become 1 and uses the published forward address.
+// Copies are bump allocated out of per-worker buffers carved from to-space.
+
+#define FORWARD_BUSY 2
+#define LAB_SIZE 1024
+#define STEAL_MAX 64
+
+typedef struct GCWorker {
+  struct GCPool *pool;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  owl_term *items;         // Copied objects waiting to be scanned. List nodes are tagged as POINTER
+  uint32_t head;           // Thieves take from here
+  uint32_t tail;           // The owner pushes and pops here
+  uint32_t capacity;
+  uint32_t size;           // tail - head, readable without taking the lock
+  uint8_t *lab;
+  uint8_t *lab_end;
+} GCWorker;
+
+struct GCPool {
+  vm_t *vm;
+  uint32_t n_workers;
+  GCWorker *workers;
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t finished;
+  uint64_t epoch;          // Bumped at the start of every collection
+  uint32_t running;        // Helper threads still busy with the current collection
+  uint32_t active;         // Workers that have or may still produce work
+};
+
+static void worker_push(GCWorker *worker, owl_term item) {
+  pthread_mutex_lock(&worker->lock);
+
+  if (worker->tail == worker->capacity) {
+    if (worker->head > 0) {
+      memmove(worker->items, worker->items + worker->head, (worker->tail - worker->head) * sizeof(owl_term));
+      worker->tail -= worker->head;
+      worker->head = 0;
+    } else {
+      worker->capacity = worker->capacity == 0 ? 256 : worker->capacity * 2;
+      worker->items = realloc(worker->items, worker->capacity * sizeof(owl_term));
+    }
+  }
+
+  worker->items[worker->tail++] = item;
+  __atomic_store_n(&worker->size, worker->tail - worker->head, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&worker->lock);
+}
+
+static bool worker_pop(GCWorker *worker, owl_term *item) {
+  bool found = false;
+  pthread_mutex_lock(&worker->lock);
+
+  if (worker->tail > worker->head) {
+    *item = worker->items[--worker->tail];
+    found = true;
+  }
+  if (worker->tail == worker->head) {
+    worker->head = worker->tail = 0;
+  }
+
+  __atomic_store_n(&worker->size, worker->tail - worker->head, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&worker->lock);
+  return found;
+}
+
+static bool worker_steal(GCWorker *thief) {
+  GCPool *pool = thief->pool;
+  owl_term stolen[STEAL_MAX];
+
+  for (uint32_t i = 0; i < pool->n_workers; i++) {
+    GCWorker *victim = &pool->workers[i];
+    if (victim == thief || __atomic_load_n(&victim->size, __ATOMIC_RELAXED) == 0) {
+      continue;
+    }
+
+    pthread_mutex_lock(&victim->lock);
+    uint32_t available = victim->tail - victim->head;
+    uint32_t count = (available + 1) / 2;
+    if (count > STEAL_MAX) {
+      count = STEAL_MAX;
+    }
+    memcpy(stolen, victim->items + victim->head, count * sizeof(owl_term));
+    victim->head += count;
+    __atomic_store_n(&victim->size, victim->tail - victim->head, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&victim->lock);
+
+    for (uint32_t j = 0; j < count; j++) {
+      worker_push(thief, stolen[j]);
+    }
+    if (count > 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool work_available(GCPool *pool) {
+  for (uint32_t i = 0; i < pool->n_workers; i++) {
+    if (__atomic_load_n(&pool->workers[i].size, __ATOMIC_RELAXED) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void* worker_alloc(GCWorker *worker, uint32_t size) {
+  GCState *gc = worker->pool->vm->gc;
+  uint32_t block_size = align(size) + 1;
+
+  if (worker->lab + block_size > worker->lab_end) {
+    uint32_t chunk = block_size > LAB_SIZE / 4 ? block_size : LAB_SIZE;
+    uint8_t *start = __atomic_fetch_add(&gc->alloc_ptr, chunk, __ATOMIC_RELAXED);
+
+    if (start + chunk > gc->to_space + gc->size / 2) {
+      die("Insufficient memory");
+    }
+    if (chunk != LAB_SIZE) {
+      return start + 1;
+    }
+
+    worker->lab = start;
+    worker->lab_end = start + chunk;
+  }
+
+  uint8_t *object = worker->lab;
+  worker->lab += block_size;
+  return object + 1;
+}
+
+// Returns true if the caller now owns copying `object`. Otherwise waits for the
+// owner to finish and hands back the address it was forwarded to.
+static bool claim(void *object, void **forwarded) {
+  uint8_t *flag = ((uint8_t*) object) - 1;
+
+  for (;;) {
+    uint8_t expected = false;
+    if (__atomic_compare_exchange_n(flag, &expected, FORWARD_BUSY, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+      return true;
+    }
+    if (expected == true) {
+      *forwarded = FORWARD_ADDRESS(object);
+      return false;
+    }
+    sched_yield();
+  }
+}
+
+static void publish(void *object, void *copied) {
+  SET_FORWARD_ADDRESS(object, copied);
+  __atomic_store_n(((uint8_t*) object) - 1, true, __ATOMIC_RELEASE);
+}
+
+static void *copy_raw(GCWorker *worker, void *object, uint32_t size) {
+  void *copied = worker_alloc(worker, size);
+  SET_FORWARD_FLAG(copied, false);
+  memcpy(copied, object, size);
+  publish(object, copied);
+  return copied;
+}
+
+static owl_term par_copy(void *context, owl_term term) {
+  GCWorker *worker = context;
+  void *object = owl_extract_ptr(term);
+
+  if (owl_tag_of(term) == INT) {
+    return term;
+  }
+
+  if (!ON_HEAP(worker->pool->vm->gc, object)) {
+    LargeObject *large = large_object_of(worker->pool->vm->gc, term);
+    if (large && !__atomic_exchange_n(&large->marked, true, __ATOMIC_ACQ_REL) && has_refs(term)) {
+      worker_push(worker, term);
+    }
+    return term;
+  }
+
+  void *forwarded;
+  if (!claim(object, &forwarded)) {
+    return owl_tag_as(forwarded, owl_tag_of(term));
+  }
+
+  uint32_t heap_size = heap_size_of(term);
+  if (heap_size == 0) {
+    __atomic_store_n(((uint8_t*) object) - 1, false, __ATOMIC_RELEASE);
+    return term;
+  }
+
+  if (detaches(term)) {
+    OwlString *detached = worker_alloc(worker, owl_string_size(owl_string_length(term)));
+    SET_FORWARD_FLAG(detached, false);
+    detach(detached, term);
+    publish(object, detached);
+    return string_to_owl(detached);
+  }
+
+  owl_term copied = owl_tag_as(copy_raw(worker, object, heap_size), owl_tag_of(term));
+  moved(term, object, owl_extract_ptr(copied));
+  if (has_refs(copied)) {
+    worker_push(worker, copied);
+  }
+  return copied;
+}
+
+static void* par_copy_node(void *context, TreeNode *node) {
+  GCWorker *worker = context;
+  if (!ON_HEAP(worker->pool->vm->gc, node)) {
+    return node;
+  }
+
+  void *forwarded;
+  if (!claim(node, &forwarded)) {
+    return forwarded;
+  }
+
+  void *copied = copy_raw(worker, node, node_size_of(node));
+  worker_push(worker, owl_tag_as(copied, POINTER));
+  return copied;
+}
+
+static void* par_copy_size_table(void *context, RRBSizeTable *table, uint32_t len) {
+  GCWorker *worker = context;
+  if (!ON_HEAP(worker->pool->vm->gc, table)) {
+    return table;
+  }
+
+  void *forwarded;
+  if (!claim(table, &forwarded)) {
+    return forwarded;
+  }
+
+  // Size tables hold no references, there is nothing to scan
+  return copy_raw(worker, table, sizeof(RRBSizeTable) + len * sizeof(uint32_t));
+}
+
+static const Tracer par_tracer = {par_copy, par_copy_node, par_copy_size_table};
+
+// A worker only goes idle once its own queue is empty, and thieves register as
+// active before taking anything, so nobody can be holding work once the active
+// count reaches zero.
+static void par_drain(GCWorker *worker) {
+  GCPool *pool = worker->pool;
+  owl_term item;
+
+  for (;;) {
+    while (worker_pop(worker, &item)) {
+      gc_scan_refs(item, &par_tracer, worker);
+    }
+
+    __atomic_sub_fetch(&pool->active, 1, __ATOMIC_ACQ_REL);
+
+    for (;;) {
+      if (__atomic_load_n(&pool->active, __ATOMIC_ACQUIRE) == 0) {
+        return;
+      }
+      if (work_available(pool)) {
+        __atomic_add_fetch(&pool->active, 1, __ATOMIC_ACQ_REL);
+        if (worker_steal(worker)) {
+          break;
+        }
+        __atomic_sub_fetch(&pool->active, 1, __ATOMIC_ACQ_REL);
+      }
+      sched_yield();
+    }
+  }
+}
+
+static void* gc_worker_main(void *arg) {
+  GCWorker *worker = arg;
+  GCPool *pool = worker->pool;
+  uint64_t seen = 0;
+
+  for (;;) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->epoch == seen) {
+      pthread_cond_wait(&pool->start, &pool->lock);
+    }
+    seen = pool->epoch;
+    pthread_mutex_unlock(&pool->lock);
+
+    par_drain(worker);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->running == 0) {
+      pthread_cond_signal(&pool->finished);
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  return NULL;
+}
+
+static GCPool* pool_new(vm_t *vm, uint32_t n_workers) {
+  GCPool *pool = calloc(1, sizeof(GCPool));
+  pool->vm = vm;
+  pool->n_workers = n_workers;
+  pool->workers = calloc(n_workers, sizeof(GCWorker));
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->finished, NULL);
+
+  for (uint32_t i = 0; i < n_workers; i++) {
+    pool->workers[i].pool = pool;
+    pthread_mutex_init(&pool->workers[i].lock, NULL);
+  }
+
+  // Worker 0 is the thread that triggers the collection
+  for (uint32_t i = 1; i < n_workers; i++) {
+    if (pthread_create(&pool->workers[i].thread, NULL, gc_worker_main, &pool->workers[i]) != 0) {
+      die("Could not start GC worker");
+    }
+  }
+
+  return pool;
+}
+
+static void parallel_collect(vm_t *vm) {
+  if (!vm->gc->pool) {
+    vm->gc->pool = pool_new(vm, vm->gc->threads);
+  }
+  GCPool *pool = vm->gc->pool;
+
+  for (uint32_t i = 0; i < pool->n_workers; i++) {
+    pool->workers[i].lab = pool->workers[i].lab_end = NULL;
+  }
+
+  gc_visit_roots(vm, par_copy, &pool->workers[0]);
+
+  pthread_mutex_lock(&pool->lock);
+  pool->active = pool->n_workers;
+  pool->running = pool->n_workers - 1;
+  pool->epoch++;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  par_drain(&pool->workers[0]);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->running > 0) {
+    pthread_cond_wait(&pool->finished, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  large_sweep(vm->gc);
+}
+
+// Incremental collection
+//
+// Owl values are immutable, so instead of stopping the program until every live
+// object is copied, the collector replicates them into to-space a little at a
+// time. Forward addresses are kept in a side table rather than in the objects,
+// so from-space stays intact until the cycle is over.
+//
+// A cycle starts at a safepoint by flipping the spaces and shading the roots,
+// which points every live register and native root at a gray replica straight
+// away. The fields of a gray replica still point into from-space until it is
+// scanned, and the program may read through them, since nothing in from-space
+// is overwritten before `finish_cycle`. Every allocation then spends up to the
+// pause budget scanning gray replicas. New objects are allocated in to-space
+// and get shaded by `gc_write_barrier` as soon as they are stored in a
+// register, so their references into from-space are replicated too. Once there
+// is nothing left to scan, the next safepoint shades the roots once more, since
+// registers may have picked up from-space references read out of gray
+// replicas, and finishes whatever that turned up. Only then is from-space free.
+
+#define SHADED 1
+#define INCREMENTAL_TRIGGER_PERCENT 50
+#define STEP_CHECK_INTERVAL 16
+
+#define IN_TO_SPACE(gc, ptr) (((uint8_t*) ptr) >= gc->to_space && ((uint8_t*) ptr) < gc->to_space + gc->size / 2)
+#define FORWARD_SLOT(gc, ptr) gc->forwards[(((uint8_t*) ptr) - gc->from_space) / ALIGNMENT]
+
+static void gray_push(GCState *gc, owl_term term) {
+  if (gc->gray_count == gc->gray_capacity) {
+    gc->gray_capacity = gc->gray_capacity == 0 ? 256 : gc->gray_capacity * 2;
+    gc->gray = realloc(gc->gray, gc->gray_capacity * sizeof(owl_term));
+  }
+
+  gc->gray[gc->gray_count++] = term;
+}
+
+// Room in to-space for what `object` becomes, which the caller fills in
+static void* reserve_replica(GCState *gc, void *object, uint32_t size) {
+  uint32_t block_size = align(size) + 1;
+
+  if (gc->alloc_ptr + block_size > gc->to_space + gc->size / 2) {
+    die("Insufficient memory");
+  }
+
+  void *replica = gc->alloc_ptr + 1;
+  gc->alloc_ptr += block_size;
+  gc->stats.cycle_copied += block_size;
+  SET_FORWARD_FLAG(replica, SHADED);
+  FORWARD_SLOT(gc, object) = replica;
+  return replica;
+}
+
+static void* replicate(GCState *gc, void *object, uint32_t size) {
+  void *replica = reserve_replica(gc, object, size);
+  memcpy(replica, object, size);
+  return replica;
+}
+
+// Returns the term that the registers should end up pointing at
+static owl_term shade(void *context, owl_term term) {
+  GCState *gc = context;
+  void *object = owl_extract_ptr(term);
+
+  if (owl_tag_of(term) == INT) {
+    return term;
+  }
+
+  if (ON_HEAP(gc, object)) {
+    if (!FORWARD_SLOT(gc, object)) {
+      uint32_t heap_size = heap_size_of(term);
+      if (heap_size == 0) {
+        return term;
+      }
+
+      if (dedup_candidate(gc, term)) {
+        uint64_t hash = hash_string(object);
+        OwlString *shared = dedup_find(gc, object, hash, heap_size);
+        if (shared) {
+          FORWARD_SLOT(gc, object) = shared;
+        } else {
+          dedup_remember(gc, replicate(gc, object, heap_size), hash);
+        }
+        return owl_tag_as(FORWARD_SLOT(gc, object), STRING);
+      }
+
+      if (detaches(term)) {
+        detach(reserve_replica(gc, object, owl_string_size(owl_string_length(term))), term);
+        return string_to_owl(FORWARD_SLOT(gc, object));
+      }
+
+      void *replica = replicate(gc, object, heap_size);
+      moved(term, object, replica);
+      if (has_refs(owl_tag_as(replica, owl_tag_of(term)))) {
+        gray_push(gc, owl_tag_as(replica, owl_tag_of(term)));
+      }
+    }
+    return owl_tag_as(FORWARD_SLOT(gc, object), owl_tag_of(term));
+  }
+
+  LargeObject *large = large_object_of(gc, term);
+  if (large) {
+    if (!large->marked) {
+      large->marked = true;
+      if (has_refs(term)) {
+        gray_push(gc, term);
+      }
+    }
+    return term;
+  }
+
+  // Allocated since the cycle started
+  if (IN_TO_SPACE(gc, object) && FORWARD_FLAG(object) != SHADED) {
+    SET_FORWARD_FLAG(object, SHADED);
+    if (has_refs(term)) {
+      gray_push(gc, term);
+    }
+  }
+
+  return term;
+}
+
+static void* shade_node(void *context, TreeNode *node) {
+  GCState *gc = context;
+  if (ON_HEAP(gc, node)) {
+    if (!FORWARD_SLOT(gc, node)) {
+      gray_push(gc, owl_tag_as(replicate(gc, node, node_size_of(node)), POINTER));
+    }
+    return FORWARD_SLOT(gc, node);
+  }
+
+  if (IN_TO_SPACE(gc, node) && FORWARD_FLAG(node) != SHADED) {
+    SET_FORWARD_FLAG(node, SHADED);
+    gray_push(gc, owl_tag_as(node, POINTER));
+  }
+
+  return node;
+}
+
+// Size tables hold no references, so they never need scanning
+static void* shade_size_table(void *context, RRBSizeTable *table, uint32_t len) {
+  GCState *gc = context;
+  if (ON_HEAP(gc, table)) {
+    if (!FORWARD_SLOT(gc, table)) {
+      replicate(gc, table, sizeof(RRBSizeTable) + len * sizeof(uint32_t));
+    }
+    return FORWARD_SLOT(gc, table);
+  }
+
+  return table;
+}
+
+static const Tracer shade_tracer = {shade, shade_node, shade_size_table};
+
+static void start_cycle(vm_t *vm) {
+  GCState *gc = vm->gc;
+
+  begin_collection(vm);
+  swap_spaces(gc);
+  memset(gc->forwards, 0, (gc->size / 2 / ALIGNMENT + 1) * sizeof(void*));
+  dedup_reset(gc);
+  gc->cycle_active = true;
+
+  gc_visit_roots(vm, shade, gc);
+}
+
+// Only called at safepoints, where registers are the only references into
+// from-space that the program holds
+static void finish_cycle(vm_t *vm) {
+  GCState *gc = vm->gc;
+
+  gc_visit_roots(vm, shade, gc);
+  while (gc->gray_count > 0) {
+    gc_scan_refs(gc->gray[--gc->gray_count], &shade_tracer, gc);
+  }
+
+  gc->cycle_active = false;
+  large_sweep(gc);
+}
+
+static bool nearly_full(GCState *gc) {
+  if (gc->immix) {
+    uint64_t headroom = gc->immix->headroom * IMMIX_BLOCK_SIZE;
+    return gc->immix->available < headroom + gc->immix->size * (BUFFER_PERCENT / 100.0);
+  }
+
+  uint64_t space_size = gc->size / 2;
+  uint64_t buffer = space_size * (BUFFER_PERCENT / 100.0);
+
+  return (uint64_t) gc->alloc_ptr + buffer > (uint64_t) gc->to_space + space_size;
+}
+
+// Runs from `owl_alloc`, in the middle of whatever the program is doing. Work
+// is limited to replicating and scanning, nothing is freed here.
+static void incremental_step(vm_t *vm) {
+  GCState *gc = vm->gc;
+  uint64_t start = gc_clock();
+  bool unbounded = nearly_full(gc);
+
+  while (gc->gray_count > 0) {
+    for (uint32_t i = 0; i < STEP_CHECK_INTERVAL && gc->gray_count > 0; i++) {
+      gc_scan_refs(gc->gray[--gc->gray_count], &shade_tracer, gc);
+    }
+
+    if (!unbounded && gc_clock() - start >= gc->pause_budget) {
+      break;
+    }
+  }
+
+  record_pause(gc, gc_clock() - start);
+}
+
+void gc_write_barrier(vm_t *vm, owl_term term) {
+  shade(vm->gc, term);
+}
+
+static void incremental_safepoint(vm_t *vm) {
+  GCState *gc = vm->gc;
+  uint64_t space_size = gc->size / 2;
+  uint64_t trigger = space_size * (INCREMENTAL_TRIGGER_PERCENT / 100.0);
+
+  if (gc->cycle_active) {
+    if (gc->gray_count == 0 || nearly_full(gc)) {
+      uint64_t start = gc_clock();
+      finish_cycle(vm);
+      record_pause(gc, gc_clock() - start);
+      end_collection(vm);
+    }
+  } else if ((uint64_t) (gc->alloc_ptr - gc->to_space) > trigger || gc->large_bytes > gc->large_limit) {
+    uint64_t start = gc_clock();
+    start_cycle(vm);
+    record_pause(gc, gc_clock() - start);
+  }
+}
+
+void gc_immix_init(GCState *gc) {
+  ImmixHeap *heap = calloc(1, sizeof(ImmixHeap));
+
+  heap->start = gc->to_space;
+  heap->n_blocks = gc->size / IMMIX_BLOCK_SIZE;
+  heap->size = heap->n_blocks * IMMIX_BLOCK_SIZE;
+  heap->blocks = calloc(heap->n_blocks, sizeof(ImmixBlock));
+  heap->line_marks = calloc(heap->n_blocks * IMMIX_LINES_PER_BLOCK, sizeof(uint8_t));
+  heap->next_marks = calloc(heap->n_blocks * IMMIX_LINES_PER_BLOCK, sizeof(uint8_t));
+  heap->candidates = calloc(heap->n_blocks, sizeof(uint32_t));
+  heap->headroom = heap->n_blocks * IMMIX_HEADROOM_PERCENT / 100;
+  if (heap->headroom == 0) {
+    heap->headroom = 1;
+  }
+  heap->mark = IMMIX_FIRST_MARK;
+  heap->available = heap->size;
+  heap->small.block = heap->overflow.block = heap->evacuator.block = IMMIX_NO_BLOCK;
+  heap->overflow.empty_only = heap->evacuator.empty_only = true;
+
+  gc->immix = heap;
+}
+
+static uint32_t immix_find_block(ImmixHeap *heap, bool empty_only, uint32_t spare_empty) {
+  for (uint32_t i = 0; i < heap->n_blocks; i++) {
+    ImmixBlock *block = &heap->blocks[i];
+
+    if (block->touched || block->evacuate || block->live_lines == IMMIX_LINES_PER_BLOCK) {
+      continue;
+    }
+    if (block->live_lines == 0 && spare_empty > 0) {
+      spare_empty--;
+      continue;
+    }
+    if (empty_only && block->live_lines > 0) {
+      continue;
+    }
+
+    return i;
+  }
+
+  return IMMIX_NO_BLOCK;
+}
+
+// The program only gets to the evacuation headroom once everything else is used up
+static uint32_t immix_claim_block(ImmixHeap *heap, ImmixAllocator *allocator) {
+  bool program = allocator != &heap->evacuator;
+  uint32_t index = immix_find_block(heap, allocator->empty_only, program ? heap->headroom : 0);
+
+  if (index == IMMIX_NO_BLOCK && program) {
+    index = immix_find_block(heap, allocator->empty_only, 0);
+  }
+  if (index == IMMIX_NO_BLOCK) {
+    return index;
+  }
+
+  ImmixBlock *block = &heap->blocks[index];
+  block->touched = true;
+  heap->available -= (IMMIX_LINES_PER_BLOCK - block->live_lines) * IMMIX_LINE_SIZE;
+  return index;
+}
+
+// Moves the allocator on to the next run of free lines, claiming a new block
+// once the current one has none left
+static bool immix_next_hole(ImmixHeap *heap, ImmixAllocator *allocator) {
+  for (;;) {
+    if (allocator->block != IMMIX_NO_BLOCK) {
+      uint8_t *marks = heap->line_marks + allocator->block * IMMIX_LINES_PER_BLOCK;
+      uint32_t line = allocator->line;
+
+      while (line < IMMIX_LINES_PER_BLOCK && marks[line]) {
+        line++;
+      }
+      uint32_t end = line;
+      while (end < IMMIX_LINES_PER_BLOCK && !marks[end]) {
+        end++;
+      }
+      allocator->line = end;
+
+      if (line < end) {
+        uint8_t *block_start = heap->start + allocator->block * IMMIX_BLOCK_SIZE;
+        allocator->cursor = block_start + line * IMMIX_LINE_SIZE;
+        allocator->limit = block_start + end * IMMIX_LINE_SIZE;
+        return true;
+      }
+    }
+
+    allocator->block = immix_claim_block(heap, allocator);
+    allocator->line = 0;
+    if (allocator->block == IMMIX_NO_BLOCK) {
+      return false;
+    }
+  }
+}
+
+static uint8_t* immix_bump(ImmixHeap *heap, ImmixAllocator *allocator, uint32_t block_size) {
+  while (allocator->cursor + block_size > allocator->limit) {
+    if (!immix_next_hole(heap, allocator)) {
+      return NULL;
+    }
+  }
+
+  uint8_t *object = allocator->cursor;
+  allocator->cursor += block_size;
+  return object;
+}
+
+static uint8_t* immix_alloc(ImmixHeap *heap, uint32_t block_size) {
+  uint8_t *object = NULL;
+
+  // Rather than skipping the rest of the current hole, medium sized objects
+  // that do not fit it go into a separate empty block
+  if (block_size > IMMIX_LINE_SIZE && heap->small.cursor + block_size > heap->small.limit) {
+    object = immix_bump(heap, &heap->overflow, block_size);
+  }
+  if (!object) {
+    object = immix_bump(heap, &heap->small, block_size);
+  }
+  if (!object) {
+    die("Insufficient memory");
+  }
+
+  return object;
+}
+
+static void immix_mark_lines(ImmixHeap *heap, uint8_t *object, uint32_t size) {
+  uint32_t first = (object - 1 - heap->start) / IMMIX_LINE_SIZE;
+  uint32_t last = (object + align(size) - 1 - heap->start) / IMMIX_LINE_SIZE;
+
+  for (uint32_t line = first; line <= last; line++) {
+    heap->next_marks[line] = true;
+  }
+}
+
+// Returns true if the object was already reached during this collection, in
+// which case `object` is updated to wherever it lives now
+static bool immix_reached(ImmixHeap *heap, void **object) {
+  uint8_t flag = FORWARD_FLAG(*object);
+
+  if (flag == true) {
+    *object = FORWARD_ADDRESS(*object);
+    return true;
+  }
+  return flag == heap->mark;
+}
+
+#define IMMIX_BLOCK_OF(heap, ptr) (&heap->blocks[(((uint8_t*) ptr) - heap->start) / IMMIX_BLOCK_SIZE])
+
+// Marks the object live where it is, or moves it out if its block is being evacuated
+static void* immix_keep(GCState *gc, void *object, uint32_t size) {
+  ImmixHeap *heap = gc->immix;
+  uint32_t block_size = align(size) + 1;
+
+  if (IMMIX_BLOCK_OF(heap, object)->evacuate) {
+    uint8_t *moved = immix_bump(heap, &heap->evacuator, block_size);
+
+    if (moved) {
+      moved += 1;
+      memcpy(moved, object, size);
+      SET_FORWARD_FLAG(moved, heap->mark);
+      SET_FORWARD_ADDRESS(object, moved);
+      SET_FORWARD_FLAG(object, true);
+      object = moved;
+      gc->stats.cycle_copied += block_size;
+    }
+  }
+
+  if (FORWARD_FLAG(object) != heap->mark) {
+    SET_FORWARD_FLAG(object, heap->mark);
+  }
+  immix_mark_lines(heap, object, size);
+  IMMIX_BLOCK_OF(heap, object)->live_bytes += block_size;
+  return object;
+}
+
+static owl_term immix_trace(void *context, owl_term term) {
+  GCState *gc = context;
+  void *object = owl_extract_ptr(term);
+
+  if (owl_tag_of(term) == INT) {
+    return term;
+  }
+
+  if (!IN_IMMIX(gc->immix, object)) {
+    LargeObject *large = large_object_of(gc, term);
+    if (large && !large->marked) {
+      large->marked = true;
+      if (has_refs(term)) {
+        gray_push(gc, term);
+      }
+    }
+    return term;
+  }
+
+  if (immix_reached(gc->immix, &object)) {
+    return owl_tag_as(object, owl_tag_of(term));
+  }
+
+  uint32_t heap_size = heap_size_of(term);
+  if (heap_size == 0) {
+    return term;
+  }
+
+  owl_term kept = owl_tag_as(immix_keep(gc, object, heap_size), owl_tag_of(term));
+  moved(term, object, owl_extract_ptr(kept));
+  if (has_refs(kept)) {
+    gray_push(gc, kept);
+  }
+  return kept;
+}
+
+static void* immix_trace_node(void *context, TreeNode *node) {
+  GCState *gc = context;
+  void *object = node;
+
+  if (!IN_IMMIX(gc->immix, object) || immix_reached(gc->immix, &object)) {
+    return object;
+  }
+
+  object = immix_keep(gc, object, node_size_of(node));
+  gray_push(gc, owl_tag_as(object, POINTER));
+  return object;
+}
+
+static void* immix_trace_size_table(void *context, RRBSizeTable *table, uint32_t len) {
+  GCState *gc = context;
+  void *object = table;
+
+  if (!IN_IMMIX(gc->immix, object) || immix_reached(gc->immix, &object)) {
+    return object;
+  }
+
+  return immix_keep(gc, object, sizeof(RRBSizeTable) + len * sizeof(uint32_t));
+}
+
+static const Tracer immix_tracer = {immix_trace, immix_trace_node, immix_trace_size_table};
+
+static ImmixHeap *sorting_heap;
+
+// Emptiest lines first
+static int compare_density(const void *a, const void *b) {
+  ImmixBlock *left = &sorting_heap->blocks[*(const uint32_t*) a];
+  ImmixBlock *right = &sorting_heap->blocks[*(const uint32_t*) b];
+  uint64_t left_density = (uint64_t) left->live_bytes * right->live_lines;
+  uint64_t right_density = (uint64_t) right->live_bytes * left->live_lines;
+
+  return left_density < right_density ? -1 : left_density > right_density;
+}
+
+// Picks the blocks whose live lines the previous collection left mostly empty,
+// for as long as there is room to move their contents into. That is untouched
+// empty blocks, or right after a collection, any line it left free.
+static void immix_select_evacuation(ImmixHeap *heap, bool defragment) {
+  uint64_t headroom = 0;
+  uint32_t n_candidates = 0;
+
+  for (uint32_t i = 0; i < heap->n_blocks; i++) {
+    ImmixBlock *block = &heap->blocks[i];
+
+    if (block->live_lines == 0) {
+      headroom += block->touched ? 0 : IMMIX_BLOCK_SIZE;
+    } else if (block->live_bytes * 100 <= block->live_lines * IMMIX_LINE_SIZE * IMMIX_EVACUATE_PERCENT) {
+      heap->candidates[n_candidates++] = i;
+    }
+  }
+
+  sorting_heap = heap;
+  qsort(heap->candidates, n_candidates, sizeof(uint32_t), compare_density);
+
+  // Objects can not straddle lines that are already taken, leave some slack
+  if (defragment) {
+    headroom = heap->available;
+  }
+  headroom = headroom * 3 / 4;
+  for (uint32_t i = 0; i < n_candidates; i++) {
+    ImmixBlock *block = &heap->blocks[heap->candidates[i]];
+    uint64_t needed = block->live_bytes;
+
+    // Free lines of an evacuated block are no use to the objects moving out of it
+    if (defragment) {
+      needed += (IMMIX_LINES_PER_BLOCK - block->live_lines) * IMMIX_LINE_SIZE;
+    }
+    if (needed > headroom) {
+      break;
+    }
+
+    block->evacuate = true;
+    headroom -= needed;
+  }
+  heap->evacuator.empty_only = !defragment;
+
+  for (uint32_t i = 0; i < heap->n_blocks; i++) {
+    heap->blocks[i].live_bytes = 0;
+  }
+}
+
+static void immix_sweep(ImmixHeap *heap) {
+  heap->available = 0;
+
+  for (uint32_t i = 0; i < heap->n_blocks; i++) {
+    ImmixBlock *block = &heap->blocks[i];
+    uint8_t *marks = heap->next_marks + i * IMMIX_LINES_PER_BLOCK;
+
+    block->live_lines = 0;
+    for (uint32_t line = 0; line < IMMIX_LINES_PER_BLOCK; line++) {
+      block->live_lines += marks[line];
+    }
+    block->touched = false;
+    block->evacuate = false;
+    heap->available += (IMMIX_LINES_PER_BLOCK - block->live_lines) * IMMIX_LINE_SIZE;
+  }
+
+  uint8_t *marks = heap->line_marks;
+  heap->line_marks = heap->next_marks;
+  heap->next_marks = marks;
+
+  ImmixAllocator *allocators[] = {&heap->small, &heap->overflow, &heap->evacuator};
+  for (uint32_t i = 0; i < 3; i++) {
+    allocators[i]->block = IMMIX_NO_BLOCK;
+    allocators[i]->cursor = allocators[i]->limit = NULL;
+  }
+}
+
+static void immix_mark_live(vm_t *vm, bool defragment) {
+  GCState *gc = vm->gc;
+  ImmixHeap *heap = gc->immix;
+
+  heap->mark = heap->mark == UINT8_MAX ? IMMIX_FIRST_MARK : heap->mark + 1;
+  memset(heap->next_marks, 0, heap->n_blocks * IMMIX_LINES_PER_BLOCK);
+  immix_select_evacuation(heap, defragment);
+
+  gc_visit_roots(vm, immix_trace, gc);
+  while (gc->gray_count > 0) {
+    gc_scan_refs(gc->gray[--gc->gray_count], &immix_tracer, gc);
+  }
+
+  large_sweep(gc);
+  immix_sweep(heap);
+  if (gc->profile) {
+    heap_profile_collected(vm);
+  }
+}
+
+static void immix_collect(vm_t *vm) {
+  immix_mark_live(vm, false);
+
+  if (nearly_full(vm->gc)) {
+    immix_mark_live(vm, true);
+  }
+}
+
+void gc_safepoint(vm_t* vm) {
+  if (vm->worker) {
+    return;
+  }
+
+  if (vm->gc->pause_budget && !vm->gc->immix) {
+    incremental_safepoint(vm);
+    return;
+  }
+
+  if (nearly_full(vm->gc) || vm->gc->large_bytes > vm->gc->large_limit) {
+    gc_collect(vm);
+  }
+}
+
+uint64_t gc_bytes_allocated() {
+  return bytes_allocated;
+}
+
+// Where an object allocated before the collection that just ended lives now,
+// or NULL if it was collected. Stops being accurate once the program allocates.
+void* gc_survivor(GCState *gc, void *object, uint32_t n_bytes) {
+  if (n_bytes >= LARGE_OBJECT_SIZE) {
+    return large_object_of(gc, owl_tag_as(object, POINTER)) ? object : NULL;
+  }
+
+  if (gc->immix) {
+    while (FORWARD_FLAG(object) == true) {
+      object = FORWARD_ADDRESS(object);
+    }
+    return FORWARD_FLAG(object) == gc->immix->mark ? object : NULL;
+  }
+
+  if (gc->pause_budget) {
+    // Allocated while the cycle was running
+    if (IN_TO_SPACE(gc, object)) {
+      return object;
+    }
+    return FORWARD_SLOT(gc, object);
+  }
+
+  return FORWARD_FLAG(object) ? FORWARD_ADDRESS(object) : NULL;
+}
+
+// Workers of parallel list functions allocate out of buffers of their own,
+// carved from to-space like those of parallel collections. They never collect,
+// so they bail out instead once the heap is as full as it would be for a
+// collection to start.
+static uint8_t* worker_carve(vm_t *vm, uint32_t size) {
+  GCState *gc = vm->gc;
+  uint64_t space_size = gc->size / 2;
+  uint8_t *limit = gc->to_space + space_size - (uint64_t) (space_size * (BUFFER_PERCENT / 100.0));
+  uint8_t *start = __atomic_load_n(&gc->alloc_ptr, __ATOMIC_RELAXED);
+
+  do {
+    if (start + size > limit) {
+      parallel_bail(vm);
+    }
+  } while (!__atomic_compare_exchange_n(&gc->alloc_ptr, &start, start + size, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+  return start;
+}
+
+static void* worker_allocate(vm_t *vm, uint32_t N) {
+  if (N >= LARGE_OBJECT_SIZE) {
+    parallel_bail(vm);
+  }
+
+  uint32_t block_size = align(N) + 1;
+  uint8_t *object;
+
+  if (block_size > LAB_SIZE / 4) {
+    object = worker_carve(vm, block_size);
+  } else {
+    if (vm->lab + block_size > vm->lab_end) {
+      vm->lab = worker_carve(vm, LAB_SIZE);
+      vm->lab_end = vm->lab + LAB_SIZE;
+    }
+    object = vm->lab;
+    vm->lab += block_size;
+  }
+
+  memset(object, 0, block_size);
+  __atomic_add_fetch(&bytes_allocated, block_size, __ATOMIC_RELAXED);
+  return object + 1;
+}
+
+static void* allocate(vm_t *vm, uint32_t N) {
+  if (vm->worker) {
+    return worker_allocate(vm, N);
+  }
+
+  if (N >= LARGE_OBJECT_SIZE) {
+    bytes_allocated += N;
+    return large_alloc(vm->gc, N);
+  }
+
+  uint32_t block_size = align(N) + 1;
+  uint8_t* object;
+
+  if (vm->gc->immix) {
+    object = immix_alloc(vm->gc->immix, block_size);
+  } else {
+    gc_check_overlflow(vm, block_size);
+    object = vm->gc->alloc_ptr;
+    vm->gc->alloc_ptr += block_size;
+  }
   memset(object, 0, block_size);
   bytes_allocated += block_size;
 
+  if (vm->gc->cycle_active && vm->gc->gray_count > 0) {
+    incremental_step(vm);
+  }
+
+  return object + 1;
+}
+
+// Immortal objects
+//
+// Constants built while loading code are allocated outside of the heap, in
+// chunks that are never freed. Pointers to them are not ON_HEAP, so no
+// collector moves or frees them, and since constants only ever refer to other
+// constants there is nothing in them to scan either.
+
+#define IMMORTAL_CHUNK_SIZE 65536
+
+static void* immortal_alloc(GCState *gc, uint32_t N) {
+  uint32_t block_size = align(N) + 1;
+
+  if (gc->immortal_ptr == NULL || gc->immortal_ptr + block_size > gc->immortal_end) {
+    uint32_t chunk_size = block_size > IMMORTAL_CHUNK_SIZE ? block_size : IMMORTAL_CHUNK_SIZE;
+    gc->immortal_ptr = malloc(chunk_size);
+    if (gc->immortal_ptr == NULL) {
+      die("Insufficient memory");
+    }
+    gc->immortal_end = gc->immortal_ptr + chunk_size;
+  }
+
+  uint8_t *object = gc->immortal_ptr;
+  gc->immortal_ptr += block_size;
+  memset(object, 0, block_size);
   return object + 1;
 }
+
+void* owl_alloc(vm_t *vm, uint32_t N) {
+  if (vm->gc->immortal) {
+    return immortal_alloc(vm->gc, N);
+  }
+
+  void *object = allocate(vm, N);
+
+  if (vm->gc->profile) {
+    heap_profile_allocated(vm, object, N);
+  }
+
+  return object;
+}
@@ -2,11 +2,38 @@
 #define ALLOC_H
 
 #include "owl.h"
+#include "std/owl_list.h"
+
+typedef owl_term (*root_visitor)(void *context, owl_term term);
+
+// Collectors that keep a queue of objects to scan describe how to treat each
+// kind of reference with a Tracer. Each function returns the new location of
+// whatever it was given.
+typedef struct Tracer {
+  owl_term (*term)(void *context, owl_term term);
+  void* (*node)(void *context, TreeNode *node);
+  void* (*size_table)(void *context, RRBSizeTable *table, uint32_t len);
+} Tracer;
 
 void gc_collect(vm_t *vm);
+void gc_immix_init(GCState *gc);
+void gc_add_live_map(vm_t *vm, uint64_t call_site, uint64_t return_address, uint8_t *registers, uint8_t n_registers);
 void gc_safepoint(vm_t *vm);
+uint64_t gc_return_address(vm_t *vm, uint64_t call_site);
+void gc_visit_roots(vm_t *vm, root_visitor visit, void *context);
+void gc_scan_refs(owl_term item, const Tracer *tracer, void *context);
+uint32_t gc_object_size(owl_term term);
+void gc_write_barrier(vm_t *vm, owl_term term);
+void gc_print_pauses(vm_t *vm);
+uint64_t gc_clock(void);
+uint64_t gc_survival_rate(vm_t *vm);
 uint64_t gc_bytes_allocated(void);
 uint32_t gc_usage(vm_t *vm);
+void* gc_survivor(GCState *gc, void *object, uint32_t n_bytes);
+StringDedup* gc_dedup_new(uint32_t min_length);
+ListCompaction* gc_compaction_new(void);
+uint32_t gc_dedup_min_length(GCState *gc);
+bool gc_compacts_lists(GCState *gc);
 void* owl_alloc(vm_t *vm, uint32_t n_bytes);
 
 #endif  // ALLOC_H
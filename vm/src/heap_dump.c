@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "heap_dump.h"
+#include "alloc.h"
+#include "parallel.h"
+#include "term.h"
+
+// Objects are written out in the order they are first reached from the roots.
+// Anything reached is queued once, and a record is written per object taken
+// off the queue, so the walk needs no recursion and memory for no more than
+// the set of objects seen so far.
+
+typedef struct Pending {
+  owl_term term;                       // List nodes and size tables are tagged as POINTER
+  uint8_t type;
+  uint32_t size;
+} Pending;
+
+typedef struct Dump {
+  FILE *out;
+  uint64_t *seen;                      // Open addressing set of ids, 0 marks a free slot
+  uint64_t seen_count;
+  uint64_t seen_capacity;
+  Pending *queue;
+  uint64_t queue_head;
+  uint64_t queue_count;
+  uint64_t queue_capacity;
+  uint64_t *refs;                      // Of the object being written
+  uint32_t n_refs;
+  uint32_t refs_capacity;
+} Dump;
+
+static uint64_t slot_of(uint64_t id, uint64_t capacity) {
+  return (id * 0x9E3779B97F4A7C15ULL >> 17) & (capacity - 1);
+}
+
+// Returns false if the id was in the set already
+static bool remember(Dump *dump, uint64_t id) {
+  if ((dump->seen_count + 1) * 2 > dump->seen_capacity) {
+    uint64_t *old = dump->seen;
+    uint64_t old_capacity = dump->seen_capacity;
+
+    dump->seen_capacity = old_capacity == 0 ? 1024 : old_capacity * 2;
+    dump->seen = calloc(dump->seen_capacity, sizeof(uint64_t));
+    for (uint64_t i = 0; i < old_capacity; i++) {
+      if (old[i]) {
+        uint64_t slot = slot_of(old[i], dump->seen_capacity);
+        while (dump->seen[slot]) {
+          slot = (slot + 1) & (dump->seen_capacity - 1);
+        }
+        dump->seen[slot] = old[i];
+      }
+    }
+    free(old);
+  }
+
+  uint64_t slot = slot_of(id, dump->seen_capacity);
+  while (dump->seen[slot]) {
+    if (dump->seen[slot] == id) {
+      return false;
+    }
+    slot = (slot + 1) & (dump->seen_capacity - 1);
+  }
+
+  dump->seen[slot] = id;
+  dump->seen_count++;
+  return true;
+}
+
+static void refer(Dump *dump, owl_term term, uint8_t type, uint32_t size) {
+  uint64_t id = (uint64_t) owl_extract_ptr(term);
+
+  if (dump->n_refs == dump->refs_capacity) {
+    dump->refs_capacity = dump->refs_capacity == 0 ? 64 : dump->refs_capacity * 2;
+    dump->refs = realloc(dump->refs, dump->refs_capacity * sizeof(uint64_t));
+  }
+  dump->refs[dump->n_refs++] = id;
+
+  if (!remember(dump, id)) {
+    return;
+  }
+
+  if (dump->queue_head + dump->queue_count == dump->queue_capacity) {
+    // Reuse the space taken up by records already written before growing
+    if (dump->queue_head > 0) {
+      memmove(dump->queue, dump->queue + dump->queue_head, dump->queue_count * sizeof(Pending));
+      dump->queue_head = 0;
+    }
+    if (dump->queue_count * 2 >= dump->queue_capacity) {
+      dump->queue_capacity = dump->queue_capacity == 0 ? 256 : dump->queue_capacity * 2;
+      dump->queue = realloc(dump->queue, dump->queue_capacity * sizeof(Pending));
+    }
+  }
+  dump->queue[dump->queue_head + dump->queue_count++] = (Pending) {term, type, size};
+}
+
+static owl_term dump_term(void *context, owl_term term) {
+  uint32_t size = gc_object_size(term);
+
+  // Ints, booleans, nil, the empty list and the empty map
+  if (size == 0) {
+    return term;
+  }
+
+  switch (owl_tag_of(term)) {
+    case TUPLE:
+      refer(context, term, HEAP_DUMP_TUPLE, size);
+      break;
+    case LIST:
+      refer(context, term, HEAP_DUMP_LIST, size);
+      break;
+    case STRING:
+      refer(context, term, HEAP_DUMP_STRING, size);
+      break;
+    case FUNCTION:
+      refer(context, term, HEAP_DUMP_FUNCTION, size);
+      break;
+    case MAP:
+      refer(context, term, HEAP_DUMP_MAP, size);
+      break;
+    default:
+      break;
+  }
+
+  return term;
+}
+
+static void* dump_node(void *context, TreeNode *node) {
+  owl_term term = owl_tag_as(node, POINTER);
+  refer(context, term, HEAP_DUMP_LIST_NODE, gc_object_size(term));
+  return node;
+}
+
+static void* dump_size_table(void *context, RRBSizeTable *table, uint32_t len) {
+  refer(context, owl_tag_as(table, POINTER), HEAP_DUMP_SIZE_TABLE, sizeof(RRBSizeTable) + len * sizeof(uint32_t));
+  return table;
+}
+
+static const Tracer dump_tracer = {dump_term, dump_node, dump_size_table};
+
+static void write_record(Dump *dump, uint8_t type, uint64_t id, uint32_t size) {
+  fwrite(&type, sizeof(type), 1, dump->out);
+  fwrite(&id, sizeof(id), 1, dump->out);
+  fwrite(&size, sizeof(size), 1, dump->out);
+  fwrite(&dump->n_refs, sizeof(dump->n_refs), 1, dump->out);
+  fwrite(dump->refs, sizeof(uint64_t), dump->n_refs, dump->out);
+  dump->n_refs = 0;
+}
+
+// Writes everything reachable from the stack frames to `path`, returns the
+// number of objects written or -1 if the file could not be opened. Has to be
+// called at a safepoint, where the live registers of every frame are known.
+int64_t heap_dump(vm_t *vm, const char *path) {
+  if (vm->worker) {
+    parallel_bail(vm);
+  }
+
+  Dump dump;
+  memset(&dump, 0, sizeof(Dump));
+
+  dump.out = fopen(path, "wb");
+  if (!dump.out) {
+    return -1;
+  }
+
+  fwrite(HEAP_DUMP_MAGIC, 1, HEAP_DUMP_MAGIC_SIZE, dump.out);
+
+  gc_visit_roots(vm, dump_term, &dump);
+  write_record(&dump, HEAP_DUMP_ROOTS, 0, 0);
+
+  int64_t written = 0;
+  while (dump.queue_count > 0) {
+    Pending next = dump.queue[dump.queue_head++];
+    dump.queue_count--;
+
+    if (next.type != HEAP_DUMP_SIZE_TABLE) {
+      gc_scan_refs(next.term, &dump_tracer, &dump);
+    }
+    write_record(&dump, next.type, (uint64_t) owl_extract_ptr(next.term), next.size);
+    written++;
+  }
+
+  fclose(dump.out);
+  free(dump.seen);
+  free(dump.queue);
+  free(dump.refs);
+  return written;
+}
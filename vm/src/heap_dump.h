@@ -0,0 +1,37 @@
+#ifndef HEAP_DUMP_H
+#define HEAP_DUMP_H
+
+#include <stdint.h>
+
+// Snapshot files written by `heap_dump`. HEAP_DUMP_MAGIC is followed by one
+// record per object:
+//
+//   uint8_t  type              A HeapDumpType
+//   uint64_t id                Address of the object
+//   uint32_t size              Bytes it takes up
+//   uint32_t n_refs
+//   uint64_t refs[n_refs]      Ids of the objects it refers to
+//
+// All in native byte order. The first record is a pseudo object holding the
+// stack frame roots. Every id that is referred to has a record of its own.
+
+#define HEAP_DUMP_MAGIC "OWLHEAP1"
+#define HEAP_DUMP_MAGIC_SIZE 8
+
+typedef enum HeapDumpType {
+  HEAP_DUMP_ROOTS = 0,
+  HEAP_DUMP_TUPLE,
+  HEAP_DUMP_LIST,
+  HEAP_DUMP_LIST_NODE,
+  HEAP_DUMP_SIZE_TABLE,
+  HEAP_DUMP_STRING,
+  HEAP_DUMP_FUNCTION,                  // Closures, as well as the named functions frames are running
+  HEAP_DUMP_MAP,                       // Every node of a map
+  HEAP_DUMP_TYPE_COUNT,
+} HeapDumpType;
+
+struct vm;
+
+int64_t heap_dump(struct vm *vm, const char *path);
+
+#endif  // HEAP_DUMP_H
@@ -0,0 +1,240 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "heap_profile.h"
+#include "alloc.h"
+#include "opcodes.h"
+
+// Allocation site heap profiler, enabled with OWL_HEAP_PROFILE=<report file>
+//
+// About one allocation per OWL_HEAP_PROFILE_RATE bytes is sampled. A sample
+// remembers the instruction that allocated it, and the function that
+// instruction belongs to, and stands in for `rate` bytes allocated there.
+// After every collection the sampled objects are looked up again: the ones
+// that were collected are dropped, the rest count as retained by their site.
+// The report is written out when the program exits.
+
+#define DEFAULT_RATE 1024
+#define CODE_SIZE 0xFFFF
+#define NO_SITE 0
+
+typedef struct Site {
+  unsigned int instruction;
+  const char *function;
+  uint64_t allocated;                  // Estimated bytes
+  uint64_t objects;                    // Estimated number of allocations
+  uint64_t survived;                   // Estimated bytes that lived through a collection
+  uint64_t retained;                   // Estimated bytes live after the last collection
+} Site;
+
+typedef struct Sample {
+  void *object;
+  uint32_t size;
+  uint32_t site;
+  uint64_t weight;                     // Bytes of allocation this sample stands in for
+  bool survived;
+} Sample;
+
+struct HeapProfile {
+  char *path;
+  uint64_t rate;
+  int64_t until_sample;                // Bytes left to allocate before the next sample
+  uint32_t *site_at;                   // Index into `sites` by instruction location
+  Site *sites;                         // The first one is unused, see NO_SITE
+  uint32_t site_count;
+  uint32_t site_capacity;
+  Sample *samples;
+  uint32_t sample_count;
+  uint32_t sample_capacity;
+};
+
+typedef struct OpcodeInfo {
+  const char *name;
+  const char *kind;                    // Type of the term the instruction builds
+} OpcodeInfo;
+
+static OpcodeInfo opcode_info(uint8_t opcode) {
+  switch (opcode) {
+    case OP_CALL:         return (OpcodeInfo) {"call", "other"};
+    case OP_TUPLE:        return (OpcodeInfo) {"tuple", "tuple"};
+    case OP_LIST:         return (OpcodeInfo) {"list", "list"};
+    case OP_FILE_PWD:     return (OpcodeInfo) {"file_pwd", "string"};
+    case OP_CONCAT:       return (OpcodeInfo) {"concat", "string"};
+    case OP_FILE_LS:      return (OpcodeInfo) {"file_ls", "list"};
+    case OP_LIST_SLICE:   return (OpcodeInfo) {"list_slice", "list"};
+    case OP_STRING_SLICE: return (OpcodeInfo) {"string_slice", "string"};
+    case OP_STRING_SPLIT: return (OpcodeInfo) {"string_split", "list"};
+    case OP_TO_STRING:    return (OpcodeInfo) {"to_string", "string"};
+    case OP_ANON_FN:      return (OpcodeInfo) {"anon_fn", "function"};
+    case OP_GC_STATS:     return (OpcodeInfo) {"gc_stats", "list"};
+    case OP_LIST_BUILDER: return (OpcodeInfo) {"list_builder", "list"};
+    case OP_LIST_BUILDER_PUSH: return (OpcodeInfo) {"list_builder_push", "list"};
+    case OP_LIST_BUILDER_FREEZE: return (OpcodeInfo) {"list_builder_freeze", "list"};
+    case OP_LIST_MAP:     return (OpcodeInfo) {"list_map", "list"};
+    case OP_LIST_FILTER:  return (OpcodeInfo) {"list_filter", "list"};
+    case OP_LIST_REVERSE: return (OpcodeInfo) {"list_reverse", "list"};
+    case OP_LIST_PMAP:    return (OpcodeInfo) {"list_pmap", "list"};
+    case OP_LIST_SORT:    return (OpcodeInfo) {"list_sort", "list"};
+    case OP_LIST_SORT_BY: return (OpcodeInfo) {"list_sort_by", "list"};
+    case OP_MAP_PUT:      return (OpcodeInfo) {"map_put", "map"};
+    case OP_MAP_REMOVE:   return (OpcodeInfo) {"map_remove", "map"};
+    case OP_MAP_TO_LIST:  return (OpcodeInfo) {"map_to_list", "list"};
+    case OP_SET_PUT:      return (OpcodeInfo) {"set_put", "map"};
+    case OP_SET_REMOVE:   return (OpcodeInfo) {"set_remove", "map"};
+    case OP_SET_UNION:    return (OpcodeInfo) {"set_union", "map"};
+    case OP_SET_INTERSECTION: return (OpcodeInfo) {"set_intersection", "map"};
+    case OP_SET_DIFFERENCE: return (OpcodeInfo) {"set_difference", "map"};
+    case OP_SET_TO_LIST:  return (OpcodeInfo) {"set_to_list", "list"};
+    default:              return (OpcodeInfo) {"other", "other"};
+  }
+}
+
+HeapProfile* heap_profile_new(const char *path, uint64_t rate) {
+  HeapProfile *profile = calloc(1, sizeof(HeapProfile));
+
+  profile->path = malloc(strlen(path) + 1);
+  strcpy(profile->path, path);
+  profile->rate = rate > 0 ? rate : DEFAULT_RATE;
+  profile->until_sample = profile->rate;
+  profile->site_at = calloc(CODE_SIZE, sizeof(uint32_t));
+  profile->site_count = 1;
+  profile->site_capacity = 64;
+  profile->sites = calloc(profile->site_capacity, sizeof(Site));
+
+  return profile;
+}
+
+static uint32_t current_site(vm_t *vm, HeapProfile *profile) {
+  uint32_t *index = &profile->site_at[vm->instruction];
+  if (*index != NO_SITE) {
+    return *index;
+  }
+
+  if (profile->site_count == profile->site_capacity) {
+    profile->site_capacity *= 2;
+    profile->sites = realloc(profile->sites, profile->site_capacity * sizeof(Site));
+  }
+
+  Site *site = &profile->sites[profile->site_count];
+  memset(site, 0, sizeof(Site));
+  site->instruction = vm->instruction;
+  site->function = vm->current_function ? vm->current_function->name : "(loading)";
+
+  *index = profile->site_count++;
+  return *index;
+}
+
+void heap_profile_allocated(vm_t *vm, void *object, uint32_t n_bytes) {
+  HeapProfile *profile = vm->gc->profile;
+
+  profile->until_sample -= n_bytes;
+  if (profile->until_sample > 0) {
+    return;
+  }
+  profile->until_sample = profile->rate;
+
+  uint32_t index = current_site(vm, profile);
+  uint64_t weight = n_bytes < profile->rate ? profile->rate : n_bytes;
+  Site *site = &profile->sites[index];
+  site->allocated += weight;
+  site->objects += weight / (n_bytes > 0 ? n_bytes : 1);
+
+  if (profile->sample_count == profile->sample_capacity) {
+    profile->sample_capacity = profile->sample_capacity == 0 ? 256 : profile->sample_capacity * 2;
+    profile->samples = realloc(profile->samples, profile->sample_capacity * sizeof(Sample));
+  }
+  profile->samples[profile->sample_count++] = (Sample) {object, n_bytes, index, weight, false};
+}
+
+// Has to run right after a collection, while the collector can still tell
+// where the objects it kept have moved to
+void heap_profile_collected(vm_t *vm) {
+  HeapProfile *profile = vm->gc->profile;
+  uint32_t kept = 0;
+
+  for (uint32_t i = 0; i < profile->site_count; i++) {
+    profile->sites[i].retained = 0;
+  }
+
+  for (uint32_t i = 0; i < profile->sample_count; i++) {
+    Sample sample = profile->samples[i];
+
+    sample.object = gc_survivor(vm->gc, sample.object, sample.size);
+    if (!sample.object) {
+      continue;
+    }
+
+    Site *site = &profile->sites[sample.site];
+    if (!sample.survived) {
+      site->survived += sample.weight;
+      sample.survived = true;
+    }
+    site->retained += sample.weight;
+    profile->samples[kept++] = sample;
+  }
+
+  profile->sample_count = kept;
+}
+
+static int by_allocated(const void *a, const void *b) {
+  const Site *left = a;
+  const Site *right = b;
+
+  return left->allocated < right->allocated ? 1 : left->allocated > right->allocated ? -1 : 0;
+}
+
+static void print_row(FILE *out, Site *site, const char *kind) {
+  fprintf(out, "%12llu %10llu %12llu %7llu%%  %-8s",
+          (unsigned long long) site->allocated,
+          (unsigned long long) site->objects,
+          (unsigned long long) site->retained,
+          (unsigned long long) (site->allocated ? site->survived * 100 / site->allocated : 0),
+          kind);
+}
+
+void heap_profile_report(vm_t *vm) {
+  HeapProfile *profile = vm->gc->profile;
+  FILE *out = fopen(profile->path, "w");
+  if (!out) {
+    printf("Could not write heap profile to %s\n", profile->path);
+    return;
+  }
+
+  uint32_t n_sites = profile->site_count - 1;
+  Site *sites = malloc((n_sites + 1) * sizeof(Site));
+  memcpy(sites, profile->sites + 1, n_sites * sizeof(Site));
+  qsort(sites, n_sites, sizeof(Site), by_allocated);
+
+  fprintf(out, "Heap profile, sampling every %llu bytes, %llu collections\n",
+          (unsigned long long) profile->rate, (unsigned long long) vm->gc->stats.collections);
+  fprintf(out, "Bytes and object counts are estimates, retained means live after the last collection\n\n");
+  fprintf(out, "%12s %10s %12s %8s  %-8s  %s\n", "allocated", "objects", "retained", "survived", "kind", "site");
+  for (uint32_t i = 0; i < n_sites; i++) {
+    uint8_t opcode = vm->code[sites[i].instruction];
+    OpcodeInfo info = opcode_info(opcode);
+    print_row(out, &sites[i], info.kind);
+    fprintf(out, "  %s %04x %s (%u)\n", sites[i].function, sites[i].instruction, info.name, opcode);
+  }
+
+  static const char *kinds[] = {"tuple", "list", "string", "function", "map", "other"};
+  fprintf(out, "\n%12s %10s %12s %8s  %-8s\n", "allocated", "objects", "retained", "survived", "kind");
+  for (uint32_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+    Site total = {0};
+    for (uint32_t i = 0; i < n_sites; i++) {
+      if (strcmp(opcode_info(vm->code[sites[i].instruction]).kind, kinds[k]) == 0) {
+        total.allocated += sites[i].allocated;
+        total.objects += sites[i].objects;
+        total.survived += sites[i].survived;
+        total.retained += sites[i].retained;
+      }
+    }
+
+    if (total.allocated > 0) {
+      print_row(out, &total, kinds[k]);
+      fprintf(out, "\n");
+    }
+  }
+
+  free(sites);
+  fclose(out);
+}
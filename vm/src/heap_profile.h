@@ -0,0 +1,11 @@
+#ifndef HEAP_PROFILE_H
+#define HEAP_PROFILE_H
+
+#include "owl.h"
+
+HeapProfile* heap_profile_new(const char *path, uint64_t rate);
+void heap_profile_allocated(vm_t *vm, void *object, uint32_t n_bytes);
+void heap_profile_collected(vm_t *vm);
+void heap_profile_report(vm_t *vm);
+
+#endif  // HEAP_PROFILE_H
@@ -17,7 +17,7 @@ static void init_load_path() {
   if (load_path == NULL) {
     setenv("OWL_LOAD_PATH", absolute_stdlib, true);
   } else {
-    char final_path[strlen(load_path) + strlen(absolute_stdlib) + 1];
+    char final_path[strlen(load_path) + strlen(absolute_stdlib) + 2];
     sprintf(final_path, "%s:%s", load_path, absolute_stdlib);
 
     setenv("OWL_LOAD_PATH", final_path, true);
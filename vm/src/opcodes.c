@@ -6,7 +6,11 @@
 #include "opcodes.h"
 #include "vm.h"
 #include "alloc.h"
+#include "heap_profile.h"
+#include "heap_dump.h"
+#include "parallel.h"
 #include "std/owl_list.h"
+#include "std/owl_map.h"
 #include "std/owl_file.h"
 #include "std/owl_string.h"
 #include "std/owl_code.h"
@@ -47,6 +51,11 @@ owl_term get_var(vm_t *vm, uint8_t reg) {
 Function* load_function(vm_t *vm, uint8_t function_id) {
   Function* function = vm->functions[function_id];
 
+  // Code is shared with the VM that workers of parallel list functions work for
+  if ((uint64_t) function == NO_FUNCTION && vm->worker) {
+    parallel_bail(vm);
+  }
+
   if ((uint64_t) function == NO_FUNCTION) {
     char fname_buf[255];
     char *fname_copy = fname_buf;
@@ -71,6 +80,9 @@ void setup_next_stackframe(vm_t *vm, Function* fun, uint8_t arity, uint8_t ret_r
 
   unsigned int next_frame = vm->current_frame + 1;
 
+  // Functions whose last expression stores nothing return register 0 without
+  // writing it, so it must not hold a term left behind by an earlier frame
+  vm->frames[next_frame].registers[0] = 0;
   for(uint8_t i = 0; i < arity; i++) {
     owl_term arg = get_var(vm, next_byte(vm));
     vm->frames[next_frame].registers[i + 1] = arg;
@@ -85,6 +97,10 @@ void setup_next_stackframe(vm_t *vm, Function* fun, uint8_t arity, uint8_t ret_r
 void set_reg(vm_t *vm, uint8_t reg, owl_term term) {
   frame_t *curr_frame = &vm->frames[vm->current_frame];
   curr_frame->registers[reg] = term;
+
+  if (vm->gc->cycle_active) {
+    gc_write_barrier(vm, term);
+  }
 }
 
 void op_unknown(vm_t * vm) {
@@ -98,6 +114,12 @@ void op_exit(vm_t *vm) {
   debug_print("%04x OP_EXIT\n", vm->ip);
   uint8_t exit_code = next_byte(vm);
   printf("Bytes allocated: %llu\n", gc_bytes_allocated());
+  if (vm->gc->pause_budget) {
+    gc_print_pauses(vm);
+  }
+  if (vm->gc->profile) {
+    heap_profile_report(vm);
+  }
 
   exit(exit_code);
 }
@@ -161,6 +183,10 @@ void op_sub(struct vm *vm) {
 }
 
 void op_call(struct vm *vm) {
+  // Collecting before decoding so that the live map of the current frame is
+  // found at the location of this instruction
+  gc_safepoint(vm);
+
   uint8_t ret_reg = next_byte(vm);
   uint8_t function_id = next_byte(vm);
   uint8_t arity = next_byte(vm);
@@ -169,10 +195,9 @@ void op_call(struct vm *vm) {
     debug_print("%04x OP_CALL: %s\n", vm->ip, strings_lookup_id(vm->function_names, function_id));
   #endif
 
-  gc_safepoint(vm);
   Function* fun = load_function(vm, function_id);
-  vm->current_function = fun;
   setup_next_stackframe(vm, fun, arity, ret_reg);
+  vm->current_function = fun;
 
   vm->ip = fun->location;
 }
@@ -184,9 +209,9 @@ void op_return(struct vm *vm) {
   unsigned int ret_address = curr_frame->ret_address;
 
   prev_frame->registers[curr_frame->ret_register] = curr_frame->registers[0];
-  memset(curr_frame->registers, 0, REGISTER_COUNT * sizeof(owl_term));
 
   vm->current_frame -= 1;
+  vm->current_function = prev_frame->function;
   vm->ip = ret_address;
 }
 
@@ -232,13 +257,12 @@ void op_list(struct vm *vm) {
   uint8_t reg  = next_byte(vm);
   uint8_t size = next_byte(vm);
 
-  owl_term list = owl_list_init();
-
+  owl_term elems[size];
   for(uint8_t i = 0; i < size; i++) {
-    list = owl_list_push(vm, list, get_var(vm, next_byte(vm)));
+    elems[i] = get_var(vm, next_byte(vm));
   }
 
-  set_reg(vm, reg, list);
+  set_reg(vm, reg, owl_list_from(vm, elems, size));
 
   vm->ip += 1;
 }
@@ -338,10 +362,363 @@ void op_load_string(struct vm *vm) {
   uint8_t reg = next_byte(vm);
   uint8_t string_id = next_byte(vm);
 
-  const char* string = strings_lookup_id(vm->intern_pool, string_id);
-  owl_term owl_string = owl_string_from(string);
+  set_reg(vm, reg, vm->interned_strings[string_id]);
+  vm->ip += 1;
+}
+
+void op_load_const(struct vm *vm) {
+  debug_print("%04x OP_LOAD_CONST\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  uint8_t low = next_byte(vm);
+  uint8_t high = next_byte(vm);
+
+  set_reg(vm, reg, vm->constants[low + 256 * high]);
+  vm->ip += 1;
+}
+
+void op_list_builder(struct vm *vm) {
+  debug_print("%04x OP_LIST_BUILDER\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term list = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_list_builder(vm, list));
+  vm->ip += 1;
+}
+
+void op_list_builder_push(struct vm *vm) {
+  debug_print("%04x OP_LIST_BUILDER_PUSH\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term builder = get_var(vm, next_byte(vm));
+  owl_term elem = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_list_builder_push(vm, builder, elem));
+  vm->ip += 1;
+}
+
+void op_list_builder_freeze(struct vm *vm) {
+  debug_print("%04x OP_LIST_BUILDER_FREEZE\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term builder = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_list_builder_freeze(vm, builder));
+  vm->ip += 1;
+}
+
+// Functions that call back into Owl read their operands in place, vm_call
+// needs the instruction pointer at the start of the instruction
+void op_list_map(struct vm *vm) {
+  debug_print("%04x OP_LIST_MAP\n", vm->ip);
+  uint8_t reg = vm->code[vm->ip + 1];
+  owl_term list = get_var(vm, vm->code[vm->ip + 2]);
+  owl_term function = get_var(vm, vm->code[vm->ip + 3]);
+
+  owl_term result = owl_list_map(vm, list, function);
+
+  set_reg(vm, reg, result);
+  vm->ip += 4;
+}
+
+void op_list_filter(struct vm *vm) {
+  debug_print("%04x OP_LIST_FILTER\n", vm->ip);
+  uint8_t reg = vm->code[vm->ip + 1];
+  owl_term list = get_var(vm, vm->code[vm->ip + 2]);
+  owl_term predicate = get_var(vm, vm->code[vm->ip + 3]);
+
+  owl_term result = owl_list_filter(vm, list, predicate);
+
+  set_reg(vm, reg, result);
+  vm->ip += 4;
+}
+
+void op_list_reduce(struct vm *vm) {
+  debug_print("%04x OP_LIST_REDUCE\n", vm->ip);
+  uint8_t reg = vm->code[vm->ip + 1];
+  owl_term list = get_var(vm, vm->code[vm->ip + 2]);
+  owl_term acc = get_var(vm, vm->code[vm->ip + 3]);
+  owl_term function = get_var(vm, vm->code[vm->ip + 4]);
+
+  owl_term result = owl_list_reduce(vm, list, acc, function);
+
+  set_reg(vm, reg, result);
+  vm->ip += 5;
+}
+
+void op_list_each(struct vm *vm) {
+  debug_print("%04x OP_LIST_EACH\n", vm->ip);
+  uint8_t reg = vm->code[vm->ip + 1];
+  owl_term list = get_var(vm, vm->code[vm->ip + 2]);
+  owl_term function = get_var(vm, vm->code[vm->ip + 3]);
+
+  owl_term result = owl_list_each(vm, list, function);
+
+  set_reg(vm, reg, result);
+  vm->ip += 4;
+}
+
+void op_list_find(struct vm *vm) {
+  debug_print("%04x OP_LIST_FIND\n", vm->ip);
+  uint8_t reg = vm->code[vm->ip + 1];
+  owl_term list = get_var(vm, vm->code[vm->ip + 2]);
+  owl_term predicate = get_var(vm, vm->code[vm->ip + 3]);
+
+  owl_term result = owl_list_find(vm, list, predicate);
+
+  set_reg(vm, reg, result);
+  vm->ip += 4;
+}
+
+void op_list_contains(struct vm *vm) {
+  debug_print("%04x OP_LIST_CONTAINS\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term list = get_var(vm, next_byte(vm));
+  owl_term elem = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_bool(owl_list_contains(list, elem)));
+  vm->ip += 1;
+}
+
+void op_list_reverse(struct vm *vm) {
+  debug_print("%04x OP_LIST_REVERSE\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term list = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_list_reverse(vm, list));
+  vm->ip += 1;
+}
+
+void op_list_sort(struct vm *vm) {
+  debug_print("%04x OP_LIST_SORT\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term list = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_list_sort(vm, list));
+  vm->ip += 1;
+}
+
+void op_list_sort_by(struct vm *vm) {
+  debug_print("%04x OP_LIST_SORT_BY\n", vm->ip);
+  uint8_t reg = vm->code[vm->ip + 1];
+  owl_term list = get_var(vm, vm->code[vm->ip + 2]);
+  owl_term function = get_var(vm, vm->code[vm->ip + 3]);
+
+  owl_term result = owl_list_sort_by(vm, list, function);
+
+  set_reg(vm, reg, result);
+  vm->ip += 4;
+}
+
+void op_list_pmap(struct vm *vm) {
+  debug_print("%04x OP_LIST_PMAP\n", vm->ip);
+  uint8_t reg = vm->code[vm->ip + 1];
+  owl_term list = get_var(vm, vm->code[vm->ip + 2]);
+  owl_term function = get_var(vm, vm->code[vm->ip + 3]);
+
+  owl_term result = owl_list_pmap(vm, list, function);
+
+  set_reg(vm, reg, result);
+  vm->ip += 4;
+}
+
+void op_list_preduce(struct vm *vm) {
+  debug_print("%04x OP_LIST_PREDUCE\n", vm->ip);
+  uint8_t reg = vm->code[vm->ip + 1];
+  owl_term list = get_var(vm, vm->code[vm->ip + 2]);
+  owl_term identity = get_var(vm, vm->code[vm->ip + 3]);
+  owl_term function = get_var(vm, vm->code[vm->ip + 4]);
+
+  owl_term result = owl_list_preduce(vm, list, identity, function);
+
+  set_reg(vm, reg, result);
+  vm->ip += 5;
+}
+
+void op_list_sum(struct vm *vm) {
+  debug_print("%04x OP_LIST_SUM\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term list = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_list_sum(list));
+  vm->ip += 1;
+}
+
+void op_list_max(struct vm *vm) {
+  debug_print("%04x OP_LIST_MAX\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term list = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_list_max(list));
+  vm->ip += 1;
+}
+
+void op_list_min(struct vm *vm) {
+  debug_print("%04x OP_LIST_MIN\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term list = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_list_min(list));
+  vm->ip += 1;
+}
+
+void op_list_index_of(struct vm *vm) {
+  debug_print("%04x OP_LIST_INDEX_OF\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term list = get_var(vm, next_byte(vm));
+  owl_term elem = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_list_index_of(list, elem));
+  vm->ip += 1;
+}
+
+void op_map_new(struct vm *vm) {
+  debug_print("%04x OP_MAP_NEW\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+
+  set_reg(vm, reg, owl_map_init());
+  vm->ip += 1;
+}
+
+void op_map_get(struct vm *vm) {
+  debug_print("%04x OP_MAP_GET\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term map = get_var(vm, next_byte(vm));
+  owl_term key = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_map_get(map, key));
+  vm->ip += 1;
+}
+
+void op_map_put(struct vm *vm) {
+  debug_print("%04x OP_MAP_PUT\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term map = get_var(vm, next_byte(vm));
+  owl_term key = get_var(vm, next_byte(vm));
+  owl_term value = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_map_put(vm, map, key, value));
+  vm->ip += 1;
+}
+
+void op_map_remove(struct vm *vm) {
+  debug_print("%04x OP_MAP_REMOVE\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term map = get_var(vm, next_byte(vm));
+  owl_term key = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_map_remove(vm, map, key));
+  vm->ip += 1;
+}
+
+void op_map_has_key(struct vm *vm) {
+  debug_print("%04x OP_MAP_HAS_KEY\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term map = get_var(vm, next_byte(vm));
+  owl_term key = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_bool(owl_map_has_key(map, key)));
+  vm->ip += 1;
+}
+
+void op_map_count(struct vm *vm) {
+  debug_print("%04x OP_MAP_COUNT\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term map = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_map_count(map));
+  vm->ip += 1;
+}
+
+void op_map_to_list(struct vm *vm) {
+  debug_print("%04x OP_MAP_TO_LIST\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term map = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_map_to_list(vm, map));
+  vm->ip += 1;
+}
+
+void op_set_new(struct vm *vm) {
+  debug_print("%04x OP_SET_NEW\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+
+  set_reg(vm, reg, owl_set_init());
+  vm->ip += 1;
+}
+
+void op_set_put(struct vm *vm) {
+  debug_print("%04x OP_SET_PUT\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term set = get_var(vm, next_byte(vm));
+  owl_term elem = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_set_put(vm, set, elem));
+  vm->ip += 1;
+}
+
+void op_set_remove(struct vm *vm) {
+  debug_print("%04x OP_SET_REMOVE\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term set = get_var(vm, next_byte(vm));
+  owl_term elem = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_set_remove(vm, set, elem));
+  vm->ip += 1;
+}
+
+void op_set_member(struct vm *vm) {
+  debug_print("%04x OP_SET_MEMBER\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term set = get_var(vm, next_byte(vm));
+  owl_term elem = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_bool(owl_set_member(set, elem)));
+  vm->ip += 1;
+}
+
+void op_set_count(struct vm *vm) {
+  debug_print("%04x OP_SET_COUNT\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term set = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_set_count(set));
+  vm->ip += 1;
+}
+
+void op_set_union(struct vm *vm) {
+  debug_print("%04x OP_SET_UNION\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term left = get_var(vm, next_byte(vm));
+  owl_term right = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_set_union(vm, left, right));
+  vm->ip += 1;
+}
 
-  set_reg(vm, reg, owl_string);
+void op_set_intersection(struct vm *vm) {
+  debug_print("%04x OP_SET_INTERSECTION\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term left = get_var(vm, next_byte(vm));
+  owl_term right = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_set_intersection(vm, left, right));
+  vm->ip += 1;
+}
+
+void op_set_difference(struct vm *vm) {
+  debug_print("%04x OP_SET_DIFFERENCE\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term left = get_var(vm, next_byte(vm));
+  owl_term right = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_set_difference(vm, left, right));
+  vm->ip += 1;
+}
+
+void op_set_to_list(struct vm *vm) {
+  debug_print("%04x OP_SET_TO_LIST\n", vm->ip);
+  uint8_t reg = next_byte(vm);
+  owl_term set = get_var(vm, next_byte(vm));
+
+  set_reg(vm, reg, owl_set_to_list(vm, set));
   vm->ip += 1;
 }
 
@@ -393,13 +770,13 @@ void op_call_local(struct vm *vm) {
   uint8_t arity = next_byte(vm);
 
   if (owl_tag_of(function) != FUNCTION) {
-    printf("TypeError: expected Function, got %s\n", owl_extract_ptr(owl_type_of(function)));
+    printf("TypeError: expected Function, got %s\n", owl_type_name(function));
     exit(1);
   }
 
   Function* fun = owl_term_to_function(function);
-  vm->current_function = fun;
   setup_next_stackframe(vm, fun, arity, ret_reg);
+  vm->current_function = fun;
 
   vm->ip = fun->location;
 }
@@ -469,7 +846,7 @@ void op_function_name(struct vm *vm) {
   uint8_t ret_reg = next_byte(vm);
   uint8_t function = next_byte(vm);
 
-  owl_term function_name = owl_function_name(get_var(vm, function));
+  owl_term function_name = owl_function_name(vm, get_var(vm, function));
 
   debug_print("%04x OP_FUNCTION_NAME\n", vm->ip);
 
@@ -495,12 +872,32 @@ void op_string_contains(struct vm *vm) {
   owl_term string = get_var(vm, next_byte(vm));
   owl_term substr = get_var(vm, next_byte(vm));
 
-  owl_term res = owl_string_contains(string, substr);
+  owl_term res = owl_string_contains(vm, string, substr);
   set_reg(vm, ret_reg, res);
 
   vm->ip += 1;
 }
 
+void op_string_index_of(struct vm *vm) {
+  debug_print("%04x OP_STRING_INDEX_OF\n", vm->ip);
+  uint8_t ret_reg = next_byte(vm);
+  owl_term string = get_var(vm, next_byte(vm));
+  owl_term substr = get_var(vm, next_byte(vm));
+
+  set_reg(vm, ret_reg, owl_string_index_of(vm, string, substr));
+  vm->ip += 1;
+}
+
+void op_string_split(struct vm *vm) {
+  debug_print("%04x OP_STRING_SPLIT\n", vm->ip);
+  uint8_t ret_reg = next_byte(vm);
+  owl_term string = get_var(vm, next_byte(vm));
+  owl_term separator = get_var(vm, next_byte(vm));
+
+  set_reg(vm, ret_reg, owl_string_split(vm, string, separator));
+  vm->ip += 1;
+}
+
 void op_to_string(struct vm *vm) {
   debug_print("%04x OP_TO_STRING\n", vm->ip);
   uint8_t ret_reg = next_byte(vm);
@@ -533,18 +930,86 @@ void op_anon_fn(struct vm *vm) {
 
 void op_gc_collect(struct vm *vm) {
   debug_print("%04x OP_GC_COLLECT\n", vm->ip);
-  uint8_t ret_reg = next_byte(vm);
 
   uint32_t usage_before = gc_usage(vm);
   gc_collect(vm);
   uint32_t usage_after = gc_usage(vm);
   owl_term collected_bytes = owl_int_from(usage_before - usage_after);
 
+  uint8_t ret_reg = next_byte(vm);
+
   set_reg(vm, ret_reg, collected_bytes);
 
   vm->ip += 1;
 }
 
+static owl_term gc_stat(vm_t *vm, const char *name, uint64_t value) {
+  owl_term *ary = owl_alloc(vm, sizeof(owl_term) * 3);
+  ary[0] = 2;
+  ary[1] = owl_string_from(vm, name);
+  ary[2] = owl_int_from(value);
+
+  return owl_tag_as(ary, TUPLE);
+}
+
+// Returns a list of (name, value) tuples. Times are in microseconds, the
+// allocation rate is in bytes per second.
+void op_gc_stats(struct vm *vm) {
+  debug_print("%04x OP_GC_STATS\n", vm->ip);
+
+  uint8_t ret_reg = next_byte(vm);
+
+  GCState *gc = vm->gc;
+  GCStats stats = gc->stats;
+  uint64_t allocated = gc_bytes_allocated();
+  uint64_t elapsed = gc_clock() - stats.started_at;
+  uint64_t usage = gc_usage(vm);
+
+  owl_term entries[] = {
+    gc_stat(vm, "collections", stats.collections),
+    gc_stat(vm, "pause_total", stats.pause_total / 1000),
+    gc_stat(vm, "pause_last", stats.pause_last / 1000),
+    gc_stat(vm, "pause_max", gc->max_pause / 1000),
+    gc_stat(vm, "bytes_copied", stats.bytes_copied),
+    gc_stat(vm, "strings_deduped", stats.strings_deduped),
+    gc_stat(vm, "bytes_deduped", stats.bytes_deduped),
+    gc_stat(vm, "lists_compacted", stats.lists_compacted),
+    gc_stat(vm, "dedup_min_length", gc_dedup_min_length(gc)),
+    gc_stat(vm, "compacts_lists", gc_compacts_lists(gc)),
+    gc_stat(vm, "survival_rate", stats.collections ? gc_survival_rate(vm) : 100),
+    gc_stat(vm, "heap_size", gc->size + gc->large_bytes),
+    gc_stat(vm, "heap_used", usage),
+    gc_stat(vm, "heap_peak", usage > stats.usage_peak ? usage : stats.usage_peak),
+    gc_stat(vm, "bytes_allocated", allocated),
+    gc_stat(vm, "allocation_rate", elapsed ? allocated * 1000000000.0 / elapsed : 0),
+  };
+
+  owl_term result = owl_list_init();
+  for (uint32_t i = 0; i < sizeof(entries) / sizeof(owl_term); i++) {
+    result = owl_list_push(vm, result, entries[i]);
+  }
+
+  set_reg(vm, ret_reg, result);
+
+  vm->ip += 1;
+}
+
+// Returns the number of objects written, or false if the file could not be
+// opened. Reads its operands in place, the live map of the current frame is
+// found at the location of this instruction.
+void op_heap_dump(struct vm *vm) {
+  debug_print("%04x OP_HEAP_DUMP\n", vm->ip);
+
+  uint8_t ret_reg = vm->code[vm->ip + 1];
+  const char *path = owl_string_chars(owl_string_flatten(vm, get_var(vm, vm->code[vm->ip + 2])));
+
+  int64_t written = heap_dump(vm, path);
+
+  set_reg(vm, ret_reg, written < 0 ? OWL_FALSE : owl_int_from(written));
+
+  vm->ip += 3;
+}
+
 void opcode_init(vm_t * vm) {
   for (int i = 0; i < 255; i++)
     vm->opcodes[i] = op_unknown;
@@ -586,4 +1051,43 @@ void opcode_init(vm_t * vm) {
   vm->opcodes[OP_TO_STRING] = op_to_string;
   vm->opcodes[OP_ANON_FN] = op_anon_fn;
   vm->opcodes[OP_GC_COLLECT] = op_gc_collect;
+  vm->opcodes[OP_GC_STATS] = op_gc_stats;
+  vm->opcodes[OP_HEAP_DUMP] = op_heap_dump;
+  vm->opcodes[OP_LOAD_CONST] = op_load_const;
+  vm->opcodes[OP_LIST_BUILDER] = op_list_builder;
+  vm->opcodes[OP_LIST_BUILDER_PUSH] = op_list_builder_push;
+  vm->opcodes[OP_LIST_BUILDER_FREEZE] = op_list_builder_freeze;
+  vm->opcodes[OP_LIST_MAP] = op_list_map;
+  vm->opcodes[OP_LIST_FILTER] = op_list_filter;
+  vm->opcodes[OP_LIST_REDUCE] = op_list_reduce;
+  vm->opcodes[OP_LIST_EACH] = op_list_each;
+  vm->opcodes[OP_LIST_FIND] = op_list_find;
+  vm->opcodes[OP_LIST_CONTAINS] = op_list_contains;
+  vm->opcodes[OP_LIST_REVERSE] = op_list_reverse;
+  vm->opcodes[OP_LIST_PMAP] = op_list_pmap;
+  vm->opcodes[OP_LIST_PREDUCE] = op_list_preduce;
+  vm->opcodes[OP_LIST_SUM] = op_list_sum;
+  vm->opcodes[OP_LIST_MAX] = op_list_max;
+  vm->opcodes[OP_LIST_MIN] = op_list_min;
+  vm->opcodes[OP_LIST_INDEX_OF] = op_list_index_of;
+  vm->opcodes[OP_MAP_NEW] = op_map_new;
+  vm->opcodes[OP_MAP_GET] = op_map_get;
+  vm->opcodes[OP_MAP_PUT] = op_map_put;
+  vm->opcodes[OP_MAP_REMOVE] = op_map_remove;
+  vm->opcodes[OP_MAP_HAS_KEY] = op_map_has_key;
+  vm->opcodes[OP_MAP_COUNT] = op_map_count;
+  vm->opcodes[OP_MAP_TO_LIST] = op_map_to_list;
+  vm->opcodes[OP_SET_NEW] = op_set_new;
+  vm->opcodes[OP_SET_PUT] = op_set_put;
+  vm->opcodes[OP_SET_REMOVE] = op_set_remove;
+  vm->opcodes[OP_SET_MEMBER] = op_set_member;
+  vm->opcodes[OP_SET_COUNT] = op_set_count;
+  vm->opcodes[OP_SET_UNION] = op_set_union;
+  vm->opcodes[OP_SET_INTERSECTION] = op_set_intersection;
+  vm->opcodes[OP_SET_DIFFERENCE] = op_set_difference;
+  vm->opcodes[OP_SET_TO_LIST] = op_set_to_list;
+  vm->opcodes[OP_LIST_SORT] = op_list_sort;
+  vm->opcodes[OP_LIST_SORT_BY] = op_list_sort_by;
+  vm->opcodes[OP_STRING_INDEX_OF] = op_string_index_of;
+  vm->opcodes[OP_STRING_SPLIT] = op_string_split;
 }
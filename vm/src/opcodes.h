@@ -51,6 +51,59 @@ enum opcode_values {
     OP_TO_STRING,
     OP_ANON_FN,
     OP_GC_COLLECT,
+    OP_LIVE_MAP,
+    OP_GC_STATS,
+    OP_HEAP_DUMP,
+    OP_LOAD_CONST,
+    OP_LIST_BUILDER,
+    OP_LIST_BUILDER_PUSH,
+    OP_LIST_BUILDER_FREEZE,
+    OP_LIST_MAP,
+    OP_LIST_FILTER,
+    OP_LIST_REDUCE,
+    OP_LIST_EACH,
+    OP_LIST_FIND,
+    OP_LIST_CONTAINS,
+    OP_LIST_REVERSE,
+    OP_LIST_PMAP,
+    OP_LIST_PREDUCE,
+    OP_LIST_SUM,
+    OP_LIST_MAX,
+    OP_LIST_MIN,
+    OP_LIST_INDEX_OF,
+    OP_MAP_NEW,
+    OP_MAP_GET,
+    OP_MAP_PUT,
+    OP_MAP_REMOVE,
+    OP_MAP_HAS_KEY,
+    OP_MAP_COUNT,
+    OP_MAP_TO_LIST,
+    OP_SET_NEW,
+    OP_SET_PUT,
+    OP_SET_REMOVE,
+    OP_SET_MEMBER,
+    OP_SET_COUNT,
+    OP_SET_UNION,
+    OP_SET_INTERSECTION,
+    OP_SET_DIFFERENCE,
+    OP_SET_TO_LIST,
+    OP_LIST_SORT,
+    OP_LIST_SORT_BY,
+    OP_STRING_INDEX_OF,
+    OP_STRING_SPLIT,
+};
+
+// Kinds of value making up the constant that follows OP_LOAD_CONST in
+// compiled modules. The loader builds it and leaves a two byte index in the
+// code in its place.
+enum constant_kinds {
+    CONST_INT = 0,
+    CONST_TRUE,
+    CONST_FALSE,
+    CONST_NIL,
+    CONST_STRING,
+    CONST_TUPLE,
+    CONST_LIST,
 };
 
 void opcode_init(vm_t *vm);
@@ -6,6 +6,9 @@
 #define MAX_FUNCTIONS 255
 #define NO_FUNCTION UINT64_MAX
 #define MAX_UPVALUES 128
+#define NATIVE_RETURN REGISTER_COUNT   // Receives the results of calls made by native code, see vm_call
+#define NATIVE_ROOTS (STACK_DEPTH * 4)
+#define MAX_THREADS 64              // For parallel list functions, see parallel.c
 
 #define DEBUG false
 #define debug_print(fmt, ...) \
@@ -24,6 +27,8 @@ typedef struct vm vm_t;
 // tuple:   010
 // list:    011
 // string:  100
+// function: 101
+// map:      111, as nil looks like it is tagged 110
 typedef enum owl_tag {
   POINTER = 0,
   INT,
@@ -31,15 +36,76 @@ typedef enum owl_tag {
   LIST,
   STRING,
   FUNCTION,
+  MAP = 7,
 } owl_tag;
 
+#define GC_PAUSE_BUCKETS 16
+
+typedef struct GCStats {
+  uint64_t collections;
+  uint64_t pause_total;                // Nanoseconds spent in collector pauses
+  uint64_t pause_last;                 // Pauses of the last collection, in nanoseconds
+  uint64_t bytes_copied;               // Bytes evacuated over all collections
+  uint64_t usage_before;               // Heap usage when the last collection started
+  uint64_t usage_after;                // Heap usage when it finished
+  uint64_t usage_peak;
+  uint64_t started_at;                 // When the heap was created
+  uint64_t strings_deduped;            // Strings forwarded to an equal copy instead of being copied
+  uint64_t bytes_deduped;              // Bytes those copies would have taken up
+  uint64_t lists_compacted;            // Lists rebuilt with full leaves and no size tables
+  uint64_t cycle_copied;               // Collection in progress
+  uint64_t cycle_deduped;
+  uint64_t cycle_pause;
+} GCStats;
+
+typedef struct GCPool GCPool;
+typedef struct LargeObject LargeObject;
+typedef struct ImmixHeap ImmixHeap;
+typedef struct HeapProfile HeapProfile;
+typedef struct StringDedup StringDedup;
+typedef struct ListCompaction ListCompaction;
+typedef struct ParallelPool ParallelPool;
+typedef struct ParallelWorker ParallelWorker;
+
 typedef struct GCState {
   uint8_t* to_space;
   uint8_t* from_space;
   uint8_t* alloc_ptr;
   uint64_t size;
+  uint32_t threads;                    // Threads used to copy live objects, 1 means serial
+  GCPool* pool;                        // Worker threads, started on the first parallel collection
+  LargeObject** large_objects;         // Objects mapped outside the semispaces, sorted by address
+  uint32_t large_count;
+  uint32_t large_capacity;
+  uint64_t large_bytes;                // Bytes currently mapped for large objects
+  uint64_t large_limit;                // Collect once large objects grow past this
+  uint64_t pause_budget;               // Nanoseconds of work per incremental step, 0 when not incremental
+  bool cycle_active;                   // An incremental cycle is in progress
+  void** forwards;                     // Replicas of from-space objects, indexed by offset / 8
+  owl_term* gray;                      // Shaded objects whose references still need scanning
+  uint32_t gray_count;
+  uint32_t gray_capacity;
+  uint64_t pauses[GC_PAUSE_BUCKETS];   // Bucket n counts pauses shorter than 2^n microseconds
+  uint64_t max_pause;                  // Longest pause so far, in nanoseconds
+  GCStats stats;
+  bool log;                            // Print a line per collection to stderr
+  bool immortal;                       // Allocate outside of the heap, while loading constants
+  uint8_t* immortal_ptr;               // Bump pointer into the current immortal chunk
+  uint8_t* immortal_end;
+  ImmixHeap* immix;                    // Mark-region heap used instead of the semispaces, if selected
+  HeapProfile* profile;                // Allocation site profiler, if enabled
+  StringDedup* dedup;                  // Strings copied so far this collection, if deduplicating
+  ListCompaction* compaction;          // Lists to repack once copied, if compacting
 } GCState;
 
+// Registers that hold live values while a frame is suspended at a call site.
+// Emitted by the compiler after every safepoint instruction.
+typedef struct LiveMap {
+  uint64_t call_site;                  // Location of the safepoint instruction
+  uint64_t return_address;             // Location of the instruction following it
+  uint64_t live[(REGISTER_COUNT + 63) / 64];
+} LiveMap;
+
 typedef struct Function {
   uint64_t location;
   const char* name;
@@ -51,7 +117,7 @@ typedef struct frame_t {
   unsigned int ret_address;
   unsigned int ret_register;
   Function* function;
-  owl_term registers[REGISTER_COUNT]; // Each frame has their own registers
+  owl_term registers[REGISTER_COUNT + 1]; // Each frame has their own registers, plus NATIVE_RETURN
 } frame_t;
 
 typedef void opcode_impl(vm_t *in);
@@ -60,14 +126,30 @@ struct vm {
   frame_t frames[STACK_DEPTH];
   unsigned int current_frame;
   unsigned int ip;                     // Instruction pointer
+  unsigned int instruction;            // Start of the running instruction, only kept while profiling
   uint8_t *code;                       // Loaded code
   uint64_t code_size;                  // Loaded code size
   opcode_impl *opcodes[255];           // Opcode lookup table
   struct strings *function_names;      // Interned function names
   struct strings *intern_pool;         // General intern pool
+  owl_term interned_strings[UINT8_MAX]; // Strings of the intern pool by their id, built outside of the heap
   Function* functions[MAX_FUNCTIONS];   // Function lookup table
   Function* current_function;
   GCState* gc;
+  LiveMap* live_maps;                  // Sorted by location, code is only ever appended
+  uint64_t live_map_count;
+  uint64_t live_map_capacity;
+  owl_term* constants;                 // Literals built at load time, indexed by OP_LOAD_CONST
+  uint32_t constant_count;
+  uint32_t constant_capacity;
+  uint32_t list_builders;              // Owner of the most recently started list builder
+  owl_term native_roots[NATIVE_ROOTS]; // Terms native code holds on to while it calls back into Owl
+  uint32_t native_root_count;
+  uint32_t threads;                    // Threads shared out by List.pmap and List.preduce, 1 means serial
+  ParallelPool* parallel;              // Their workers, started on first use
+  ParallelWorker* worker;              // Set on the VM of each of those workers
+  uint8_t* lab;                        // Where a worker's VM allocates, carved from to-space
+  uint8_t* lab_end;
 };
 
 
@@ -0,0 +1,206 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <setjmp.h>
+
+#include "parallel.h"
+
+// Parallel list functions
+//
+// List.pmap and List.preduce split a list into chunks and run each of them as a
+// task on a pool of threads, configured with OWL_THREADS. The thread that hands
+// out the tasks takes part as well. Every worker runs Owl code on a VM of its
+// own, with its own frames and native roots, sharing the loaded code and the
+// heap with the VM it works for.
+//
+// Workers allocate out of buffers carved from to-space, much like the threads
+// of the parallel collector, and never collect. Whenever a worker needs more
+// than that, be it a collection, a heap dump, a large object or code that has
+// not been loaded yet, it bails out: the task it was running is dropped, no new
+// tasks are started and `parallel_run` leaves their results empty for the
+// caller to compute on its own VM. Callbacks may therefore run more than once
+// for the same element, and should not have side effects.
+//
+// Only the semispace collector supports this, and neither while collecting
+// incrementally nor while profiling the heap.
+
+#define WORKER_BUILDERS (1U << 20)     // List builder owners set aside for each worker in a batch
+
+struct ParallelWorker {
+  ParallelPool *pool;
+  pthread_t thread;
+  vm_t *vm;
+  jmp_buf bail;
+};
+
+struct ParallelPool {
+  uint32_t n_workers;
+  ParallelWorker *workers;
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t finished;
+  uint64_t epoch;          // Bumped for every batch of tasks
+  uint32_t running;        // Helper threads still busy with the current batch
+  uint32_t n_tasks;
+  uint32_t next_task;      // Claimed by incrementing it
+  bool stopped;            // Somebody bailed out, nobody starts another task
+  owl_term *results;
+  parallel_task task;
+  void *context;
+};
+
+bool parallel_available(vm_t *vm) {
+  GCState *gc = vm->gc;
+  return vm->threads > 1 && !vm->worker && !gc->immix && !gc->pause_budget && !gc->profile;
+}
+
+// Gives up on the running task, see above. Only to be called on a worker's VM.
+void parallel_bail(vm_t *vm) {
+  longjmp(vm->worker->bail, 1);
+}
+
+static void run_tasks(ParallelWorker *worker) {
+  ParallelPool *pool = worker->pool;
+
+  if (setjmp(worker->bail)) {
+    __atomic_store_n(&pool->stopped, true, __ATOMIC_RELAXED);
+    return;
+  }
+
+  for (;;) {
+    if (__atomic_load_n(&pool->stopped, __ATOMIC_RELAXED)) {
+      return;
+    }
+
+    uint32_t index = __atomic_fetch_add(&pool->next_task, 1, __ATOMIC_RELAXED);
+    if (index >= pool->n_tasks) {
+      return;
+    }
+    pool->results[index] = pool->task(worker->vm, index, pool->context);
+  }
+}
+
+static void* parallel_worker_main(void *arg) {
+  ParallelWorker *worker = arg;
+  ParallelPool *pool = worker->pool;
+  uint64_t seen = 0;
+
+  for (;;) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->epoch == seen) {
+      pthread_cond_wait(&pool->start, &pool->lock);
+    }
+    seen = pool->epoch;
+    pthread_mutex_unlock(&pool->lock);
+
+    run_tasks(worker);
+
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->running == 0) {
+      pthread_cond_signal(&pool->finished);
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  return NULL;
+}
+
+static ParallelPool* pool_new(uint32_t n_workers) {
+  ParallelPool *pool = calloc(1, sizeof(ParallelPool));
+  pool->n_workers = n_workers;
+  pool->workers = calloc(n_workers, sizeof(ParallelWorker));
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->finished, NULL);
+
+  for (uint32_t i = 0; i < n_workers; i++) {
+    pool->workers[i].pool = pool;
+    pool->workers[i].vm = calloc(1, sizeof(struct vm));
+    if (pool->workers[i].vm == NULL) {
+      puts("Insufficient memory");
+      exit(1);
+    }
+    pool->workers[i].vm->worker = &pool->workers[i];
+  }
+
+  // Worker 0 is the thread that hands out the tasks
+  for (uint32_t i = 1; i < n_workers; i++) {
+    if (pthread_create(&pool->workers[i].thread, NULL, parallel_worker_main, &pool->workers[i]) != 0) {
+      puts("Could not start worker thread");
+      exit(1);
+    }
+  }
+
+  return pool;
+}
+
+// Shares the code and heap of `vm` with a worker's VM, which starts out with
+// nothing on its stack. Its bottom frame stands in for the frame of `vm`, which
+// is suspended at the instruction that handed out the tasks.
+static void worker_prepare(ParallelWorker *worker, vm_t *vm, uint32_t index) {
+  vm_t *own = worker->vm;
+
+  own->code = vm->code;
+  own->code_size = vm->code_size;
+  memcpy(own->opcodes, vm->opcodes, sizeof(vm->opcodes));
+  own->function_names = vm->function_names;
+  own->intern_pool = vm->intern_pool;
+  memcpy(own->interned_strings, vm->interned_strings, sizeof(vm->interned_strings));
+  memcpy(own->functions, vm->functions, sizeof(vm->functions));
+  own->gc = vm->gc;
+  own->live_maps = vm->live_maps;
+  own->live_map_count = vm->live_map_count;
+  own->constants = vm->constants;
+  own->constant_count = vm->constant_count;
+  own->list_builders = vm->list_builders + (index + 1) * WORKER_BUILDERS;
+  own->threads = 1;
+
+  own->ip = vm->ip;
+  own->instruction = vm->ip;
+  own->current_frame = 0;
+  own->current_function = vm->current_function;
+  own->frames[0].function = vm->current_function;
+  own->native_root_count = 0;
+  own->lab = NULL;
+  own->lab_end = NULL;
+}
+
+// Runs `n_tasks` tasks on the pool and stores what each returns in `results`.
+// Results of tasks that were dropped are left as 0. Has to be called at a
+// safepoint, with no collection in progress. Nothing that `task` reads through
+// `context` is moved until this returns.
+void parallel_run(vm_t *vm, uint32_t n_tasks, owl_term *results, parallel_task task, void *context) {
+  if (!vm->parallel) {
+    vm->parallel = pool_new(vm->threads);
+  }
+  ParallelPool *pool = vm->parallel;
+
+  for (uint32_t i = 0; i < pool->n_workers; i++) {
+    worker_prepare(&pool->workers[i], vm, i);
+  }
+  memset(results, 0, n_tasks * sizeof(owl_term));
+
+  pthread_mutex_lock(&pool->lock);
+  pool->n_tasks = n_tasks;
+  pool->next_task = 0;
+  pool->stopped = false;
+  pool->results = results;
+  pool->task = task;
+  pool->context = context;
+  pool->running = pool->n_workers - 1;
+  pool->epoch++;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  run_tasks(&pool->workers[0]);
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->running > 0) {
+    pthread_cond_wait(&pool->finished, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  // Builders started later on do not take over nodes of those the workers started
+  vm->list_builders += (pool->n_workers + 1) * WORKER_BUILDERS;
+}
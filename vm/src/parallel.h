@@ -0,0 +1,13 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "owl.h"
+
+// Computes the result of task number `index` on the VM it is given
+typedef owl_term (*parallel_task)(vm_t *vm, uint32_t index, void *context);
+
+bool parallel_available(vm_t *vm);
+void parallel_run(vm_t *vm, uint32_t n_tasks, owl_term *results, parallel_task task, void *context);
+void parallel_bail(vm_t *vm) __attribute__((noreturn));
+
+#endif  // PARALLEL_H
@@ -5,6 +5,8 @@
 
 #include "opcodes.h"
 #include "vm.h"
+#include "alloc.h"
+#include "parallel.h"
 #include "std/owl_code.h"
 #include "std/owl_function.h"
 #include "std/owl_list.h"
@@ -37,16 +39,77 @@ void scanner_read(void * address, uintptr_t size, scanner_t *scanner) {
   memcpy(address, &scanner->mem[scanner->index], size);
   scanner->index += size;
 }
+
+// Builds the constant encoded at the scanner's position, see OP_LOAD_CONST
+static owl_term read_constant(vm_t *vm, scanner_t *scanner) {
+  uint8_t kind = scanner_next(scanner);
+
+  switch(kind) {
+    case CONST_INT: {
+      uint8_t low = scanner_next(scanner);
+      uint8_t high = scanner_next(scanner);
+      return owl_int_from(low + 256 * high);
+    }
+    case CONST_TRUE:
+      return OWL_TRUE;
+    case CONST_FALSE:
+      return OWL_FALSE;
+    case CONST_NIL:
+      return OWL_NIL;
+    case CONST_STRING: {
+      // The size counts the NUL that ends the string
+      uint8_t size = scanner_next(scanner);
+      OwlString *string = owl_string_alloc(vm, size - 1);
+      scanner_read(string->chars, size, scanner);
+      return string_to_owl(string);
+    }
+    case CONST_TUPLE: {
+      uint8_t size = scanner_next(scanner);
+      owl_term *ary = owl_alloc(vm, sizeof(owl_term) * (size + 1));
+      ary[0] = size;
+      for (uint8_t i = 1; i <= size; i++) {
+        ary[i] = read_constant(vm, scanner);
+      }
+      return owl_tag_as((owl_term) ary, TUPLE);
+    }
+    case CONST_LIST: {
+      uint8_t size = scanner_next(scanner);
+      owl_term list = owl_list_init();
+      for (uint8_t i = 0; i < size; i++) {
+        list = owl_list_push(vm, list, read_constant(vm, scanner));
+      }
+      return list;
+    }
+    default:
+      printf("Unknown constant: 0x%02x\n", kind);
+      exit(1);
+  }
+}
+
+static uint32_t add_constant(vm_t *vm, owl_term constant) {
+  if (vm->constant_count == vm->constant_capacity) {
+    vm->constant_capacity = vm->constant_capacity == 0 ? 64 : vm->constant_capacity * 2;
+    vm->constants = realloc(vm->constants, vm->constant_capacity * sizeof(owl_term));
+  }
+
+  vm->constants[vm->constant_count] = constant;
+  return vm->constant_count++;
+}
+
 __attribute__((no_sanitize("address")))
 owl_term owl_load_module(vm_t *vm, uint8_t *bytecode, size_t size) {
   uint8_t ch;
 
   scanner_t *scanner = scanner_new(size, bytecode);
-  owl_term function_list = owl_list_init();
+  owl_term function_list = owl_list_builder(vm, owl_list_init());
   unsigned char *code_ptr = vm->code + vm->code_size;
+  uint64_t instruction_start = vm->code_size;
 
   while (scanner_has_next(scanner)) {
     ch = scanner_next(scanner);
+    if (ch != OP_LIVE_MAP) {
+      instruction_start = vm->code_size;
+    }
 
     switch(ch) {
       default:
@@ -64,6 +127,9 @@ owl_term owl_load_module(vm_t *vm, uint8_t *bytecode, size_t size) {
       case OP_STORE_NIL:
       case OP_JMP:
       case OP_GC_COLLECT:
+      case OP_GC_STATS:
+      case OP_MAP_NEW:
+      case OP_SET_NEW:
         *code_ptr++ = ch;
         *code_ptr++ = scanner_next(scanner);
         vm->code_size += 2;
@@ -77,6 +143,18 @@ owl_term owl_load_module(vm_t *vm, uint8_t *bytecode, size_t size) {
       case OP_TEST:
       case OP_FUNCTION_NAME:
       case OP_TO_STRING:
+      case OP_HEAP_DUMP:
+      case OP_LIST_BUILDER:
+      case OP_LIST_BUILDER_FREEZE:
+      case OP_LIST_REVERSE:
+      case OP_LIST_SUM:
+      case OP_LIST_MAX:
+      case OP_LIST_MIN:
+      case OP_MAP_COUNT:
+      case OP_MAP_TO_LIST:
+      case OP_SET_COUNT:
+      case OP_SET_TO_LIST:
+      case OP_LIST_SORT:
         *code_ptr++ = ch;
         *code_ptr++ = scanner_next(scanner);
         *code_ptr++ = scanner_next(scanner);
@@ -92,6 +170,26 @@ owl_term owl_load_module(vm_t *vm, uint8_t *bytecode, size_t size) {
       case OP_LIST_NTH:
       case OP_CONCAT:
       case OP_STRING_CONTAINS:
+      case OP_LIST_BUILDER_PUSH:
+      case OP_LIST_MAP:
+      case OP_LIST_FILTER:
+      case OP_LIST_EACH:
+      case OP_LIST_FIND:
+      case OP_LIST_CONTAINS:
+      case OP_LIST_PMAP:
+      case OP_LIST_INDEX_OF:
+      case OP_MAP_GET:
+      case OP_MAP_REMOVE:
+      case OP_MAP_HAS_KEY:
+      case OP_SET_PUT:
+      case OP_SET_REMOVE:
+      case OP_SET_MEMBER:
+      case OP_SET_UNION:
+      case OP_SET_INTERSECTION:
+      case OP_SET_DIFFERENCE:
+      case OP_LIST_SORT_BY:
+      case OP_STRING_INDEX_OF:
+      case OP_STRING_SPLIT:
         *code_ptr++ = ch;
         *code_ptr++ = scanner_next(scanner);
         *code_ptr++ = scanner_next(scanner);
@@ -100,6 +198,9 @@ owl_term owl_load_module(vm_t *vm, uint8_t *bytecode, size_t size) {
         break;
       case OP_LIST_SLICE:
       case OP_STRING_SLICE:
+      case OP_LIST_REDUCE:
+      case OP_LIST_PREDUCE:
+      case OP_MAP_PUT:
         *code_ptr++ = ch;
         *code_ptr++ = scanner_next(scanner);
         *code_ptr++ = scanner_next(scanner);
@@ -156,7 +257,7 @@ owl_term owl_load_module(vm_t *vm, uint8_t *bytecode, size_t size) {
         const char *function_name = strings_lookup_id(vm->function_names, id);
 
         Function* fun = owl_function_init(function_name, instruction);
-        function_list = owl_list_push(vm, function_list, owl_function_from(fun));
+        function_list = owl_list_builder_push(vm, function_list, owl_function_from(fun));
         vm->functions[id] = fun;
         break;
         }
@@ -169,10 +270,38 @@ owl_term owl_load_module(vm_t *vm, uint8_t *bytecode, size_t size) {
         scanner_read(str, size, scanner);
         uint64_t id = strings_intern(vm->intern_pool, str);
         assert(id < UINT8_MAX);
+        if (!vm->interned_strings[id]) {
+          vm->gc->immortal = true;
+          vm->interned_strings[id] = owl_string_new(vm, str, size - 1);
+          vm->gc->immortal = false;
+        }
         *code_ptr++ = (uint8_t) id; // string_id (needs to be bigger than 8 bit int)
         vm->code_size += 3;
         break;
       }
+      case OP_LOAD_CONST: {
+        *code_ptr++ = OP_LOAD_CONST;
+        *code_ptr++ = scanner_next(scanner); // ret loc
+
+        // Built outside of the heap, so that it lives as long as the code does
+        vm->gc->immortal = true;
+        uint32_t index = add_constant(vm, read_constant(vm, scanner));
+        vm->gc->immortal = false;
+        assert(index <= UINT16_MAX);
+
+        *code_ptr++ = (uint8_t) (index % 256);
+        *code_ptr++ = (uint8_t) (index / 256);
+        vm->code_size += 4;
+        break;
+      }
+      case OP_LIVE_MAP: {
+        // Refers to the instruction loaded just before it
+        uint8_t n_live = scanner_next(scanner);
+        uint8_t live[REGISTER_COUNT];
+        scanner_read(live, n_live, scanner);
+        gc_add_live_map(vm, instruction_start, vm->code_size, live, n_live);
+        break;
+      }
       case OP_CALL_LOCAL: {
         *code_ptr++ = OP_CALL_LOCAL;
         *code_ptr++ = scanner_next(scanner); // ret loc
@@ -211,11 +340,16 @@ owl_term owl_load_module(vm_t *vm, uint8_t *bytecode, size_t size) {
     }
   }
   free(scanner);
-  return function_list;
+  return owl_list_builder_freeze(vm, function_list);
 }
 
 owl_term owl_code_load(vm_t *vm, owl_term owl_filename) {
-  char *filename = owl_extract_ptr(owl_filename);
+  // Code is shared with the VM that workers of parallel list functions work for
+  if (vm->worker) {
+    parallel_bail(vm);
+  }
+
+  const char *filename = owl_string_chars(owl_string_flatten(vm, owl_filename));
   compiled_module_t *compiled = compile_file_to_memory(filename);
   owl_term functions = owl_load_module(vm, compiled->bytecode, compiled->size);
   free_module(compiled);
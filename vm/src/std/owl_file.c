@@ -13,30 +13,28 @@
 #include "term.h"
 
 owl_term owl_file_pwd(vm_t *vm) {
-  char *cwd = owl_alloc(vm, PATH_MAX);
+  char cwd[PATH_MAX];
   getcwd(cwd, PATH_MAX);
-  return owl_string_from(cwd);
+  return owl_string_from(vm, cwd);
 }
 
 owl_term owl_file_ls(vm_t *vm, owl_term path) {
   DIR *d;
   struct dirent *dir;
-  owl_term result = owl_list_init();
-  char *dirname = owl_extract_ptr(path);
+  const char *dirname = owl_string_chars(owl_string_flatten(vm, path));
+  owl_term result = owl_list_builder(vm, owl_list_init());
 
   d = opendir(dirname);
   if (d) {
     while ((dir = readdir(d)) != NULL) {
       if (strcmp(dir->d_name, ".") != 0 && strcmp(dir->d_name, "..") != 0) {
-        char *relpath = owl_alloc(vm, strlen(dir->d_name) + 1);
-        strcpy(relpath, dir->d_name);
-        owl_term entry = owl_string_from(relpath);
-        result = owl_list_push(vm, result, entry);
+        owl_term entry = owl_string_from(vm, dir->d_name);
+        result = owl_list_builder_push(vm, result, entry);
       }
     }
 
     closedir(d);
   }
 
-  return result;
+  return owl_list_builder_freeze(vm, result);
 }
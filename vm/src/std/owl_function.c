@@ -31,7 +31,44 @@ owl_term owl_function_get_upvalue(Function* fun, uint8_t index) {
   return fun->upvalues[index];
 }
 
-owl_term owl_function_name(owl_term function) {
+// Functions are equal when they run the same code over equal upvalues. A
+// closure is then equal to its copy wherever the collector has put either.
+bool owl_function_eq(owl_term left, owl_term right) {
+  Function *left_fun = owl_term_to_function(left);
+  Function *right_fun = owl_term_to_function(right);
+
+  if (left_fun->location != right_fun->location || left_fun->n_upvalues != right_fun->n_upvalues) {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < left_fun->n_upvalues; i++) {
+    if (!owl_terms_eq(left_fun->upvalues[i], right_fun->upvalues[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// By where their code is, then upvalue by upvalue, so that only equal
+// functions compare as 0
+int owl_function_compare(owl_term left, owl_term right) {
+  Function *left_fun = owl_term_to_function(left);
+  Function *right_fun = owl_term_to_function(right);
+
+  if (left_fun->location != right_fun->location) {
+    return left_fun->location < right_fun->location ? -1 : 1;
+  }
+
+  for (uint8_t i = 0; i < left_fun->n_upvalues; i++) {
+    int order = owl_terms_compare(left_fun->upvalues[i], right_fun->upvalues[i]);
+    if (order != 0) {
+      return order;
+    }
+  }
+  return 0;
+}
+
+owl_term owl_function_name(vm_t *vm, owl_term function) {
   Function* fun = owl_term_to_function(function);
-  return owl_string_from(fun->name);
+  return owl_string_from(vm, fun->name);
 }
@@ -10,6 +10,8 @@ Function* owl_function_init(const char* name, uint64_t location);
 Function* owl_anon_function_init(vm_t *vm, uint64_t location, uint8_t n_upvalues);
 void owl_function_set_upvalue(Function* fun, uint8_t index, owl_term value);
 owl_term owl_function_get_upvalue(Function* fun, uint8_t index);
-owl_term owl_function_name(owl_term function);
+owl_term owl_function_name(vm_t *vm, owl_term function);
+bool owl_function_eq(owl_term left, owl_term right);
+int owl_function_compare(owl_term left, owl_term right);
 
 #endif  // OWL_FUNCTION_H
@@ -1,11 +1,15 @@
 #include "term.h"
 #include "alloc.h"
+#include "vm.h"
+#include "parallel.h"
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include "std/owl_list.h"
+#include "util/int_kernels.h"
+#include "util/term_sort.h"
 
 #ifndef MAX
 #define MAX(a,b) (((a)>(b))?(a):(b))
@@ -21,6 +25,9 @@
 #define DEC_SHIFT(shift) (shift - (uint32_t) RRB_BITS)
 #define LEAF_NODE_SHIFT ((uint32_t) 0)
 
+// LEAF_INTS if `elem` is an int
+#define INT_FLAG(elem) (owl_tag_of((owl_term) (elem)) == INT ? LEAF_INTS : 0)
+
 // Abusing allocated pointers being unique to create GUIDs: using a single
 // malloc to create a guid.
 
@@ -54,6 +61,7 @@ static LeafNode* leaf_node_inc(vm_t *vm, const LeafNode *original);
 static LeafNode* leaf_node_dec(vm_t *vm, const LeafNode *original);
 static LeafNode* leaf_node_create(vm_t *vm, uint32_t size);
 static LeafNode* leaf_node_merge(vm_t *vm, LeafNode *left_leaf, LeafNode *right_leaf);
+static inline uint8_t leaf_flags(const LeafNode *leaf);
 
 static InternalNode* internal_node_create(vm_t *vm, uint32_t len);
 static InternalNode* internal_node_clone(vm_t *vm, const InternalNode *original);
@@ -103,6 +111,10 @@ static inline RRBSizeTable* size_table_inc(vm_t *vm, const RRBSizeTable *origina
 static RRB* rrb_head_clone(vm_t *vm, const RRB* original) {
   RRB *clone = owl_alloc(vm, sizeof(RRB));
   memcpy(clone, original, sizeof(RRB));
+  // Clones are persistent, even when made from a builder, and are about to get
+  // elements of their own
+  clone->owner = 0;
+  clone->hashed = false;
   return clone;
 }
 
@@ -149,6 +161,7 @@ const RRB* rrb_concat(vm_t *vm, const RRB *left, const RRB *right) {
         const uint32_t right_cut = RRB_BRANCHING - left->tail_len;
         memcpy(&push_down->child[left->tail_len], &right->tail->child[0],
                right_cut * sizeof(void *));
+        push_down->flags = leaf_flags(left->tail) & right->tail->flags;
 
         // this will be strictly positive.
         const uint32_t new_tail_len = right->tail_len - right_cut;
@@ -156,6 +169,7 @@ const RRB* rrb_concat(vm_t *vm, const RRB *left, const RRB *right) {
 
         memcpy(&new_tail->child[0], &right->tail->child[right_cut],
                new_tail_len * sizeof(void *));
+        new_tail->flags = right->tail->flags;
 
         new_rrb->tail = push_down;
         new_rrb->tail_len = new_tail_len;
@@ -273,15 +287,23 @@ static LeafNode* leaf_node_dec(vm_t *vm, const LeafNode *original) {
 static LeafNode* leaf_node_create(vm_t *vm, uint32_t len) {
   LeafNode *node = owl_alloc(vm, sizeof(LeafNode) + len * sizeof(void *));
   node->type = LEAF_NODE;
+  node->flags = 0;
   node->len = len;
   return node;
 }
 
+// Flags of `leaf` that still hold if ints are added to it. An empty leaf holds
+// nothing but ints, whatever its flags say.
+static inline uint8_t leaf_flags(const LeafNode *leaf) {
+  return leaf->len == 0 ? LEAF_INTS : leaf->flags;
+}
+
 static LeafNode* leaf_node_merge(vm_t *vm, LeafNode *left, LeafNode *right) {
   LeafNode *merged = leaf_node_create(vm, left->len + right->len);
 
   memcpy(&merged->child[0], left->child, left->len * sizeof(void *));
   memcpy(&merged->child[left->len], right->child, right->len * sizeof(void *));
+  merged->flags = leaf_flags(left) & leaf_flags(right);
   return merged;
 }
 
@@ -468,6 +490,7 @@ static InternalNode* execute_concat_plan(vm_t *vm, InternalNode *all, uint32_t *
       }
       else {
         LeafNode *new_node = leaf_node_create(vm, new_size);
+        new_node->flags = LEAF_INTS;
         uint32_t cur_size = 0;
         // cur_size is the current size of the new node
         // (the amount of elements copied into it so far)
@@ -476,6 +499,7 @@ static InternalNode* execute_concat_plan(vm_t *vm, InternalNode *all, uint32_t *
           // the commented out check is verified by create_concat_plan --
           // otherwise the implementation is erroneous!
           const LeafNode *old_node = (LeafNode *) all->child[idx];
+          new_node->flags &= old_node->flags;
 
           if (new_size - cur_size >= old_node->len - offset) {
             // if this node can contain all elements not copied in the old node,
@@ -598,6 +622,7 @@ static inline RRB* rrb_tail_push(vm_t *vm, const RRB *restrict rrb, const void *
 
   LeafNode *new_tail = leaf_node_inc(vm, rrb->tail);
 
+  new_tail->flags = leaf_flags(rrb->tail) & INT_FLAG(elt);
   new_tail->child[new_rrb->tail_len] = elt;
   new_rrb->cnt++;
   new_rrb->tail_len++;
@@ -619,6 +644,7 @@ const RRB* rrb_push(vm_t *vm, const RRB *restrict rrb, const void *restrict elt)
   new_rrb->cnt++;
 
   LeafNode *new_tail = leaf_node_create(vm, 1);
+  new_tail->flags = INT_FLAG(elt);
   new_tail->child[0] = elt;
   new_rrb->tail_len = 1;
   RRB* to_return = push_down_tail(vm, rrb, new_rrb, new_tail);
@@ -848,15 +874,18 @@ static const InternalNode* sized(const InternalNode *node, uint32_t *index,
   return (InternalNode *) node->child[is];
 }
 
-void* rrb_nth(const RRB *rrb, uint32_t index) {
-  if (index >= rrb->cnt) {
-    return NULL;
-  }
+/**
+ * Finds the leaf holding the element at `index`, which has to be in bounds, and
+ * sets `leaf_start` to the index of the first element in that leaf.
+ */
+static const LeafNode* rrb_leaf_at(const RRB *rrb, uint32_t index, uint32_t *leaf_start) {
   const uint32_t tail_offset = rrb->cnt - rrb->tail_len;
   if (tail_offset <= index) {
-    return (void*) rrb->tail->child[index - tail_offset];
+    *leaf_start = tail_offset;
+    return rrb->tail;
   }
   else {
+    const uint32_t original_index = index;
     const InternalNode *current = (const InternalNode *) rrb->root;
     for (uint32_t shift = RRB_SHIFT(rrb); shift > 0; shift -= RRB_BITS) {
       if (current->size_table == NULL) {
@@ -867,10 +896,20 @@ void* rrb_nth(const RRB *rrb, uint32_t index) {
         current = sized(current, &index, shift);
       }
     }
-    return (void*) ((const LeafNode *)current)->child[index & RRB_MASK];
+    *leaf_start = original_index - (index & RRB_MASK);
+    return (const LeafNode *) current;
   }
 }
 
+void* rrb_nth(const RRB *rrb, uint32_t index) {
+  if (index >= rrb->cnt) {
+    return NULL;
+  }
+  uint32_t leaf_start;
+  const LeafNode *leaf = rrb_leaf_at(rrb, index, &leaf_start);
+  return (void*) leaf->child[index - leaf_start];
+}
+
 uint32_t rrb_count(const RRB *rrb) {
   return rrb->cnt;
 }
@@ -946,6 +985,7 @@ static RRB* slice_right(vm_t *vm, const RRB *rrb, const uint32_t right) {
       const uint32_t new_tail_len = right - tail_offset;
       LeafNode *new_tail = leaf_node_create(vm, new_tail_len);
       memcpy(new_tail->child, rrb->tail->child, new_tail_len * sizeof(void *));
+      new_tail->flags = rrb->tail->flags;
       new_rrb->cnt = right;
       new_rrb->tail = new_tail;
       new_rrb->tail_len = new_tail_len;
@@ -1059,6 +1099,7 @@ static TreeNode* slice_right_rec(vm_t *vm, uint32_t *total_shift, const TreeNode
     LeafNode *left_vals = leaf_node_create(vm, subidx + 1);
 
     memcpy(left_vals->child, leaf_root->child, (subidx + 1) * sizeof(void *));
+    left_vals->flags = leaf_root->flags;
     *total_shift = shift;
     return (TreeNode *) left_vals;
   }
@@ -1076,6 +1117,7 @@ const RRB* slice_left(vm_t *vm, RRB *rrb, uint32_t left) {
       LeafNode *new_tail = leaf_node_create(vm, remaining);
       memcpy(new_tail->child, &rrb->tail->child[rrb->tail_len - remaining],
              remaining * sizeof(void *));
+      new_tail->flags = rrb->tail->flags;
 
       RRB *new_rrb = rrb_mutable_create(vm);
       new_rrb->cnt = remaining;
@@ -1122,6 +1164,7 @@ const RRB* slice_left(vm_t *vm, RRB *rrb, uint32_t left) {
              rrb->root->len * sizeof(void *));
       memcpy(&new_tail->child[rrb->root->len], &rrb->tail->child[0],
              rrb->tail_len * sizeof(void *));
+      new_tail->flags = rrb->root->flags & leaf_flags(rrb->tail);
       rrb->tail_len = rrb->cnt;
       rrb->root = NULL;
       rrb->tail = new_tail;
@@ -1140,6 +1183,8 @@ const RRB* slice_left(vm_t *vm, RRB *rrb, uint32_t left) {
              tail_cut * sizeof(void *));
       memcpy(&new_tail->child[0], &rrb->tail->child[tail_cut],
              (rrb->tail_len - tail_cut) * sizeof(void *));
+      new_root->flags = rrb->root->flags & rrb->tail->flags;
+      new_tail->flags = rrb->tail->flags;
 
       rrb->tail_len = rrb->tail_len - tail_cut;
       rrb->tail = new_tail;
@@ -1247,6 +1292,7 @@ static TreeNode* slice_left_rec(vm_t *vm, uint32_t *total_shift, const TreeNode
 
     memcpy(right_vals->child, &leaf_root->child[subidx],
            right_vals_len * sizeof(void *));
+    right_vals->flags = leaf_root->flags;
     *total_shift = shift;
 
     return (TreeNode *) right_vals;
@@ -1264,6 +1310,7 @@ const RRB* rrb_update(vm_t *vm, const RRB *restrict rrb, uint32_t index, const v
     if (tail_offset <= index) {
       LeafNode *new_tail = leaf_node_clone(vm, rrb->tail);
       new_tail->child[index - tail_offset] = elt;
+      new_tail->flags &= INT_FLAG(elt);
       new_rrb->tail = new_tail;
       return new_rrb;
     }
@@ -1288,6 +1335,7 @@ const RRB* rrb_update(vm_t *vm, const RRB *restrict rrb, uint32_t index, const v
     leaf = leaf_node_clone(vm, leaf);
     *previous_pointer = (InternalNode *) leaf;
     leaf->child[index & RRB_MASK] = elt;
+    leaf->flags &= INT_FLAG(elt);
     return new_rrb;
   }
   else {
@@ -1315,6 +1363,260 @@ const RRB* rrb_pop(vm_t *vm, const RRB *rrb) {
   }
 }
 
+// TRANSIENT BUILDERS
+//
+// A builder is a list that the functions below are allowed to change in place,
+// in the style of Clojure's transient vectors. Its head carries an owner, and
+// nodes that the builder allocates are marked with that owner in their guid.
+// Only those nodes are ever written to, everything shared with other lists is
+// copied first. A builder has to be used linearly: only the value returned by
+// the last call may be passed to the next one, until it is frozen.
+//
+// Owned nodes are allocated with room to grow, which collectors do not keep
+// when they move a node. The guid therefore includes the number of finished
+// collections, so ownership lapses after each one. Nothing is changed in place
+// while an incremental cycle is running either, as the program is about to
+// switch over to replicas of the objects it has been using.
+
+static inline const void* builder_guid(vm_t *vm, const RRB *rrb) {
+  uint64_t epoch = (uint32_t) (vm->gc->stats.collections + 1);
+  return (const void*) ((uint64_t) rrb->owner << 32 | epoch);
+}
+
+static inline bool builder_owns(vm_t *vm, const RRB *rrb, const void *guid) {
+  return !vm->gc->cycle_active && guid == builder_guid(vm, rrb);
+}
+
+// Owned nodes have room for at least the next power of two of their length, so
+// there is only room for one more child if the length is not a power of two
+static inline bool builder_has_room(uint32_t len) {
+  return (len & (len - 1)) != 0;
+}
+
+// Room for a node that is about to get one more child. Ownership ends with an
+// incremental cycle, so there is no point in leaving more room during one.
+static uint32_t builder_capacity(vm_t *vm, uint32_t len) {
+  if (vm->gc->cycle_active) {
+    return len + 1;
+  }
+
+  uint32_t capacity = 1;
+  while (capacity <= len) {
+    capacity *= 2;
+  }
+  return MIN(capacity, RRB_BRANCHING);
+}
+
+static RRB* builder_head(vm_t *vm, owl_term builder) {
+  RRB *rrb = list_to_rrb(builder);
+
+  if (rrb->owner == 0) {
+    printf("Expected a list builder\n");
+    exit(1);
+  }
+
+  if (vm->gc->cycle_active) {
+    RRB *clone = rrb_head_clone(vm, rrb);
+    clone->owner = rrb->owner;
+    return clone;
+  }
+
+  return rrb;
+}
+
+static LeafNode* builder_tail(vm_t *vm, RRB *rrb) {
+  LeafNode *tail = rrb->tail;
+  if (builder_owns(vm, rrb, tail->guid) && builder_has_room(tail->len)) {
+    return tail;
+  }
+
+  LeafNode *grown = owl_alloc(vm, sizeof(LeafNode) + builder_capacity(vm, tail->len) * sizeof(void *));
+  memcpy(grown, tail, sizeof(LeafNode) + tail->len * sizeof(void *));
+  grown->guid = builder_guid(vm, rrb);
+  rrb->tail = grown;
+  return grown;
+}
+
+static InternalNode* builder_internal(vm_t *vm, const RRB *rrb, InternalNode *node, bool grow) {
+  if (builder_owns(vm, rrb, node->guid) && (!grow || builder_has_room(node->len))) {
+    return node;
+  }
+
+  size_t size = sizeof(InternalNode) + node->len * sizeof(InternalNode *);
+  InternalNode *copy = owl_alloc(vm, sizeof(InternalNode) + builder_capacity(vm, node->len) * sizeof(InternalNode *));
+  memcpy(copy, node, size);
+  copy->guid = builder_guid(vm, rrb);
+  return copy;
+}
+
+static TreeNode* builder_path(vm_t *vm, const RRB *rrb, uint32_t shift, LeafNode *leaf) {
+  if (shift == LEAF_NODE_SHIFT) {
+    return (TreeNode *) leaf;
+  }
+
+  InternalNode *node = internal_node_create(vm, 1);
+  node->guid = builder_guid(vm, rrb);
+  node->child[0] = (InternalNode *) builder_path(vm, rrb, DEC_SHIFT(shift), leaf);
+  return (TreeNode *) node;
+}
+
+static InternalNode* builder_push_leaf(vm_t *vm, const RRB *rrb, InternalNode *node,
+                                       uint32_t shift, uint32_t index, LeafNode *leaf) {
+  const uint32_t child_index = (index >> shift) & RRB_MASK;
+  const bool append = child_index == node->len;
+
+  node = builder_internal(vm, rrb, node, append);
+  if (append) {
+    node->child[child_index] = (InternalNode *) builder_path(vm, rrb, DEC_SHIFT(shift), leaf);
+    node->len++;
+  }
+  else {
+    node->child[child_index] = builder_push_leaf(vm, rrb, node->child[child_index],
+                                                 DEC_SHIFT(shift), index, leaf);
+  }
+  return node;
+}
+
+/**
+ * Moves the full tail of the builder into its tree and puts `new_tail` in its
+ * place. Trees without size tables are filled from the left, so the new leaf
+ * goes at the next index. Relaxed trees are rare for builders and go through
+ * the persistent push instead.
+ */
+static void builder_push_down(vm_t *vm, RRB *rrb, LeafNode *new_tail) {
+  LeafNode *leaf = rrb->tail;
+  const uint32_t index = rrb->cnt - rrb->tail_len;
+  const bool dense = rrb->root == NULL || rrb->root->type == LEAF_NODE ||
+                     ((InternalNode *) rrb->root)->size_table == NULL;
+
+  if (!dense || index % RRB_BRANCHING != 0) {
+    RRB previous;
+    memcpy(&previous, rrb, sizeof(RRB));
+    push_down_tail(vm, &previous, rrb, new_tail);
+  }
+  else if (rrb->root == NULL) {
+    rrb->root = (TreeNode *) leaf;
+    rrb->shift = LEAF_NODE_SHIFT;
+  }
+  else if ((uint64_t) index == (uint64_t) 1 << INC_SHIFT(RRB_SHIFT(rrb))) {
+    InternalNode *root = internal_node_create(vm, 2);
+    root->guid = builder_guid(vm, rrb);
+    root->child[0] = (InternalNode *) rrb->root;
+    root->child[1] = (InternalNode *) builder_path(vm, rrb, RRB_SHIFT(rrb), leaf);
+    rrb->root = (TreeNode *) root;
+    rrb->shift = INC_SHIFT(RRB_SHIFT(rrb));
+  }
+  else {
+    rrb->root = (TreeNode *) builder_push_leaf(vm, rrb, (InternalNode *) rrb->root,
+                                               RRB_SHIFT(rrb), index, leaf);
+  }
+
+  rrb->tail = new_tail;
+  rrb->tail_len = new_tail->len;
+  rrb->cnt += new_tail->len;
+}
+
+// Elements from `index` up to the end of the leaf holding it, or of the list.
+// Sets `n` to how many there are and `flags` to those of the leaf.
+static const owl_term* leaf_run(const RRB *rrb, uint32_t index, uint32_t *n, uint8_t *flags) {
+  uint32_t leaf_start;
+  const LeafNode *leaf = rrb_leaf_at(rrb, index, &leaf_start);
+  *n = MIN(leaf_start + leaf->len, rrb->cnt) - index;
+  *flags = leaf->flags;
+  return (const owl_term *) &leaf->child[index - leaf_start];
+}
+
+// Ints are only ever equal to themselves, so finding one is a matter of
+// comparing words. Nothing else is equal to an int, so finding anything else
+// skips leaves of ints altogether.
+static int64_t list_index_of(const RRB *rrb, owl_term elem) {
+  const bool is_int = owl_tag_of(elem) == INT;
+
+  uint32_t index = 0;
+  while (index < rrb->cnt) {
+    uint32_t n;
+    uint8_t flags;
+    const owl_term *elems = leaf_run(rrb, index, &n, &flags);
+
+    if (is_int) {
+      int64_t found = terms_index_of(elems, n, elem);
+      if (found >= 0) {
+        return index + found;
+      }
+    }
+    else if (!(flags & LEAF_INTS)) {
+      for (uint32_t i = 0; i < n; i++) {
+        if (owl_terms_eq(elems[i], elem)) {
+          return index + i;
+        }
+      }
+    }
+    index += n;
+  }
+
+  return -1;
+}
+
+// SMALL LISTS
+//
+// Some of the rrb_* functions above keep the tail of a list they build on,
+// which no list but the small one itself may do with an inline tail. The
+// public functions below give small lists a tail of their own before handing
+// them to those.
+
+static RRB* small_list_create(vm_t *vm, uint32_t cnt) {
+  RRB *rrb = owl_alloc(vm, sizeof(RRB) + sizeof(LeafNode) + cnt * sizeof(void *));
+  LeafNode *tail = rrb_inline_tail(rrb);
+
+  tail->type = LEAF_NODE;
+  tail->len = cnt;
+  rrb->cnt = cnt;
+  rrb->tail_len = cnt;
+  rrb->tail = tail;
+  return rrb;
+}
+
+// Holds the `n` elements at `elems`, of which there are at most SMALL_LIST_MAX
+static RRB* small_list_from(vm_t *vm, const owl_term *elems, uint32_t n) {
+  RRB *rrb = small_list_create(vm, n);
+
+  memcpy(rrb->tail->child, elems, n * sizeof(owl_term));
+  if (ints_only(elems, n)) {
+    rrb->tail->flags |= LEAF_INTS;
+  }
+  return rrb;
+}
+
+// Copies the elements of `rrb` from `from` up to `to` to `out`
+static void rrb_copy_out(const RRB *rrb, uint32_t from, uint32_t to, owl_term *out) {
+  while (from < to) {
+    uint32_t n;
+    uint8_t flags;
+    const owl_term *elems = leaf_run(rrb, from, &n, &flags);
+
+    n = MIN(n, to - from);
+    memcpy(out, elems, n * sizeof(owl_term));
+    out += n;
+    from += n;
+  }
+}
+
+static RRB* small_list_slice(vm_t *vm, const RRB *rrb, uint32_t from, uint32_t to) {
+  owl_term elems[SMALL_LIST_MAX];
+  rrb_copy_out(rrb, from, to, elems);
+  return small_list_from(vm, elems, to - from);
+}
+
+static RRB* small_list_promote(vm_t *vm, const RRB *small) {
+  RRB *rrb = rrb_head_clone(vm, small);
+  LeafNode *tail = leaf_node_create(vm, small->tail_len);
+
+  memcpy(tail->child, small->tail->child, small->tail_len * sizeof(void *));
+  tail->flags = small->tail->flags;
+  rrb->tail = tail;
+  return rrb;
+}
+
 // PUBLIC API
 
 owl_term owl_list_init() {
@@ -1322,8 +1624,30 @@ owl_term owl_list_init() {
   return rrb_to_list(rrb);
 }
 
+// Holds the `n` elements at `elems`
+owl_term owl_list_from(vm_t *vm, const owl_term *elems, uint32_t n) {
+  if (n == 0) {
+    return owl_list_init();
+  }
+  if (n <= SMALL_LIST_MAX) {
+    return rrb_to_list(small_list_from(vm, elems, n));
+  }
+
+  owl_term builder = owl_list_builder(vm, owl_list_init());
+  builder = owl_list_builder_append(vm, builder, (owl_term *) elems, n);
+  return owl_list_builder_freeze(vm, builder);
+}
+
 owl_term owl_list_push(vm_t *vm, owl_term list, owl_term elem) {
   const RRB *rrb = list_to_rrb(list);
+
+  if (rrb->cnt < SMALL_LIST_MAX) {
+    owl_term elems[SMALL_LIST_MAX];
+    rrb_copy_out(rrb, 0, rrb->cnt, elems);
+    elems[rrb->cnt] = elem;
+    return rrb_to_list(small_list_from(vm, elems, rrb->cnt + 1));
+  }
+
   rrb = rrb_push(vm, rrb, (void*) elem);
   return rrb_to_list(rrb);
 }
@@ -1349,6 +1673,15 @@ owl_term owl_list_slice(vm_t *vm, owl_term list, owl_term from, owl_term to) {
   const RRB *rrb = list_to_rrb(list);
   uint64_t from_int = int_from_owl_int(from);
   uint64_t to_int = int_from_owl_int(to);
+  const uint64_t end = MIN(to_int, rrb->cnt);
+
+  if (from_int >= end) {
+    return owl_list_init();
+  }
+  if (end - from_int <= SMALL_LIST_MAX && end - from_int < rrb->cnt) {
+    return rrb_to_list(small_list_slice(vm, rrb, from_int, end));
+  }
+
   const RRB *sliced = rrb_slice(vm, rrb, from_int, to_int);
 
   return rrb_to_list(sliced);
@@ -1357,19 +1690,42 @@ owl_term owl_list_slice(vm_t *vm, owl_term list, owl_term from, owl_term to) {
 owl_term owl_list_concat(vm_t *vm, owl_term left_list, owl_term right_list) {
   const RRB *left = list_to_rrb(left_list);
   const RRB *right = list_to_rrb(right_list);
+
+  if (left->cnt == 0) {
+    return right_list;
+  }
+  if (right->cnt == 0) {
+    return left_list;
+  }
+
+  if (left->cnt + right->cnt <= SMALL_LIST_MAX) {
+    owl_term elems[SMALL_LIST_MAX];
+    rrb_copy_out(left, 0, left->cnt, elems);
+    rrb_copy_out(right, 0, right->cnt, elems + left->cnt);
+    return rrb_to_list(small_list_from(vm, elems, left->cnt + right->cnt));
+  }
+
+  // The tail of the right list is kept if the left one's is full, the tail of
+  // the left one goes into the tree if the right one has a tree
+  if (rrb_is_small(right) && left->tail_len == RRB_BRANCHING) {
+    right = small_list_promote(vm, right);
+  }
+  if (rrb_is_small(left) && right->root != NULL) {
+    left = small_list_promote(vm, left);
+  }
+
   const RRB *result = rrb_concat(vm, left, right);
   return rrb_to_list(result);
 }
 
 void owl_list_print(vm_t *vm, owl_term list) {
-  const RRB *rrb = list_to_rrb(list);
-
-  uint32_t count = rrb_count(rrb);
+  ListCursor cursor;
+  list_cursor_init(&cursor, list);
 
   printf("[");
-  for (uint32_t i = 0; i < count; i++) {
-    owl_term_print(vm, (owl_term) rrb_nth(rrb, i));
-    if (i != count - 1) {
+  while (list_cursor_has_next(&cursor)) {
+    owl_term_print(vm, list_cursor_next(&cursor));
+    if (list_cursor_has_next(&cursor)) {
       printf(",");
     }
   }
@@ -1389,12 +1745,610 @@ bool owl_list_eq(owl_term left_list, owl_term right_list) {
 
   if (left_count != right_count) return false;
 
-  for (uint32_t i = 0; i < left_count; i++) {
-    owl_term left_elem  = (owl_term) rrb_nth(left, i);
-    owl_term right_elem = (owl_term) rrb_nth(right, i);
+  uint64_t left_hash, right_hash;
+  if (owl_list_cached_hash(left_list, &left_hash) && owl_list_cached_hash(right_list, &right_hash) &&
+      left_hash != right_hash) {
+    return false;
+  }
 
-    if (!owl_terms_eq(left_elem, right_elem)) return false;
+  // Goes as far as both leaves reach at a time
+  uint32_t index = 0;
+  while (index < left_count) {
+    uint32_t left_n, right_n;
+    uint8_t left_flags, right_flags;
+    const owl_term *left_elems = leaf_run(left, index, &left_n, &left_flags);
+    const owl_term *right_elems = leaf_run(right, index, &right_n, &right_flags);
+    const uint32_t n = MIN(left_n, right_n);
+
+    if (left_flags & right_flags & LEAF_INTS) {
+      if (!terms_identical(left_elems, right_elems, n)) return false;
+    }
+    else {
+      for (uint32_t i = 0; i < n; i++) {
+        if (!owl_terms_eq(left_elems[i], right_elems[i])) return false;
+      }
+    }
+    index += n;
   }
 
   return true;
 }
+
+// owl_term_hash keeps the hash of a list in its head once it has worked it out,
+// so that lists used as map keys, or compared over and over, are only gone
+// through once. Builders change in place and the empty list is read-only, so
+// neither keeps one. Threads running List.pmap may hash the same list at once:
+// they all write the same hash, and set the flag only after it.
+
+bool owl_list_cached_hash(owl_term list, uint64_t *hash) {
+  const RRB *rrb = list_to_rrb(list);
+
+  if (!__atomic_load_n(&rrb->hashed, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+  *hash = rrb->hash;
+  return true;
+}
+
+void owl_list_cache_hash(owl_term list, uint64_t hash) {
+  RRB *rrb = list_to_rrb(list);
+
+  if (rrb->cnt == 0 || rrb->owner != 0) {
+    return;
+  }
+  rrb->hash = hash;
+  __atomic_store_n(&rrb->hashed, true, __ATOMIC_RELEASE);
+}
+
+// Starts a builder with the elements of `list`, which stays as it is
+owl_term owl_list_builder(vm_t *vm, owl_term list) {
+  const RRB *source = list_to_rrb(list);
+  RRB *rrb = rrb_head_clone(vm, source);
+
+  vm->list_builders++;
+  if (vm->list_builders == 0) {
+    vm->list_builders++;
+  }
+  rrb->owner = vm->list_builders;
+
+  // The builder takes a tail of its own right away rather than keeping the
+  // inline one
+  if (rrb_is_small(source)) {
+    builder_tail(vm, rrb);
+  }
+
+  return rrb_to_list(rrb);
+}
+
+owl_term owl_list_builder_push(vm_t *vm, owl_term builder, owl_term elem) {
+  RRB *rrb = builder_head(vm, builder);
+
+  if (rrb->tail_len == RRB_BRANCHING) {
+    // The new tail grows by doubling like any other owned node
+    LeafNode *tail = owl_alloc(vm, sizeof(LeafNode) + builder_capacity(vm, 0) * sizeof(void *));
+    tail->type = LEAF_NODE;
+    tail->flags = INT_FLAG(elem);
+    tail->len = 1;
+    tail->guid = builder_guid(vm, rrb);
+    tail->child[0] = (void*) elem;
+    builder_push_down(vm, rrb, tail);
+  }
+  else {
+    LeafNode *tail = builder_tail(vm, rrb);
+    tail->flags = leaf_flags(tail) & INT_FLAG(elem);
+    tail->child[tail->len++] = (void*) elem;
+    rrb->tail_len++;
+    rrb->cnt++;
+  }
+
+  return rrb_to_list(rrb);
+}
+
+// Appends `n` elements at once, allocating every node at its final size
+owl_term owl_list_builder_append(vm_t *vm, owl_term builder, owl_term *elems, uint32_t n) {
+  RRB *rrb = builder_head(vm, builder);
+
+  while (n > 0) {
+    if (rrb->tail_len == RRB_BRANCHING) {
+      const uint32_t take = MIN(n, RRB_BRANCHING);
+      LeafNode *leaf = leaf_node_create(vm, take);
+      memcpy(leaf->child, elems, take * sizeof(void *));
+      leaf->flags = ints_only(elems, take) ? LEAF_INTS : 0;
+      builder_push_down(vm, rrb, leaf);
+      elems += take;
+      n -= take;
+    }
+    else {
+      const uint32_t take = MIN(n, RRB_BRANCHING - (uint32_t) rrb->tail_len);
+      LeafNode *tail = leaf_node_create(vm, rrb->tail_len + take);
+      memcpy(tail->child, rrb->tail->child, rrb->tail_len * sizeof(void *));
+      memcpy(&tail->child[rrb->tail_len], elems, take * sizeof(void *));
+      tail->flags = ints_only(elems, take) ? leaf_flags(rrb->tail) : 0;
+      rrb->tail = tail;
+      rrb->tail_len += take;
+      rrb->cnt += take;
+      elems += take;
+      n -= take;
+    }
+  }
+
+  return rrb_to_list(rrb);
+}
+
+owl_term owl_list_builder_freeze(vm_t *vm, owl_term builder) {
+  RRB *rrb = builder_head(vm, builder);
+
+  if (rrb->cnt == 0) {
+    return owl_list_init();
+  }
+
+  rrb->owner = 0;
+  if (rrb->cnt <= SMALL_LIST_MAX) {
+    return rrb_to_list(small_list_slice(vm, rrb, 0, rrb->cnt));
+  }
+  return rrb_to_list(rrb);
+}
+
+// CURSORS
+
+void list_cursor_init(ListCursor *cursor, owl_term list) {
+  cursor->rrb = list_to_rrb(list);
+  cursor->leaf = NULL;
+  cursor->index = 0;
+  cursor->leaf_start = 0;
+}
+
+// Only looks the leaf up in the tree when the previous one is used up
+owl_term list_cursor_next(ListCursor *cursor) {
+  if (cursor->leaf == NULL || cursor->index - cursor->leaf_start >= cursor->leaf->len) {
+    cursor->leaf = rrb_leaf_at(cursor->rrb, cursor->index, &cursor->leaf_start);
+  }
+
+  return (owl_term) cursor->leaf->child[cursor->index++ - cursor->leaf_start];
+}
+
+// HIGHER-ORDER FUNCTIONS
+//
+// Walk the leaves of a list with a ListCursor and call back into Owl for each
+// element. Callbacks can run the collector, so everything that is needed after
+// one is rooted, and the walk is picked up from the list's new location once a
+// collection has finished.
+
+static void cursor_follow(vm_t *vm, ListCursor *cursor, const owl_term *list, uint64_t *epoch) {
+  if (vm->gc->stats.collections != *epoch) {
+    *epoch = vm->gc->stats.collections;
+    cursor->rrb = list_to_rrb(*list);
+    cursor->leaf = NULL;
+  }
+}
+
+// Maps the elements from index `from` up to `to`
+static owl_term map_range(vm_t *vm, owl_term list, owl_term function, uint32_t from, uint32_t to) {
+  owl_term *source = vm_root(vm, list);
+  owl_term *fun = vm_root(vm, function);
+  owl_term *builder = vm_root(vm, owl_list_builder(vm, owl_list_init()));
+
+  ListCursor cursor;
+  list_cursor_init(&cursor, list);
+  cursor.index = from;
+  uint64_t epoch = vm->gc->stats.collections;
+
+  while (cursor.index < to) {
+    owl_term elem = list_cursor_next(&cursor);
+    owl_term result = vm_call(vm, *fun, 1, &elem);
+    vm_root_set(vm, builder, owl_list_builder_push(vm, *builder, result));
+    cursor_follow(vm, &cursor, source, &epoch);
+  }
+
+  owl_term mapped = owl_list_builder_freeze(vm, *builder);
+  vm_unroot(vm, 3);
+  return mapped;
+}
+
+owl_term owl_list_map(vm_t *vm, owl_term list, owl_term function) {
+  return map_range(vm, list, function, 0, list_to_rrb(list)->cnt);
+}
+
+owl_term owl_list_filter(vm_t *vm, owl_term list, owl_term predicate) {
+  owl_term *source = vm_root(vm, list);
+  owl_term *fun = vm_root(vm, predicate);
+  owl_term *builder = vm_root(vm, owl_list_builder(vm, owl_list_init()));
+  owl_term *elem = vm_root(vm, OWL_NIL);
+
+  ListCursor cursor;
+  list_cursor_init(&cursor, list);
+  uint64_t epoch = vm->gc->stats.collections;
+
+  while (list_cursor_has_next(&cursor)) {
+    vm_root_set(vm, elem, list_cursor_next(&cursor));
+    if (owl_term_truthy(vm_call(vm, *fun, 1, elem))) {
+      vm_root_set(vm, builder, owl_list_builder_push(vm, *builder, *elem));
+    }
+    cursor_follow(vm, &cursor, source, &epoch);
+  }
+
+  owl_term filtered = owl_list_builder_freeze(vm, *builder);
+  vm_unroot(vm, 4);
+  return filtered;
+}
+
+static owl_term reduce_range(vm_t *vm, owl_term list, owl_term initial, owl_term function, uint32_t from, uint32_t to) {
+  owl_term *source = vm_root(vm, list);
+  owl_term *fun = vm_root(vm, function);
+  owl_term *acc = vm_root(vm, initial);
+
+  ListCursor cursor;
+  list_cursor_init(&cursor, list);
+  cursor.index = from;
+  uint64_t epoch = vm->gc->stats.collections;
+
+  while (cursor.index < to) {
+    owl_term args[2] = {*acc, list_cursor_next(&cursor)};
+    vm_root_set(vm, acc, vm_call(vm, *fun, 2, args));
+    cursor_follow(vm, &cursor, source, &epoch);
+  }
+
+  owl_term result = *acc;
+  vm_unroot(vm, 3);
+  return result;
+}
+
+owl_term owl_list_reduce(vm_t *vm, owl_term list, owl_term initial, owl_term function) {
+  return reduce_range(vm, list, initial, function, 0, list_to_rrb(list)->cnt);
+}
+
+owl_term owl_list_each(vm_t *vm, owl_term list, owl_term function) {
+  owl_term *source = vm_root(vm, list);
+  owl_term *fun = vm_root(vm, function);
+
+  ListCursor cursor;
+  list_cursor_init(&cursor, list);
+  uint64_t epoch = vm->gc->stats.collections;
+
+  while (list_cursor_has_next(&cursor)) {
+    owl_term elem = list_cursor_next(&cursor);
+    vm_call(vm, *fun, 1, &elem);
+    cursor_follow(vm, &cursor, source, &epoch);
+  }
+
+  vm_unroot(vm, 2);
+  return OWL_NIL;
+}
+
+// Returns the first element that `predicate` holds for, or nil if there is none
+owl_term owl_list_find(vm_t *vm, owl_term list, owl_term predicate) {
+  owl_term *source = vm_root(vm, list);
+  owl_term *fun = vm_root(vm, predicate);
+  owl_term *elem = vm_root(vm, OWL_NIL);
+
+  ListCursor cursor;
+  list_cursor_init(&cursor, list);
+  uint64_t epoch = vm->gc->stats.collections;
+  owl_term found = OWL_NIL;
+
+  while (list_cursor_has_next(&cursor)) {
+    vm_root_set(vm, elem, list_cursor_next(&cursor));
+    if (owl_term_truthy(vm_call(vm, *fun, 1, elem))) {
+      found = *elem;
+      break;
+    }
+    cursor_follow(vm, &cursor, source, &epoch);
+  }
+
+  vm_unroot(vm, 3);
+  return found;
+}
+
+bool owl_list_contains(owl_term list, owl_term elem) {
+  return list_index_of(list_to_rrb(list), elem) >= 0;
+}
+
+// Copies the list a leaf at a time, starting from the back
+owl_term owl_list_reverse(vm_t *vm, owl_term list) {
+  const RRB *rrb = list_to_rrb(list);
+  owl_term builder = owl_list_builder(vm, owl_list_init());
+  owl_term chunk[RRB_BRANCHING];
+
+  uint32_t end = rrb->cnt;
+  while (end > 0) {
+    uint32_t leaf_start;
+    const LeafNode *leaf = rrb_leaf_at(rrb, end - 1, &leaf_start);
+    const uint32_t n = end - leaf_start;
+
+    for (uint32_t i = 0; i < n; i++) {
+      chunk[i] = (owl_term) leaf->child[n - 1 - i];
+    }
+    builder = owl_list_builder_append(vm, builder, chunk, n);
+    end = leaf_start;
+  }
+
+  return owl_list_builder_freeze(vm, builder);
+}
+
+// SORTING
+//
+// The elements are copied out a leaf at a time, sorted by util/term_sort.c and
+// appended to a builder in their new order.
+
+// Sets the key, or the term, of each of `items` to the elements of `list`
+static void items_from_list(SortItem *items, const RRB *rrb, bool keys) {
+  uint32_t index = 0;
+  while (index < rrb->cnt) {
+    uint32_t n;
+    uint8_t flags;
+    const owl_term *elems = leaf_run(rrb, index, &n, &flags);
+
+    for (uint32_t i = 0; i < n; i++) {
+      if (keys) {
+        items[index + i].key = elems[i];
+      } else {
+        items[index + i].term = elems[i];
+      }
+    }
+    index += n;
+  }
+}
+
+// The elements of `list` in the order of `keys`, which has the key of every
+// element at the same index
+static owl_term sort_by_keys(vm_t *vm, owl_term list, owl_term keys) {
+  const RRB *rrb = list_to_rrb(list);
+  const uint32_t n = rrb->cnt;
+
+  if (n < 2) {
+    return list;
+  }
+
+  SortItem *items = malloc(n * sizeof(SortItem));
+  items_from_list(items, rrb, false);
+  items_from_list(items, list_to_rrb(keys), true);
+  items_sort(items, n);
+
+  // Terms are half the size of items, so they can be gathered in place
+  owl_term *sorted = (owl_term *) items;
+  for (uint32_t i = 0; i < n; i++) {
+    sorted[i] = items[i].term;
+  }
+
+  owl_term builder = owl_list_builder(vm, owl_list_init());
+  builder = owl_list_builder_append(vm, builder, sorted, n);
+  free(items);
+  return owl_list_builder_freeze(vm, builder);
+}
+
+owl_term owl_list_sort(vm_t *vm, owl_term list) {
+  return sort_by_keys(vm, list, list);
+}
+
+// Calls `function` once for every element, and sorts them by what it returns
+owl_term owl_list_sort_by(vm_t *vm, owl_term list, owl_term function) {
+  owl_term *source = vm_root(vm, list);
+  owl_term keys = owl_list_map(vm, list, function);
+
+  list = *source;
+  vm_unroot(vm, 1);
+  return sort_by_keys(vm, list, keys);
+}
+
+// NUMERIC FUNCTIONS
+//
+// These go through a list a leaf at a time. Leaves marked LEAF_INTS are handed
+// to the kernels in util/int_kernels.c as they are, any other leaf is checked
+// element by element first.
+
+static void expect_ints(const owl_term *elems, uint32_t n, uint8_t flags) {
+  if (flags & LEAF_INTS) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < n; i++) {
+    if (owl_tag_of(elems[i]) != INT) {
+      printf("TypeError: expected Int, got %s\n", owl_type_name(elems[i]));
+      exit(1);
+    }
+  }
+}
+
+// Adds up the ints in `list`, wrapping around like + does
+owl_term owl_list_sum(owl_term list) {
+  const RRB *rrb = list_to_rrb(list);
+  uint64_t sum = 0;
+
+  uint32_t index = 0;
+  while (index < rrb->cnt) {
+    uint32_t n;
+    uint8_t flags;
+    const owl_term *elems = leaf_run(rrb, index, &n, &flags);
+    expect_ints(elems, n, flags);
+    sum += ints_sum(elems, n);
+    index += n;
+  }
+
+  return owl_int_from(sum);
+}
+
+static owl_term list_extreme(owl_term list, bool max) {
+  const RRB *rrb = list_to_rrb(list);
+  if (rrb->cnt == 0) {
+    return OWL_NIL;
+  }
+
+  owl_term best = 0;
+  uint32_t index = 0;
+  while (index < rrb->cnt) {
+    uint32_t n;
+    uint8_t flags;
+    const owl_term *elems = leaf_run(rrb, index, &n, &flags);
+    expect_ints(elems, n, flags);
+
+    owl_term found = max ? ints_max(elems, n) : ints_min(elems, n);
+    if (index == 0 || (max ? found > best : found < best)) {
+      best = found;
+    }
+    index += n;
+  }
+
+  return best;
+}
+
+// Largest int in `list`, or nil if it is empty
+owl_term owl_list_max(owl_term list) {
+  return list_extreme(list, true);
+}
+
+// Smallest int in `list`, or nil if it is empty
+owl_term owl_list_min(owl_term list) {
+  return list_extreme(list, false);
+}
+
+// Index of the first element equal to `elem`, or nil if there is none
+owl_term owl_list_index_of(owl_term list, owl_term elem) {
+  int64_t index = list_index_of(list_to_rrb(list), elem);
+  return index >= 0 ? owl_int_from(index) : OWL_NIL;
+}
+
+// PARALLEL FUNCTIONS
+//
+// The list is cut into chunks along the boundaries of its subtrees, each of them
+// is mapped or reduced as a task of its own, see parallel.c, and the results
+// are joined back together in order. Without workers to run them on, the whole
+// list is mapped or reduced at once instead.
+
+#define CHUNKS_PER_THREAD 4            // Leaves threads that finish early something to pick up
+
+typedef struct ListChunks {
+  owl_term *list;                      // Rooted, read through here after anything that can collect
+  owl_term *function;
+  owl_term *identity;
+  uint32_t *bounds;                    // Chunk i covers the elements from bounds[i] up to bounds[i + 1]
+  uint32_t n;
+} ListChunks;
+
+// Adds the subtrees under `node` to the last chunk, starting a new one once it
+// holds at least `target` elements. Subtrees larger than that are split up
+// further. Returns the index following the last element under `node`.
+static uint32_t split_subtrees(ListChunks *chunks, const TreeNode *node, uint32_t shift,
+                               uint32_t start, uint32_t target) {
+  const uint32_t size = size_sub_trie((TreeNode *) node, shift);
+
+  if (shift == LEAF_NODE_SHIFT || size <= target) {
+    const uint32_t end = start + size;
+    if (end - chunks->bounds[chunks->n] >= target) {
+      chunks->bounds[++chunks->n] = end;
+    }
+    return end;
+  }
+
+  const InternalNode *internal = (const InternalNode *) node;
+  for (uint32_t i = 0; i < internal->len; i++) {
+    start = split_subtrees(chunks, (TreeNode *) internal->child[i], DEC_SHIFT(shift), start, target);
+  }
+  return start;
+}
+
+// Every chunk but the last holds at least `target` elements, so there are no
+// more than cnt / target + 1 of them
+static void split_list(vm_t *vm, ListChunks *chunks) {
+  const RRB *rrb = list_to_rrb(*chunks->list);
+  const uint32_t target = MAX(rrb->cnt / (vm->threads * CHUNKS_PER_THREAD), RRB_BRANCHING);
+
+  chunks->bounds = malloc((rrb->cnt / target + 2) * sizeof(uint32_t));
+  chunks->bounds[0] = 0;
+  chunks->n = 0;
+
+  if (rrb->cnt > rrb->tail_len) {
+    split_subtrees(chunks, rrb->root, RRB_SHIFT(rrb), 0, target);
+  }
+  // The tail goes along with the last subtrees
+  if (chunks->bounds[chunks->n] < rrb->cnt) {
+    chunks->bounds[++chunks->n] = rrb->cnt;
+  }
+}
+
+static owl_term map_chunk(vm_t *vm, uint32_t index, void *context) {
+  ListChunks *chunks = context;
+  return map_range(vm, *chunks->list, *chunks->function, chunks->bounds[index], chunks->bounds[index + 1]);
+}
+
+static owl_term reduce_chunk(vm_t *vm, uint32_t index, void *context) {
+  ListChunks *chunks = context;
+  return reduce_range(vm, *chunks->list, *chunks->identity, *chunks->function,
+                      chunks->bounds[index], chunks->bounds[index + 1]);
+}
+
+// Returns the result of every chunk, rooted, for the caller to unroot. Chunks
+// that the workers dropped are run again on this VM.
+static owl_term* run_chunks(vm_t *vm, ListChunks *chunks, parallel_task task) {
+  owl_term *results = vm_root(vm, 0);
+  for (uint32_t i = 1; i < chunks->n; i++) {
+    vm_root(vm, 0);
+  }
+
+  parallel_run(vm, chunks->n, results, task, chunks);
+
+  for (uint32_t i = 0; i < chunks->n; i++) {
+    if (results[i] == 0) {
+      vm_root_set(vm, &results[i], task(vm, i, chunks));
+    }
+  }
+
+  return results;
+}
+
+// Maps the chunks of `list` on as many threads as there are, the same as
+// owl_list_map other than that `function` may be called more than once for an
+// element
+owl_term owl_list_pmap(vm_t *vm, owl_term list, owl_term function) {
+  if (!parallel_available(vm) || rrb_count(list_to_rrb(list)) <= RRB_BRANCHING) {
+    return owl_list_map(vm, list, function);
+  }
+
+  ListChunks chunks;
+  chunks.list = vm_root(vm, list);
+  chunks.function = vm_root(vm, function);
+  gc_safepoint(vm);
+  split_list(vm, &chunks);
+
+  owl_term *results = run_chunks(vm, &chunks, map_chunk);
+
+  // A join may take more than the room a safepoint leaves, so each gets its own
+  // and the list joined so far stays rooted in the first result
+  for (uint32_t i = 1; i < chunks.n; i++) {
+    gc_safepoint(vm);
+    vm_root_set(vm, &results[0], owl_list_concat(vm, results[0], results[i]));
+  }
+  owl_term joined = results[0];
+
+  vm_unroot(vm, chunks.n + 2);
+  free(chunks.bounds);
+  return joined;
+}
+
+// Reduces each chunk of `list` starting from `identity`, then combines the
+// results of the chunks in order with `function` as well. That only adds up to
+// a reduction of the whole list if `function` is associative and `identity`
+// leaves whatever it is combined with as it is, like 0 does for addition.
+owl_term owl_list_preduce(vm_t *vm, owl_term list, owl_term identity, owl_term function) {
+  if (!parallel_available(vm) || rrb_count(list_to_rrb(list)) <= RRB_BRANCHING) {
+    return owl_list_reduce(vm, list, identity, function);
+  }
+
+  ListChunks chunks;
+  chunks.list = vm_root(vm, list);
+  chunks.function = vm_root(vm, function);
+  chunks.identity = vm_root(vm, identity);
+  gc_safepoint(vm);
+  split_list(vm, &chunks);
+
+  owl_term *results = run_chunks(vm, &chunks, reduce_chunk);
+
+  for (uint32_t i = 1; i < chunks.n; i++) {
+    owl_term args[2] = {results[0], results[i]};
+    vm_root_set(vm, &results[0], vm_call(vm, *chunks.function, 2, args));
+  }
+
+  owl_term result = results[0];
+  vm_unroot(vm, chunks.n + 3);
+  free(chunks.bounds);
+  return result;
+}
@@ -21,14 +21,20 @@
 
 typedef enum {LEAF_NODE, INTERNAL_NODE} NodeType;
 
+// Set on leaves that hold nothing but ints. It may be missing from leaves that
+// do, but is never set on any other.
+#define LEAF_INTS 1
+
 typedef struct TreeNode {
-  NodeType type;
+  uint8_t type;                        // A NodeType
+  uint8_t flags;
   uint32_t len;
   GUID_DECLARATION
 } TreeNode;
 
 typedef struct LeafNode {
-  NodeType type;
+  uint8_t type;
+  uint8_t flags;
   uint32_t len;
   GUID_DECLARATION
   const void *child[];
@@ -40,7 +46,8 @@ typedef struct RRBSizeTable {
 } RRBSizeTable;
 
 typedef struct InternalNode {
-  NodeType type;
+  uint8_t type;
+  uint8_t flags;
   uint32_t len;
   GUID_DECLARATION
   RRBSizeTable *size_table;
@@ -50,13 +57,38 @@ typedef struct InternalNode {
 typedef struct RRB {
   uint32_t cnt;
   uint32_t shift;
-  uint32_t tail_len;
+  uint16_t tail_len;
+  bool hashed;                         // Whether `hash` is set, see owl_term_hash
+  uint32_t owner;                      // Non-zero while the list is a builder, see owl_list_builder
   LeafNode *tail;
   TreeNode *root;
+  uint64_t hash;
 } RRB;
 
+// Lists of up to SMALL_LIST_MAX elements are allocated as a single object, the
+// head followed by its tail. Such a tail only ever belongs to the head in front
+// of it, and the collectors move it along with that head. Lists that grow past
+// the limit get a tail of their own.
+#define SMALL_LIST_MAX 8
+
+#define rrb_inline_tail(rrb) ((LeafNode*) ((RRB*) (rrb) + 1))
+#define rrb_is_small(rrb) ((rrb)->tail == rrb_inline_tail(rrb))
+
+// Walks a list in order, looking up each leaf only once
+typedef struct ListCursor {
+  const RRB *rrb;
+  const LeafNode *leaf;
+  uint32_t index;                      // Of the next element
+  uint32_t leaf_start;                 // Index of the first element in `leaf`
+} ListCursor;
+
+#define list_cursor_has_next(cursor) ((cursor)->index < (cursor)->rrb->cnt)
+
+void list_cursor_init(ListCursor *cursor, owl_term list);
+owl_term list_cursor_next(ListCursor *cursor);
 
 owl_term owl_list_init();
+owl_term owl_list_from(vm_t *vm, const owl_term *elems, uint32_t n);
 void owl_list_print(vm_t *vm, owl_term list);
 owl_term owl_list_push(vm_t *vm, owl_term list, owl_term elem);
 owl_term owl_list_nth(owl_term list, owl_term index);
@@ -64,6 +96,27 @@ owl_term owl_list_count(owl_term list);
 owl_term owl_list_slice(vm_t *vm, owl_term list, owl_term from, owl_term to);
 owl_term owl_list_concat(vm_t *vm, owl_term left, owl_term right);
 bool owl_list_eq(owl_term left, owl_term right);
+bool owl_list_cached_hash(owl_term list, uint64_t *hash);
+void owl_list_cache_hash(owl_term list, uint64_t hash);
 bool owl_list_is_empty(owl_term list);
+owl_term owl_list_builder(vm_t *vm, owl_term list);
+owl_term owl_list_builder_push(vm_t *vm, owl_term builder, owl_term elem);
+owl_term owl_list_builder_append(vm_t *vm, owl_term builder, owl_term *elems, uint32_t n);
+owl_term owl_list_builder_freeze(vm_t *vm, owl_term builder);
+owl_term owl_list_map(vm_t *vm, owl_term list, owl_term function);
+owl_term owl_list_filter(vm_t *vm, owl_term list, owl_term predicate);
+owl_term owl_list_reduce(vm_t *vm, owl_term list, owl_term initial, owl_term function);
+owl_term owl_list_each(vm_t *vm, owl_term list, owl_term function);
+owl_term owl_list_find(vm_t *vm, owl_term list, owl_term predicate);
+bool owl_list_contains(owl_term list, owl_term elem);
+owl_term owl_list_reverse(vm_t *vm, owl_term list);
+owl_term owl_list_sort(vm_t *vm, owl_term list);
+owl_term owl_list_sort_by(vm_t *vm, owl_term list, owl_term function);
+owl_term owl_list_sum(owl_term list);
+owl_term owl_list_max(owl_term list);
+owl_term owl_list_min(owl_term list);
+owl_term owl_list_index_of(owl_term list, owl_term elem);
+owl_term owl_list_pmap(vm_t *vm, owl_term list, owl_term function);
+owl_term owl_list_preduce(vm_t *vm, owl_term list, owl_term identity, owl_term function);
 
 #endif  // OWL_LIST_H
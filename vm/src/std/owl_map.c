@@ -0,0 +1,670 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "term.h"
+#include "alloc.h"
+#include "std/owl_map.h"
+#include "std/owl_list.h"
+
+#define MAP_BITS 5
+#define MAP_MASK ((1U << MAP_BITS) - 1)
+#define MAP_MAX_SHIFT 60                 // Last level that has hash bits left to go by
+
+#define SUBNODE 0                        // Key of a slot that refers to a node
+
+static const MapNode EMPTY_MAP = {.bitmap = 0, .len = 0, .count = 0, .collision = false, .set = false};
+static const MapNode EMPTY_SET = {.bitmap = 0, .len = 0, .count = 0, .collision = false, .set = true};
+
+static inline uint32_t slot_bit(uint64_t hash, uint32_t shift) {
+  return 1U << ((hash >> shift) & MAP_MASK);
+}
+
+// Position among the slots in use of the slot for `bit`
+static inline uint32_t slot_index(const MapNode *node, uint32_t bit) {
+  return __builtin_popcount(node->bitmap & (bit - 1));
+}
+
+static void expect_map(owl_term term) {
+  if (owl_tag_of(term) != MAP || map_to_node(term)->set) {
+    printf("TypeError: expected Map, got %s\n", owl_type_name(term));
+    exit(1);
+  }
+}
+
+static void expect_set(owl_term term) {
+  if (owl_tag_of(term) != MAP || !map_to_node(term)->set) {
+    printf("TypeError: expected Set, got %s\n", owl_type_name(term));
+    exit(1);
+  }
+}
+
+// NODES
+
+static MapNode* node_create(vm_t *vm, uint32_t len) {
+  MapNode *node = owl_alloc(vm, map_node_size(len));
+  node->len = len;
+  return node;
+}
+
+static MapNode* node_clone(vm_t *vm, const MapNode *original) {
+  MapNode *node = owl_alloc(vm, map_node_size(original->len));
+  memcpy(node, original, map_node_size(original->len));
+  node->hashed = false;
+  return node;
+}
+
+// Copy of `node` with the slot at `index` set to `key` and `value`
+static MapNode* node_set(vm_t *vm, const MapNode *node, uint32_t index, owl_term key, owl_term value, uint32_t count) {
+  MapNode *copy = node_clone(vm, node);
+  copy->slots[index * 2] = key;
+  copy->slots[index * 2 + 1] = value;
+  copy->count = count;
+  return copy;
+}
+
+// Copy of `node` with a new slot for `bit` at `index`, or a new entry at the
+// end of a collision node
+static MapNode* node_insert(vm_t *vm, const MapNode *node, uint32_t index, uint32_t bit, owl_term key, owl_term value) {
+  MapNode *copy = node_create(vm, node->len + 1);
+
+  memcpy(copy->slots, node->slots, index * 2 * sizeof(owl_term));
+  copy->slots[index * 2] = key;
+  copy->slots[index * 2 + 1] = value;
+  memcpy(&copy->slots[(index + 1) * 2], &node->slots[index * 2], (node->len - index) * 2 * sizeof(owl_term));
+  copy->bitmap = node->bitmap | bit;
+  copy->count = node->count + 1;
+  copy->collision = node->collision;
+  copy->set = node->set;
+  return copy;
+}
+
+// Copy of `node` without the slot at `index`, which holds a single entry
+static MapNode* node_delete(vm_t *vm, const MapNode *node, uint32_t index, uint32_t bit) {
+  MapNode *copy = node_create(vm, node->len - 1);
+
+  memcpy(copy->slots, node->slots, index * 2 * sizeof(owl_term));
+  memcpy(&copy->slots[index * 2], &node->slots[(index + 1) * 2], (node->len - index - 1) * 2 * sizeof(owl_term));
+  copy->bitmap = node->bitmap & ~bit;
+  copy->count = node->count - 1;
+  copy->collision = node->collision;
+  copy->set = node->set;
+  return copy;
+}
+
+// Node at level `shift` holding two entries whose keys shared a slot one level up
+static MapNode* node_pair(vm_t *vm, uint32_t shift,
+                          owl_term key1, owl_term value1, uint64_t hash1,
+                          owl_term key2, owl_term value2, uint64_t hash2) {
+  if (shift > MAP_MAX_SHIFT) {
+    MapNode *node = node_create(vm, 2);
+    node->slots[0] = key1;
+    node->slots[1] = value1;
+    node->slots[2] = key2;
+    node->slots[3] = value2;
+    node->count = 2;
+    node->collision = true;
+    return node;
+  }
+
+  uint32_t bit1 = slot_bit(hash1, shift);
+  uint32_t bit2 = slot_bit(hash2, shift);
+
+  if (bit1 == bit2) {
+    MapNode *child = node_pair(vm, shift + MAP_BITS, key1, value1, hash1, key2, value2, hash2);
+    MapNode *node = node_create(vm, 1);
+    node->slots[0] = SUBNODE;
+    node->slots[1] = owl_map_from(child);
+    node->bitmap = bit1;
+    node->count = 2;
+    return node;
+  }
+
+  MapNode *node = node_create(vm, 2);
+  uint32_t first = bit1 < bit2 ? 0 : 1;
+  node->slots[first * 2] = key1;
+  node->slots[first * 2 + 1] = value1;
+  node->slots[(1 - first) * 2] = key2;
+  node->slots[(1 - first) * 2 + 1] = value2;
+  node->bitmap = bit1 | bit2;
+  node->count = 2;
+  return node;
+}
+
+// Index of the entry for `key` in a collision node, or -1
+static int64_t collision_find(const MapNode *node, owl_term key) {
+  for (uint32_t i = 0; i < node->len; i++) {
+    if (owl_terms_eq(node->slots[i * 2], key)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Slot holding the value for `key` under `node`, which is at level `shift`, or NULL
+static const owl_term* node_find(const MapNode *node, uint32_t shift, uint64_t hash, owl_term key) {
+  for (;;) {
+    if (node->collision) {
+      int64_t index = collision_find(node, key);
+      return index < 0 ? NULL : &node->slots[index * 2 + 1];
+    }
+
+    uint32_t bit = slot_bit(hash, shift);
+    if (!(node->bitmap & bit)) {
+      return NULL;
+    }
+
+    const owl_term *slot = &node->slots[slot_index(node, bit) * 2];
+    if (slot[0] != SUBNODE) {
+      return owl_terms_eq(slot[0], key) ? &slot[1] : NULL;
+    }
+
+    node = map_to_node(slot[1]);
+    shift += MAP_BITS;
+  }
+}
+
+// Returns `node` itself if it maps `key` to `value` already
+static const MapNode* node_put(vm_t *vm, const MapNode *node, uint32_t shift, uint64_t hash, owl_term key, owl_term value) {
+  if (node->collision) {
+    int64_t index = collision_find(node, key);
+    if (index < 0) {
+      return node_insert(vm, node, node->len, 0, key, value);
+    }
+    if (node->slots[index * 2 + 1] == value) {
+      return node;
+    }
+    return node_set(vm, node, index, node->slots[index * 2], value, node->count);
+  }
+
+  uint32_t bit = slot_bit(hash, shift);
+  uint32_t index = slot_index(node, bit);
+
+  if (!(node->bitmap & bit)) {
+    return node_insert(vm, node, index, bit, key, value);
+  }
+
+  const owl_term *slot = &node->slots[index * 2];
+
+  if (slot[0] == SUBNODE) {
+    const MapNode *child = map_to_node(slot[1]);
+    const MapNode *updated = node_put(vm, child, shift + MAP_BITS, hash, key, value);
+    if (updated == child) {
+      return node;
+    }
+    return node_set(vm, node, index, SUBNODE, owl_map_from(updated), node->count - child->count + updated->count);
+  }
+
+  if (owl_terms_eq(slot[0], key)) {
+    if (slot[1] == value) {
+      return node;
+    }
+    return node_set(vm, node, index, slot[0], value, node->count);
+  }
+
+  MapNode *pair = node_pair(vm, shift + MAP_BITS, slot[0], slot[1], owl_term_hash(slot[0]), key, value, hash);
+  return node_set(vm, node, index, SUBNODE, owl_map_from(pair), node->count + 1);
+}
+
+// Returns `node` itself if `key` is not in it, or NULL if nothing would be left
+static const MapNode* node_remove(vm_t *vm, const MapNode *node, uint32_t shift, uint64_t hash, owl_term key) {
+  if (node->collision) {
+    int64_t index = collision_find(node, key);
+    if (index < 0) {
+      return node;
+    }
+    return node->len == 1 ? NULL : node_delete(vm, node, index, 0);
+  }
+
+  uint32_t bit = slot_bit(hash, shift);
+  if (!(node->bitmap & bit)) {
+    return node;
+  }
+
+  uint32_t index = slot_index(node, bit);
+  const owl_term *slot = &node->slots[index * 2];
+
+  if (slot[0] != SUBNODE) {
+    if (!owl_terms_eq(slot[0], key)) {
+      return node;
+    }
+    return node->len == 1 ? NULL : node_delete(vm, node, index, bit);
+  }
+
+  const MapNode *child = map_to_node(slot[1]);
+  const MapNode *updated = node_remove(vm, child, shift + MAP_BITS, hash, key);
+
+  if (updated == child) {
+    return node;
+  }
+  if (updated == NULL) {
+    return node->len == 1 ? NULL : node_delete(vm, node, index, bit);
+  }
+
+  // A node left with a single entry is not worth the extra level
+  if (updated->len == 1 && updated->slots[0] != SUBNODE) {
+    return node_set(vm, node, index, updated->slots[0], updated->slots[1], node->count - 1);
+  }
+  return node_set(vm, node, index, SUBNODE, owl_map_from(updated), node->count - 1);
+}
+
+static void node_each(const MapNode *node, void (*visit)(owl_term key, owl_term value, void *context), void *context) {
+  for (uint32_t i = 0; i < node->len; i++) {
+    if (node->slots[i * 2] == SUBNODE) {
+      node_each(map_to_node(node->slots[i * 2 + 1]), visit, context);
+    } else {
+      visit(node->slots[i * 2], node->slots[i * 2 + 1], context);
+    }
+  }
+}
+
+// Whether every entry under `node` is in `map` as well, with an equal value
+static bool node_within(const MapNode *node, const MapNode *map) {
+  for (uint32_t i = 0; i < node->len; i++) {
+    owl_term key = node->slots[i * 2];
+    owl_term value = node->slots[i * 2 + 1];
+
+    if (key == SUBNODE) {
+      if (!node_within(map_to_node(value), map)) {
+        return false;
+      }
+    } else {
+      const owl_term *found = node_find(map, 0, owl_term_hash(key), key);
+      if (found == NULL || !owl_terms_eq(*found, value)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// SET OPERATIONS
+//
+// Union, intersection and difference walk both tries together, one level at a
+// time. Where only one side has anything in a slot, or both refer to the very
+// same node, the slot is taken over as it is without looking inside. Where the
+// result is the left side unchanged, the left side is returned itself. Keys in
+// both keep the value of either side, which makes no difference for sets.
+
+// Slots of a node being put together
+typedef struct NodeBuilder {
+  uint32_t bitmap;
+  uint32_t len;
+  uint32_t count;
+  owl_term slots[2 << MAP_BITS];
+} NodeBuilder;
+
+static uint32_t slot_count(const owl_term *slot) {
+  return slot[0] == SUBNODE ? map_to_node(slot[1])->count : 1;
+}
+
+static void builder_add(NodeBuilder *built, uint32_t bit, owl_term key, owl_term value, uint32_t count) {
+  built->slots[built->len * 2] = key;
+  built->slots[built->len * 2 + 1] = value;
+  built->bitmap |= bit;
+  built->len++;
+  built->count += count;
+}
+
+static void builder_add_slot(NodeBuilder *built, uint32_t bit, const owl_term *slot) {
+  builder_add(built, bit, slot[0], slot[1], slot_count(slot));
+}
+
+// Adds what is left of a subnode, pulling a single entry up like node_remove
+static void builder_add_node(NodeBuilder *built, uint32_t bit, const MapNode *child) {
+  if (child == NULL) {
+    return;
+  }
+  if (child->len == 1 && child->slots[0] != SUBNODE) {
+    builder_add(built, bit, child->slots[0], child->slots[1], 1);
+  } else {
+    builder_add(built, bit, SUBNODE, owl_map_from(child), child->count);
+  }
+}
+
+// Node with the slots in `built`, `original` itself if it has the same ones, or
+// NULL if there are none
+static const MapNode* builder_node(vm_t *vm, const NodeBuilder *built, const MapNode *original) {
+  if (built->len == 0) {
+    return NULL;
+  }
+  if (built->bitmap == original->bitmap && built->len == original->len &&
+      memcmp(built->slots, original->slots, built->len * 2 * sizeof(owl_term)) == 0) {
+    return original;
+  }
+
+  MapNode *node = node_create(vm, built->len);
+  memcpy(node->slots, built->slots, built->len * 2 * sizeof(owl_term));
+  node->bitmap = built->bitmap;
+  node->count = built->count;
+  node->set = original->set;
+  return node;
+}
+
+// Slot of `node` for `bit`, or NULL
+static const owl_term* slot_for(const MapNode *node, uint32_t bit) {
+  return (node->bitmap & bit) ? &node->slots[slot_index(node, bit) * 2] : NULL;
+}
+
+static const MapNode* node_union(vm_t *vm, const MapNode *left, const MapNode *right, uint32_t shift) {
+  if (left == right || right->count == 0) {
+    return left;
+  }
+  if (left->count == 0) {
+    return right;
+  }
+
+  // Both sides are collision nodes this deep down
+  if (left->collision) {
+    for (uint32_t i = 0; i < right->len; i++) {
+      left = node_put(vm, left, shift, 0, right->slots[i * 2], right->slots[i * 2 + 1]);
+    }
+    return left;
+  }
+
+  NodeBuilder built = {0};
+  for (uint32_t bits = left->bitmap | right->bitmap; bits; bits &= bits - 1) {
+    uint32_t bit = bits & -bits;
+    const owl_term *l = slot_for(left, bit);
+    const owl_term *r = slot_for(right, bit);
+
+    if (r == NULL) {
+      builder_add_slot(&built, bit, l);
+    } else if (l == NULL) {
+      builder_add_slot(&built, bit, r);
+    } else if (l[0] == SUBNODE && r[0] == SUBNODE) {
+      builder_add_node(&built, bit, node_union(vm, map_to_node(l[1]), map_to_node(r[1]), shift + MAP_BITS));
+    } else if (l[0] == SUBNODE) {
+      builder_add_node(&built, bit, node_put(vm, map_to_node(l[1]), shift + MAP_BITS, owl_term_hash(r[0]), r[0], r[1]));
+    } else if (r[0] == SUBNODE) {
+      builder_add_node(&built, bit, node_put(vm, map_to_node(r[1]), shift + MAP_BITS, owl_term_hash(l[0]), l[0], l[1]));
+    } else if (owl_terms_eq(l[0], r[0])) {
+      builder_add_slot(&built, bit, l);
+    } else {
+      MapNode *pair = node_pair(vm, shift + MAP_BITS, l[0], l[1], owl_term_hash(l[0]), r[0], r[1], owl_term_hash(r[0]));
+      builder_add_node(&built, bit, pair);
+    }
+  }
+  return builder_node(vm, &built, left);
+}
+
+// NULL if nothing would be left, like the ones below
+static const MapNode* node_intersection(vm_t *vm, const MapNode *left, const MapNode *right, uint32_t shift) {
+  if (left == right) {
+    return left;
+  }
+  if (left->count == 0 || right->count == 0) {
+    return NULL;
+  }
+
+  if (left->collision) {
+    const MapNode *kept = left;
+    for (uint32_t i = 0; i < left->len && kept != NULL; i++) {
+      if (collision_find(right, left->slots[i * 2]) < 0) {
+        kept = node_remove(vm, kept, shift, 0, left->slots[i * 2]);
+      }
+    }
+    return kept;
+  }
+
+  NodeBuilder built = {0};
+  for (uint32_t bits = left->bitmap & right->bitmap; bits; bits &= bits - 1) {
+    uint32_t bit = bits & -bits;
+    const owl_term *l = slot_for(left, bit);
+    const owl_term *r = slot_for(right, bit);
+
+    if (l[0] == SUBNODE && r[0] == SUBNODE) {
+      builder_add_node(&built, bit, node_intersection(vm, map_to_node(l[1]), map_to_node(r[1]), shift + MAP_BITS));
+    } else if (l[0] == SUBNODE) {
+      const owl_term *found = node_find(map_to_node(l[1]), shift + MAP_BITS, owl_term_hash(r[0]), r[0]);
+      if (found != NULL) {
+        builder_add(&built, bit, found[-1], found[0], 1);
+      }
+    } else if (r[0] == SUBNODE) {
+      if (node_find(map_to_node(r[1]), shift + MAP_BITS, owl_term_hash(l[0]), l[0]) != NULL) {
+        builder_add_slot(&built, bit, l);
+      }
+    } else if (owl_terms_eq(l[0], r[0])) {
+      builder_add_slot(&built, bit, l);
+    }
+  }
+  return builder_node(vm, &built, left);
+}
+
+static const MapNode* node_difference(vm_t *vm, const MapNode *left, const MapNode *right, uint32_t shift) {
+  if (left == right || left->count == 0) {
+    return NULL;
+  }
+  if (right->count == 0) {
+    return left;
+  }
+
+  if (left->collision) {
+    const MapNode *kept = left;
+    for (uint32_t i = 0; i < right->len && kept != NULL; i++) {
+      kept = node_remove(vm, kept, shift, 0, right->slots[i * 2]);
+    }
+    return kept;
+  }
+
+  NodeBuilder built = {0};
+  for (uint32_t bits = left->bitmap; bits; bits &= bits - 1) {
+    uint32_t bit = bits & -bits;
+    const owl_term *l = slot_for(left, bit);
+    const owl_term *r = slot_for(right, bit);
+
+    if (r == NULL) {
+      builder_add_slot(&built, bit, l);
+    } else if (l[0] == SUBNODE && r[0] == SUBNODE) {
+      builder_add_node(&built, bit, node_difference(vm, map_to_node(l[1]), map_to_node(r[1]), shift + MAP_BITS));
+    } else if (l[0] == SUBNODE) {
+      builder_add_node(&built, bit, node_remove(vm, map_to_node(l[1]), shift + MAP_BITS, owl_term_hash(r[0]), r[0]));
+    } else if (r[0] == SUBNODE) {
+      if (node_find(map_to_node(r[1]), shift + MAP_BITS, owl_term_hash(l[0]), l[0]) == NULL) {
+        builder_add_slot(&built, bit, l);
+      }
+    } else if (!owl_terms_eq(l[0], r[0])) {
+      builder_add_slot(&built, bit, l);
+    }
+  }
+  return builder_node(vm, &built, left);
+}
+
+// PUBLIC API
+
+owl_term owl_map_init() {
+  return owl_map_from(&EMPTY_MAP);
+}
+
+// Only the empty map and the empty set have no entries at all
+bool owl_map_is_empty(owl_term map) {
+  return map_to_node(map)->count == 0;
+}
+
+bool owl_map_is_set(owl_term map) {
+  return map_to_node(map)->set;
+}
+
+owl_term owl_map_get(owl_term map, owl_term key) {
+  expect_map(map);
+  const owl_term *found = node_find(map_to_node(map), 0, owl_term_hash(key), key);
+  return found == NULL ? OWL_NIL : *found;
+}
+
+owl_term owl_map_put(vm_t *vm, owl_term map, owl_term key, owl_term value) {
+  expect_map(map);
+  const MapNode *root = map_to_node(map);
+  const MapNode *updated = node_put(vm, root, 0, owl_term_hash(key), key, value);
+
+  return updated == root ? map : owl_map_from(updated);
+}
+
+owl_term owl_map_remove(vm_t *vm, owl_term map, owl_term key) {
+  expect_map(map);
+  const MapNode *root = map_to_node(map);
+  const MapNode *updated = node_remove(vm, root, 0, owl_term_hash(key), key);
+
+  if (updated == NULL) {
+    return owl_map_init();
+  }
+  return updated == root ? map : owl_map_from(updated);
+}
+
+bool owl_map_has_key(owl_term map, owl_term key) {
+  expect_map(map);
+  return node_find(map_to_node(map), 0, owl_term_hash(key), key) != NULL;
+}
+
+owl_term owl_map_count(owl_term map) {
+  expect_map(map);
+  return owl_int_from(map_to_node(map)->count);
+}
+
+void owl_map_each(owl_term map, void (*visit)(owl_term key, owl_term value, void *context), void *context) {
+  node_each(map_to_node(map), visit, context);
+}
+
+typedef struct ToList {
+  vm_t *vm;
+  owl_term builder;
+} ToList;
+
+static void push_entry(owl_term key, owl_term value, void *context) {
+  ToList *to_list = context;
+  owl_term *pair = owl_alloc(to_list->vm, 3 * sizeof(owl_term));
+
+  pair[0] = 2;
+  pair[1] = key;
+  pair[2] = value;
+  to_list->builder = owl_list_builder_push(to_list->vm, to_list->builder, owl_tag_as(pair, TUPLE));
+}
+
+// List of {key, value} tuples, in no particular order
+owl_term owl_map_to_list(vm_t *vm, owl_term map) {
+  expect_map(map);
+  ToList to_list = {vm, owl_list_builder(vm, owl_list_init())};
+
+  owl_map_each(map, push_entry, &to_list);
+  return owl_list_builder_freeze(vm, to_list.builder);
+}
+
+static bool cached_hash(const MapNode *node, uint64_t *hash) {
+  if (!__atomic_load_n(&node->hashed, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+  *hash = node->hash;
+  return true;
+}
+
+bool owl_map_eq(owl_term left, owl_term right) {
+  const MapNode *left_root = map_to_node(left);
+  const MapNode *right_root = map_to_node(right);
+
+  if (left_root->set != right_root->set || left_root->count != right_root->count) {
+    return false;
+  }
+
+  // Working the hashes out would hash every value as well as every key, so
+  // only hashes that are already known are used to rule maps out
+  uint64_t left_hash, right_hash;
+  if (cached_hash(left_root, &left_hash) && cached_hash(right_root, &right_hash) && left_hash != right_hash) {
+    return false;
+  }
+  return node_within(left_root, right_root);
+}
+
+static void hash_entry(owl_term key, owl_term value, void *context) {
+  uint64_t *hash = context;
+  *hash += owl_term_hash(key) ^ (owl_term_hash(value) * 0x9E3779B97F4A7C15ULL);
+}
+
+// Adds up the hashes of the entries, which are not kept in any order that
+// equal maps would agree on. The sum is kept in the node once worked out,
+// which is published like the hash of a list, see owl_list_cache_hash. The
+// empty maps are read-only, and have nothing to add up anyway.
+uint64_t owl_map_hash(owl_term map) {
+  MapNode *node = map_to_node(map);
+  uint64_t hash = 0;
+
+  if (__atomic_load_n(&node->hashed, __ATOMIC_ACQUIRE)) {
+    return node->hash;
+  }
+
+  owl_map_each(map, hash_entry, &hash);
+  if (node->count > 0) {
+    node->hash = hash;
+    __atomic_store_n(&node->hashed, true, __ATOMIC_RELEASE);
+  }
+  return hash;
+}
+
+// SETS
+
+owl_term owl_set_init() {
+  return owl_map_from(&EMPTY_SET);
+}
+
+owl_term owl_set_put(vm_t *vm, owl_term set, owl_term elem) {
+  expect_set(set);
+  const MapNode *root = map_to_node(set);
+  const MapNode *updated = node_put(vm, root, 0, owl_term_hash(elem), elem, OWL_TRUE);
+
+  return updated == root ? set : owl_map_from(updated);
+}
+
+static owl_term set_from(owl_term set, const MapNode *root) {
+  if (root == NULL) {
+    return owl_set_init();
+  }
+  return root == map_to_node(set) ? set : owl_map_from(root);
+}
+
+owl_term owl_set_remove(vm_t *vm, owl_term set, owl_term elem) {
+  expect_set(set);
+  return set_from(set, node_remove(vm, map_to_node(set), 0, owl_term_hash(elem), elem));
+}
+
+bool owl_set_member(owl_term set, owl_term elem) {
+  expect_set(set);
+  return node_find(map_to_node(set), 0, owl_term_hash(elem), elem) != NULL;
+}
+
+owl_term owl_set_count(owl_term set) {
+  expect_set(set);
+  return owl_int_from(map_to_node(set)->count);
+}
+
+owl_term owl_set_union(vm_t *vm, owl_term left, owl_term right) {
+  expect_set(left);
+  expect_set(right);
+  const MapNode *root = node_union(vm, map_to_node(left), map_to_node(right), 0);
+
+  return root == map_to_node(right) ? right : set_from(left, root);
+}
+
+owl_term owl_set_intersection(vm_t *vm, owl_term left, owl_term right) {
+  expect_set(left);
+  expect_set(right);
+  return set_from(left, node_intersection(vm, map_to_node(left), map_to_node(right), 0));
+}
+
+owl_term owl_set_difference(vm_t *vm, owl_term left, owl_term right) {
+  expect_set(left);
+  expect_set(right);
+  return set_from(left, node_difference(vm, map_to_node(left), map_to_node(right), 0));
+}
+
+static void push_elem(owl_term elem, owl_term value, void *context) {
+  ToList *to_list = context;
+  (void) value;                        // Always true
+  to_list->builder = owl_list_builder_push(to_list->vm, to_list->builder, elem);
+}
+
+// List of the elements, in no particular order
+owl_term owl_set_to_list(vm_t *vm, owl_term set) {
+  expect_set(set);
+  ToList to_list = {vm, owl_list_builder(vm, owl_list_init())};
+
+  owl_map_each(set, push_elem, &to_list);
+  return owl_list_builder_freeze(vm, to_list.builder);
+}
@@ -0,0 +1,57 @@
+#ifndef OWL_MAP_H
+#define OWL_MAP_H
+
+#include "owl.h"
+
+// Maps are hash array mapped tries. Each node has a bit for every one of the 32
+// slots it could have at its level, followed by a key and a value for each bit
+// that is set, in slot order. A slot that holds more than one entry refers to a
+// node one level down instead: its key is 0, which is not a term, and its value
+// is the node. Nodes are terms tagged as MAP, so the collectors only need to
+// know how to visit the keys and values of one.
+//
+// Keys whose hashes agree in every bit end up in a collision node, which has no
+// bitmap and simply lists its entries.
+//
+// Sets are the same tries with true as the value of every element and `set`
+// marked on their root, which is all that tells them apart from maps.
+
+typedef struct MapNode {
+  uint32_t bitmap;
+  uint32_t len;                        // Slots in use
+  uint32_t count;                      // Entries in this node and below it
+  bool collision;
+  bool set;                            // Only meaningful on the root
+  bool hashed;                         // Whether `hash` is set, see owl_map_hash
+  uint64_t hash;
+  owl_term slots[];                    // Key and value of each slot
+} MapNode;
+
+#define owl_map_from(node) owl_tag_as(node, MAP)
+#define map_to_node(map) ((MapNode*) owl_extract_ptr(map))
+#define map_node_size(len) (sizeof(MapNode) + (len) * 2 * sizeof(owl_term))
+
+owl_term owl_map_init();
+bool owl_map_is_empty(owl_term map);
+owl_term owl_map_get(owl_term map, owl_term key);
+owl_term owl_map_put(vm_t *vm, owl_term map, owl_term key, owl_term value);
+owl_term owl_map_remove(vm_t *vm, owl_term map, owl_term key);
+bool owl_map_has_key(owl_term map, owl_term key);
+owl_term owl_map_count(owl_term map);
+owl_term owl_map_to_list(vm_t *vm, owl_term map);
+bool owl_map_eq(owl_term left, owl_term right);
+uint64_t owl_map_hash(owl_term map);
+void owl_map_each(owl_term map, void (*visit)(owl_term key, owl_term value, void *context), void *context);
+bool owl_map_is_set(owl_term map);
+
+owl_term owl_set_init();
+owl_term owl_set_put(vm_t *vm, owl_term set, owl_term elem);
+owl_term owl_set_remove(vm_t *vm, owl_term set, owl_term elem);
+bool owl_set_member(owl_term set, owl_term elem);
+owl_term owl_set_count(owl_term set);
+owl_term owl_set_union(vm_t *vm, owl_term left, owl_term right);
+owl_term owl_set_intersection(vm_t *vm, owl_term left, owl_term right);
+owl_term owl_set_difference(vm_t *vm, owl_term left, owl_term right);
+owl_term owl_set_to_list(vm_t *vm, owl_term set);
+
+#endif  // OWL_MAP_H
@@ -3,18 +3,266 @@
 #include <stdlib.h>
 
 #include "std/owl_string.h"
+#include "std/owl_list.h"
 #include "term.h"
 #include "alloc.h"
+#include "util/string_search.h"
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
 
-owl_term owl_string_slice(vm_t *vm, owl_term string, owl_term from, owl_term to) {
-  char *the_string = owl_extract_ptr(string);
+#define ROPE_MIN_LENGTH 64             // Shorter concatenations are copied, ropes are always longer
+#define SLICE_MIN_LENGTH 16            // Shorter slices are copied, they would take as much room as a slice
+
+// A string of `length` bytes, which are left for the caller to fill in
+OwlString* owl_string_alloc(vm_t *vm, uint32_t length) {
+  OwlString *string = owl_alloc(vm, owl_string_size(length));
+  string->hashed = false;
+  string->kind = FLAT_STRING;
+  string->depth = 0;
+  string->length = length;
+  string->chars[length] = '\0';
+  return string;
+}
+
+owl_term owl_string_new(vm_t *vm, const char *chars, uint32_t length) {
+  OwlString *string = owl_string_alloc(vm, length);
+  memcpy(string->chars, chars, length);
+  return string_to_owl(string);
+}
+
+owl_term owl_string_from(vm_t *vm, const char *chars) {
+  return owl_string_new(vm, chars, strlen(chars));
+}
+
+// ROPES
+
+// The flat string `rope` has been flattened to, or 0. Threads running
+// List.pmap may flatten the same rope at once, each of them sets a string with
+// the same bytes.
+static owl_term rope_flat(owl_term rope) {
+  return __atomic_load_n(&owl_to_rope(rope)->flat, __ATOMIC_ACQUIRE);
+}
+
+// Flattened ropes are as good as flat strings
+static owl_term settled(owl_term string) {
+  if (owl_string_is_rope(string)) {
+    owl_term flat = rope_flat(string);
+    return flat ? flat : string;
+  }
+  return string;
+}
+
+// Walks the pieces of bytes that make up a string, in order. No rope is deeper
+// than ROPE_MAX_DEPTH, so there is never more than one string pending at each
+// level.
+typedef struct StringChunks {
+  owl_term pending[ROPE_MAX_DEPTH + 1];
+  uint32_t count;
+} StringChunks;
+
+typedef struct Chunk {
+  const char *chars;
+  uint32_t length;
+} Chunk;
+
+static void chunks_init(StringChunks *chunks, owl_term string) {
+  chunks->pending[0] = string;
+  chunks->count = 1;
+}
+
+static bool chunks_next(StringChunks *chunks, Chunk *chunk) {
+  while (chunks->count > 0) {
+    owl_term string = settled(chunks->pending[--chunks->count]);
+
+    if (owl_string_is_rope(string)) {
+      chunks->pending[chunks->count++] = owl_to_rope(string)->right;
+      chunks->pending[chunks->count++] = owl_to_rope(string)->left;
+    } else if (owl_string_length(string) > 0) {
+      chunk->chars = owl_string_bytes(string);
+      chunk->length = owl_string_length(string);
+      return true;
+    }
+  }
+  return false;
+}
+
+static char* copy_chars(char *to, owl_term string) {
+  StringChunks chunks;
+  Chunk chunk;
+
+  chunks_init(&chunks, string);
+  while (chunks_next(&chunks, &chunk)) {
+    memcpy(to, chunk.chars, chunk.length);
+    to += chunk.length;
+  }
+  return to;
+}
+
+// `string` in one piece and followed by a NUL. Ropes keep what they are
+// flattened to, so that this only copies their bytes once. Slices are copied
+// every time, this is only for handing bytes to C.
+owl_term owl_string_flatten(vm_t *vm, owl_term string) {
+  owl_term flat = settled(string);
+  if (owl_string_kind(flat) == FLAT_STRING) {
+    return flat;
+  }
+  if (owl_string_kind(flat) == SLICE_STRING) {
+    return owl_string_new(vm, owl_string_bytes(flat), owl_string_length(flat));
+  }
+
+  OwlString *result = owl_string_alloc(vm, owl_string_length(string));
+  copy_chars(result->chars, string);
+  flat = string_to_owl(result);
+  __atomic_store_n(&owl_to_rope(string)->flat, flat, __ATOMIC_RELEASE);
+  return flat;
+}
+
+// `string` as a flat string or a slice, with its bytes in one piece
+static owl_term contiguous(vm_t *vm, owl_term string) {
+  string = settled(string);
+  return owl_string_is_rope(string) ? owl_string_flatten(vm, string) : string;
+}
+
+static owl_term rope_new(vm_t *vm, owl_term left, owl_term right) {
+  uint32_t length = owl_string_length(left) + owl_string_length(right);
+  uint32_t depth = MAX(owl_to_string(left)->depth, owl_to_string(right)->depth) + 1;
+
+  if (depth > ROPE_MAX_DEPTH) {
+    OwlString *flat = owl_string_alloc(vm, length);
+    copy_chars(copy_chars(flat->chars, left), right);
+    return string_to_owl(flat);
+  }
+
+  OwlRope *rope = owl_alloc(vm, sizeof(OwlRope));
+  rope->length = length;
+  rope->hashed = false;
+  rope->kind = ROPE_STRING;
+  rope->depth = depth;
+  rope->flat = 0;
+  rope->left = left;
+  rope->right = right;
+  return string_to_owl(rope);
+}
+
+// Appending short pieces one after another would make a rope as deep as there
+// are pieces. Instead, the pieces at the end of `left` that are no longer than
+// what comes after them are copied together with `right`, like the carry of a
+// binary counter. A string built up piece by piece then ends up made of a few
+// pieces of falling lengths, and each byte is only copied a logarithmic number
+// of times.
+static owl_term append_flat(vm_t *vm, owl_term left, owl_term right) {
+  owl_term carried[ROPE_MAX_DEPTH + 1];
+  uint32_t n_carried = 0;
+  uint32_t length = owl_string_length(right);
+  owl_term rest = left;
+
+  while (owl_string_is_rope(rest)) {
+    owl_term last = settled(owl_to_rope(rest)->right);
+    if (owl_string_is_rope(last) || owl_string_length(last) > length) {
+      break;
+    }
+    carried[n_carried++] = last;
+    length += owl_string_length(last);
+    rest = settled(owl_to_rope(rest)->left);
+  }
+  if (!owl_string_is_rope(rest) && owl_string_length(rest) <= length) {
+    carried[n_carried++] = rest;
+    length += owl_string_length(rest);
+    rest = 0;
+  }
+
+  if (n_carried == 0) {
+    return rope_new(vm, left, right);
+  }
+
+  OwlString *merged = owl_string_alloc(vm, length);
+  char *to = merged->chars;
+  while (n_carried > 0) {
+    owl_term piece = carried[--n_carried];
+    memcpy(to, owl_string_bytes(piece), owl_string_length(piece));
+    to += owl_string_length(piece);
+  }
+  memcpy(to, owl_string_bytes(right), owl_string_length(right));
+
+  return rest ? rope_new(vm, rest, string_to_owl(merged)) : string_to_owl(merged);
+}
+
+owl_term owl_string_concat(vm_t *vm, owl_term left, owl_term right) {
+  left = settled(left);
+  right = settled(right);
+
+  if (owl_string_length(left) == 0) {
+    return right;
+  }
+  if (owl_string_length(right) == 0) {
+    return left;
+  }
+  if (owl_string_length(left) + owl_string_length(right) <= ROPE_MIN_LENGTH) {
+    OwlString *result = owl_string_alloc(vm, owl_string_length(left) + owl_string_length(right));
+    memcpy(result->chars, owl_string_bytes(left), owl_string_length(left));
+    memcpy(result->chars + owl_string_length(left), owl_string_bytes(right), owl_string_length(right));
+    return string_to_owl(result);
+  }
+  if (!owl_string_is_rope(right)) {
+    return append_flat(vm, left, right);
+  }
+  return rope_new(vm, left, right);
+}
 
+// `string` followed by a C string
+owl_term owl_string_append(vm_t *vm, owl_term string, const char *chars) {
+  return owl_string_concat(vm, string, owl_string_from(vm, chars));
+}
+
+// STRING FUNCTIONS
+
+// `length` bytes of `string`, a flat string or a slice, starting at `from`
+static owl_term cut(vm_t *vm, owl_term string, uint32_t from, uint32_t length) {
+  if (length == owl_string_length(string)) {
+    return string;
+  }
+  if (length <= SLICE_MIN_LENGTH) {
+    return owl_string_new(vm, owl_string_bytes(string) + from, length);
+  }
+  // Slices of slices point into the same string
+  if (owl_string_kind(string) == SLICE_STRING) {
+    from += owl_to_slice(string)->offset;
+    string = owl_to_slice(string)->parent;
+  }
+
+  OwlSlice *slice = owl_alloc(vm, sizeof(OwlSlice));
+  slice->length = length;
+  slice->hashed = false;
+  slice->kind = SLICE_STRING;
+  slice->depth = 0;
+  slice->offset = from;
+  slice->parent = string;
+  return string_to_owl(slice);
+}
+
+// Where `substr` first occurs in `string` from `from` on, or -1, see
+// string_search
+static int64_t search(vm_t *vm, owl_term string, uint32_t from, owl_term substr) {
+  // Without flattening ropes where there is no need to
+  if (owl_string_length(substr) == 0) {
+    return from;
+  }
+  if (owl_string_length(substr) > owl_string_length(string) - from) {
+    return -1;
+  }
+
+  const char *chars = owl_string_bytes(contiguous(vm, string));
+  const char *sub_chars = owl_string_bytes(contiguous(vm, substr));
+
+  int64_t found = string_search(chars + from, owl_string_length(string) - from, sub_chars, owl_string_length(substr));
+  return found < 0 ? found : found + from;
+}
+
+owl_term owl_string_slice(vm_t *vm, owl_term string, owl_term from, owl_term to) {
   int from_int = int_from_owl_int(from);
   // Cap to make sure we don't go past the end
-  int to_int = MIN(int_from_owl_int(to), strlen(the_string));
+  int to_int = MIN(int_from_owl_int(to), owl_string_length(string));
   int slice_size = to_int - from_int;
 
   if (slice_size < 1) {
@@ -22,39 +270,157 @@ owl_term owl_string_slice(vm_t *vm, owl_term string, owl_term from, owl_term to)
     exit(1);
   }
 
-  char *sliced = owl_alloc(vm, slice_size + 1);
-  memcpy(sliced, the_string + from_int, slice_size);
-  sliced[slice_size] = '\0';
+  // Nor before the start, like String.last of an empty string asks for
+  from_int = MAX(from_int, 0);
+  uint32_t length = to_int - from_int;
 
-  return owl_string_from(sliced);
+  if (length == owl_string_length(string)) {
+    return settled(string);
+  }
+  return cut(vm, contiguous(vm, string), from_int, length);
 }
 
-owl_term owl_string_concat(vm_t *vm, owl_term left, owl_term right) {
-  const char *left_str = owl_extract_ptr(left);
-  const char *right_str = owl_extract_ptr(right);
+owl_term owl_string_count(owl_term string) {
+  return owl_int_from(owl_string_length(string));
+}
 
-  size_t left_len = strlen(left_str);
-  size_t total_len = left_len + strlen(right_str) + 1;
-  char *result = owl_alloc(vm, total_len);
-  memcpy(result, left_str, left_len);
-  strcpy(result + left_len, right_str);
+owl_term owl_string_contains(vm_t *vm, owl_term string, owl_term substr) {
+  return owl_bool(search(vm, string, 0, substr) >= 0);
+}
 
-  return owl_string_from(result);
+// Index of the first byte where `substr` first occurs in `string`, or nil
+owl_term owl_string_index_of(vm_t *vm, owl_term string, owl_term substr) {
+  int64_t found = search(vm, string, 0, substr);
+  return found >= 0 ? owl_int_from(found) : OWL_NIL;
 }
 
-owl_term owl_string_count(owl_term string) {
-  const char *str = owl_extract_ptr(string);
+// The parts of `string` between occurrences of `separator`, as slices of it
+owl_term owl_string_split(vm_t *vm, owl_term string, owl_term separator) {
+  uint32_t length = owl_string_length(string);
+  uint32_t separator_length = owl_string_length(separator);
+
+  if (separator_length == 0) {
+    printf("Split separator must not be empty");
+    exit(1);
+  }
+
+  string = contiguous(vm, string);
+  separator = contiguous(vm, separator);
+  owl_term result = owl_list_builder(vm, owl_list_init());
+  uint32_t from = 0;
+  int64_t found;
+
+  while ((found = search(vm, string, from, separator)) >= 0) {
+    result = owl_list_builder_push(vm, result, cut(vm, string, from, found - from));
+    from = found + separator_length;
+  }
+  result = owl_list_builder_push(vm, result, cut(vm, string, from, length - from));
+  return owl_list_builder_freeze(vm, result);
+}
+
+// Compares the bytes of two strings up to the end of the shorter one, piece by
+// piece for ropes, so that comparing never allocates
+static int compare_bytes(owl_term left, owl_term right) {
+  left = settled(left);
+  right = settled(right);
+  if (!owl_string_is_rope(left) && !owl_string_is_rope(right)) {
+    return memcmp(owl_string_bytes(left), owl_string_bytes(right),
+                  MIN(owl_string_length(left), owl_string_length(right)));
+  }
 
-  return owl_int_from(strlen(str));
+  StringChunks left_chunks, right_chunks;
+  chunks_init(&left_chunks, left);
+  chunks_init(&right_chunks, right);
+  Chunk left_chunk, right_chunk;
+  bool left_more = chunks_next(&left_chunks, &left_chunk);
+  bool right_more = chunks_next(&right_chunks, &right_chunk);
+  uint32_t left_at = 0, right_at = 0;
+
+  while (left_more && right_more) {
+    uint32_t n = MIN(left_chunk.length - left_at, right_chunk.length - right_at);
+    int difference = memcmp(left_chunk.chars + left_at, right_chunk.chars + right_at, n);
+    if (difference != 0) {
+      return difference;
+    }
+
+    left_at += n;
+    right_at += n;
+    if (left_at == left_chunk.length) {
+      left_more = chunks_next(&left_chunks, &left_chunk);
+      left_at = 0;
+    }
+    if (right_at == right_chunk.length) {
+      right_more = chunks_next(&right_chunks, &right_chunk);
+      right_at = 0;
+    }
+  }
+  return 0;
 }
 
-owl_term owl_string_contains(owl_term string, owl_term substr) {
-  const char *str = owl_extract_ptr(string);
-  const char *subs = owl_extract_ptr(substr);
+bool owl_string_eq(owl_term left, owl_term right) {
+  uint64_t left_hash, right_hash;
 
-  if (strstr(str, subs) != NULL) {
-    return OWL_TRUE;
-  } else {
-    return OWL_FALSE;
+  if (owl_string_length(left) != owl_string_length(right)) {
+    return false;
   }
+  if (owl_string_cached_hash(left, &left_hash) && owl_string_cached_hash(right, &right_hash) &&
+      left_hash != right_hash) {
+    return false;
+  }
+  return compare_bytes(left, right) == 0;
+}
+
+// By their bytes, the shorter first if it is where the longer one starts
+int owl_string_compare(owl_term left, owl_term right) {
+  int difference = compare_bytes(left, right);
+  if (difference == 0) {
+    return (owl_string_length(left) > owl_string_length(right)) - (owl_string_length(left) < owl_string_length(right));
+  }
+  return (difference > 0) - (difference < 0);
+}
+
+// FNV-1a of the bytes, however they are split up
+uint64_t owl_string_hash(owl_term string) {
+  StringChunks chunks;
+  Chunk chunk;
+  uint64_t hash = 0xCBF29CE484222325ULL;
+
+  chunks_init(&chunks, string);
+  while (chunks_next(&chunks, &chunk)) {
+    for (uint32_t i = 0; i < chunk.length; i++) {
+      hash ^= (uint8_t) chunk.chars[i];
+      hash *= 0x100000001B3ULL;
+    }
+  }
+  return hash;
+}
+
+void owl_string_print(owl_term string) {
+  StringChunks chunks;
+  Chunk chunk;
+
+  chunks_init(&chunks, string);
+  while (chunks_next(&chunks, &chunk)) {
+    fwrite(chunk.chars, 1, chunk.length, stdout);
+  }
+}
+
+// Like those of lists, see owl_list_cached_hash. Strings never change, so every
+// one of them keeps its hash, constants included.
+
+bool owl_string_cached_hash(owl_term string, uint64_t *hash) {
+  const OwlString *str = owl_to_string(string);
+
+  if (!__atomic_load_n(&str->hashed, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+  *hash = str->hash;
+  return true;
+}
+
+void owl_string_cache_hash(owl_term string, uint64_t hash) {
+  OwlString *str = owl_to_string(string);
+
+  str->hash = hash;
+  __atomic_store_n(&str->hashed, true, __ATOMIC_RELEASE);
 }
@@ -1,13 +1,84 @@
 #ifndef OWL_STRING_H
 #define OWL_STRING_H
 
+#include <stddef.h>
 #include "owl.h"
 
-#define owl_string_from(str) owl_tag_as(str, STRING)
+typedef enum {FLAT_STRING, ROPE_STRING, SLICE_STRING} StringKind;
 
+// Strings know their length, so counting them takes no time and they may hold
+// any bytes at all, NULs included. A NUL still follows the last byte, so that
+// the bytes can be handed to C as they are, for file names and the like.
+typedef struct OwlString {
+  uint64_t hash;
+  uint32_t length;                     // In bytes, not counting the NUL after them
+  bool hashed;                         // Whether `hash` is set, see owl_term_hash
+  uint8_t kind;                        // A StringKind
+  uint8_t depth;                       // 0, see OwlRope
+  char chars[];
+} OwlString;
+
+// Concatenating long strings makes a rope: a node that only refers to the two
+// halves, whose bytes are copied together once something needs them in one
+// piece, see owl_string_flatten. Ropes are strings to everything else, they
+// start the same way as one and are tagged as STRING too.
+typedef struct OwlRope {
+  uint64_t hash;
+  uint32_t length;
+  bool hashed;
+  uint8_t kind;
+  uint8_t depth;                       // Of the deepest rope below, plus one
+  owl_term flat;                       // The same bytes as a flat string, 0 until flattened
+  owl_term left;
+  owl_term right;
+} OwlRope;
+
+// Slicing a string makes a slice, which points into the bytes of the string it
+// was sliced out of instead of copying them. The bytes of a slice are all in
+// one piece, like those of a flat string, but not followed by a NUL.
+typedef struct OwlSlice {
+  uint64_t hash;
+  uint32_t length;
+  bool hashed;
+  uint8_t kind;
+  uint8_t depth;                       // 0
+  uint32_t offset;                     // Of the first byte in `parent`
+  owl_term parent;                     // A flat string
+} OwlSlice;
+
+#define ROPE_MAX_DEPTH 64              // Deeper ones are flattened as they are made
+
+#define string_to_owl(string) owl_tag_as(string, STRING)
+#define owl_to_string(term) ((OwlString*) owl_extract_ptr(term))
+#define owl_to_rope(term) ((OwlRope*) owl_extract_ptr(term))
+#define owl_to_slice(term) ((OwlSlice*) owl_extract_ptr(term))
+#define owl_string_kind(term) (owl_to_string(term)->kind)
+#define owl_string_is_rope(term) (owl_string_kind(term) == ROPE_STRING)
+#define owl_string_chars(term) (owl_to_string(term)->chars)  // Of flat strings only
+#define owl_string_length(term) (owl_to_string(term)->length)
+#define owl_string_size(length) (offsetof(OwlString, chars) + (length) + 1)
+
+// The bytes of a string that is not a rope
+#define owl_string_bytes(term) (owl_string_kind(term) == SLICE_STRING \
+  ? owl_string_chars(owl_to_slice(term)->parent) + owl_to_slice(term)->offset \
+  : owl_string_chars(term))
+
+OwlString* owl_string_alloc(vm_t *vm, uint32_t length);
+owl_term owl_string_new(vm_t *vm, const char *chars, uint32_t length);
+owl_term owl_string_from(vm_t *vm, const char *chars);
+owl_term owl_string_append(vm_t *vm, owl_term string, const char *chars);
+owl_term owl_string_flatten(vm_t *vm, owl_term string);
 owl_term owl_string_slice(vm_t *vm, owl_term string, owl_term from, owl_term to);
 owl_term owl_string_concat(vm_t *vm, owl_term left, owl_term right);
 owl_term owl_string_count(owl_term string);
-owl_term owl_string_contains(owl_term string, owl_term substr);
+owl_term owl_string_contains(vm_t *vm, owl_term string, owl_term substr);
+owl_term owl_string_index_of(vm_t *vm, owl_term string, owl_term substr);
+owl_term owl_string_split(vm_t *vm, owl_term string, owl_term separator);
+bool owl_string_eq(owl_term left, owl_term right);
+int owl_string_compare(owl_term left, owl_term right);
+uint64_t owl_string_hash(owl_term string);
+void owl_string_print(owl_term string);
+bool owl_string_cached_hash(owl_term string, uint64_t *hash);
+void owl_string_cache_hash(owl_term string, uint64_t hash);
 
 #endif  // OWL_STRING_H
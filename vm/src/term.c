@@ -6,8 +6,10 @@
 #include "alloc.h"
 #include "term.h"
 #include "std/owl_list.h"
+#include "std/owl_map.h"
 #include "std/owl_string.h"
 #include "std/owl_function.h"
+#include "util/term_sort.h"
 
 #define INT_MAX_DIGITS 20
 
@@ -41,45 +43,72 @@ owl_term owl_tuple_nth(owl_term tuple, uint8_t index) {
   }
 }
 
-owl_term owl_type_of(owl_term term) {
+const char* owl_type_name(owl_term term) {
   switch(owl_tag_of(term)) {
     case POINTER:
-      return owl_string_from("Pointer");
+      return "Pointer";
     case INT:
-      return owl_string_from("Int");
+      return "Int";
     case TUPLE:
-      return owl_string_from("Tuple");
+      return "Tuple";
     case LIST:
-      return owl_string_from("List");
+      return "List";
     case STRING:
-      return owl_string_from("String");
+      return "String";
     case FUNCTION:
-      return owl_string_from("Function");
+      return "Function";
+    case MAP:
+      if (owl_map_is_set(term)) {
+        return "Set";
+      }
+      return "Map";
     default:
-      return owl_string_from("Unknown");
+      return "Unknown";
+  }
+}
+
+typedef struct MapString {
+  vm_t *vm;
+  owl_term buffer;
+  bool first;
+  bool set;                            // Elements only, without their values
+} MapString;
+
+static void map_entry_to_string(owl_term key, owl_term value, void *context) {
+  MapString *string = context;
+  vm_t *vm = string->vm;
+
+  if (!string->first) {
+    string->buffer = owl_string_append(vm, string->buffer, ", ");
+  }
+  string->first = false;
+  string->buffer = owl_string_concat(vm, string->buffer, owl_term_to_string(vm, key));
+  if (!string->set) {
+    string->buffer = owl_string_append(vm, string->buffer, " => ");
+    string->buffer = owl_string_concat(vm, string->buffer, owl_term_to_string(vm, value));
   }
 }
 
 owl_term owl_term_to_string(vm_t *vm, owl_term term) {
   switch(term) {
   case OWL_TRUE:
-    return owl_string_from("true");
+    return owl_string_from(vm, "true");
   case OWL_FALSE:
-    return owl_string_from("false");
+    return owl_string_from(vm, "false");
   case OWL_NIL:
-    return owl_string_from("nil");
+    return owl_string_from(vm, "nil");
   }
 
   switch(owl_tag_of(term)) {
     case INT:
     {
-      char *buf = owl_alloc(vm, INT_MAX_DIGITS + 1);
-      sprintf(buf, "%llu", int_from_owl_int(term));
-      return owl_string_from(buf);
+      char buf[INT_MAX_DIGITS + 1];
+      int length = sprintf(buf, "%llu", int_from_owl_int(term));
+      return owl_string_new(vm, buf, length);
     }
     case TUPLE:
     {
-      owl_term buffer = owl_string_from("");
+      owl_term buffer = owl_string_new(vm, "", 0);
 
       owl_term *ary = owl_extract_ptr(term);
       uint8_t size = ary[0];
@@ -90,22 +119,30 @@ owl_term owl_term_to_string(vm_t *vm, owl_term term) {
     }
     case LIST:
     {
-      owl_term buffer = owl_string_from("[");
-      uint64_t count = int_from_owl_int(owl_list_count(term));
-      for(uint64_t i = 0; i < count; i++) {
-        buffer = owl_string_concat(vm, buffer, owl_term_to_string(vm, owl_list_nth(term, owl_int_from(i))));
-        if (i != count - 1) {
-          buffer = owl_string_concat(vm, buffer, owl_string_from(", "));
+      owl_term buffer = owl_string_from(vm, "[");
+      ListCursor cursor;
+      list_cursor_init(&cursor, term);
+      while (list_cursor_has_next(&cursor)) {
+        buffer = owl_string_concat(vm, buffer, owl_term_to_string(vm, list_cursor_next(&cursor)));
+        if (list_cursor_has_next(&cursor)) {
+          buffer = owl_string_append(vm, buffer, ", ");
         }
       }
-      buffer = owl_string_concat(vm, buffer, owl_string_from("]"));
+      buffer = owl_string_append(vm, buffer, "]");
       return buffer;
     }
     case STRING:
       return term;
     case FUNCTION:
     {
-      return owl_function_name(term);
+      return owl_function_name(vm, term);
+    }
+    case MAP:
+    {
+      bool set = owl_map_is_set(term);
+      MapString string = {vm, owl_string_from(vm, set ? "#{" : "%{"), true, set};
+      owl_map_each(term, map_entry_to_string, &string);
+      return owl_string_append(vm, string.buffer, "}");
     }
     default:
       puts("Unable to convert to string");
@@ -148,20 +185,245 @@ bool owl_terms_eq(owl_term left, owl_term right) {
     }
     case LIST:
       return owl_list_eq(left, right);
+    case MAP:
+      return owl_map_eq(left, right);
     case STRING: // Comparing non-interned strings
+      return owl_string_eq(left, right);
+    case FUNCTION:
+      return owl_function_eq(left, right);
+    default:
+      return false;
+  }
+}
+
+// ORDERING
+//
+// Terms of different types are ordered by type: ints, booleans, nil, strings,
+// tuples, lists, maps, sets and functions. Ints go by value, false comes before
+// true, strings go by their bytes and lists element by element, the shorter
+// first if it is where the longer one starts. Tuples go by size and then the
+// same way as lists.
+//
+// Maps and sets of the same size go by their hashes, which orders them in a way
+// that means nothing but holds up. Only unequal ones with the same hash are
+// compared entry by entry, in the order of their keys. Functions go by where
+// their code is and then by their upvalues.
+
+static int type_rank(owl_term term) {
+  switch(term) {
+  case OWL_FALSE:
+  case OWL_TRUE:
+    return 1;
+  case OWL_NIL:
+    return 2;
+  }
+
+  switch(owl_tag_of(term)) {
+    case INT:
+      return 0;
+    case STRING:
+      return 3;
+    case TUPLE:
+      return 4;
+    case LIST:
+      return 5;
+    case MAP:
+      return owl_map_is_set(term) ? 7 : 6;
+    default:
+      return 8;
+  }
+}
+
+static int compare_values(uint64_t left, uint64_t right) {
+  return (left > right) - (left < right);
+}
+
+typedef struct Entries {
+  SortItem *items;
+  uint32_t n;
+} Entries;
+
+static void collect_entry(owl_term key, owl_term value, void *context) {
+  Entries *entries = context;
+  entries->items[entries->n++] = (SortItem) {key, value};
+}
+
+static Entries sorted_entries(owl_term map) {
+  Entries entries = {malloc(map_to_node(map)->count * sizeof(SortItem)), 0};
+  if (entries.items == NULL) {
+    puts("Unable to allocate memory for comparing maps");
+    exit(1);
+  }
+
+  owl_map_each(map, collect_entry, &entries);
+  items_sort(entries.items, entries.n);
+  return entries;
+}
+
+static int maps_compare(owl_term left, owl_term right) {
+  int order = compare_values(map_to_node(left)->count, map_to_node(right)->count);
+  if (order == 0) {
+    order = compare_values(owl_map_hash(left), owl_map_hash(right));
+  }
+  if (order != 0 || owl_map_eq(left, right)) {
+    return order;
+  }
+
+  Entries left_entries = sorted_entries(left);
+  Entries right_entries = sorted_entries(right);
+
+  for (uint32_t i = 0; i < left_entries.n && order == 0; i++) {
+    order = owl_terms_compare(left_entries.items[i].key, right_entries.items[i].key);
+    if (order == 0) {
+      order = owl_terms_compare(left_entries.items[i].term, right_entries.items[i].term);
+    }
+  }
+
+  free(left_entries.items);
+  free(right_entries.items);
+  return order;
+}
+
+int owl_terms_compare(owl_term left, owl_term right) {
+  if (left == right) return 0;
+
+  int rank = type_rank(left);
+  int order = rank - type_rank(right);
+  if (order != 0) {
+    return order < 0 ? -1 : 1;
+  }
+  if (rank == 1 || rank == 2) {
+    return compare_values(left, right);
+  }
+
+  switch(owl_tag_of(left)) {
+    case INT:
+      return compare_values(left, right);
+    case STRING:
+      return owl_string_compare(left, right);
+    case TUPLE:
+    {
+      owl_term *left_ary = owl_extract_ptr(left);
+      owl_term *right_ary = owl_extract_ptr(right);
+
+      order = compare_values(left_ary[0], right_ary[0]);
+      for(uint8_t i = 1; i <= left_ary[0] && order == 0; i++) {
+        order = owl_terms_compare(left_ary[i], right_ary[i]);
+      }
+      return order;
+    }
+    case LIST:
     {
-      const char *left_str = owl_extract_ptr(left);
-      const char *right_str = owl_extract_ptr(right);
+      ListCursor left_cursor, right_cursor;
+      list_cursor_init(&left_cursor, left);
+      list_cursor_init(&right_cursor, right);
 
-      return strcmp(left_str, right_str) == 0;
+      while (list_cursor_has_next(&left_cursor) && list_cursor_has_next(&right_cursor)) {
+        order = owl_terms_compare(list_cursor_next(&left_cursor), list_cursor_next(&right_cursor));
+        if (order != 0) {
+          return order;
+        }
+      }
+      return list_cursor_has_next(&left_cursor) - list_cursor_has_next(&right_cursor);
     }
+    case MAP:
+      return maps_compare(left, right);
     default:
-      return false;
+      return owl_function_compare(left, right);
+  }
+}
+
+// Finalizer of MurmurHash3, spreads the bits of `hash` over all of them
+static uint64_t hash_mix(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// Equal terms hash the same: strings by their characters whether interned or
+// not, lists by their elements whatever the shape of their tree and maps and
+// sets by their entries. Functions hash by where their code is, which equal
+// functions share whatever their upvalues. Strings, lists, maps and sets keep
+// their hash once it has been worked out.
+uint64_t owl_term_hash(owl_term term) {
+  switch(term) {
+  case OWL_TRUE:
+  case OWL_FALSE:
+  case OWL_NIL:
+    return hash_mix(term);
+  }
+
+  switch(owl_tag_of(term)) {
+    case TUPLE:
+    {
+      owl_term *ary = owl_extract_ptr(term);
+      uint64_t hash = TUPLE;
+      for(uint8_t i = 1; i <= ary[0]; i++) {
+        hash = hash_mix(hash ^ owl_term_hash(ary[i]));
+      }
+      return hash;
+    }
+    case LIST:
+    {
+      uint64_t hash;
+      if (owl_list_cached_hash(term, &hash)) {
+        return hash;
+      }
+
+      hash = LIST;
+      ListCursor cursor;
+      list_cursor_init(&cursor, term);
+      while (list_cursor_has_next(&cursor)) {
+        hash = hash_mix(hash ^ owl_term_hash(list_cursor_next(&cursor)));
+      }
+      owl_list_cache_hash(term, hash);
+      return hash;
+    }
+    case STRING:
+    {
+      uint64_t hash;
+      if (owl_string_cached_hash(term, &hash)) {
+        return hash;
+      }
+
+      hash = hash_mix(owl_string_hash(term));
+      owl_string_cache_hash(term, hash);
+      return hash;
+    }
+    case FUNCTION:
+      return hash_mix(owl_term_to_function(term)->location);
+    case MAP:
+      return hash_mix((owl_map_is_set(term) ? ~MAP : MAP) ^ owl_map_hash(term));
+    default:
+      return hash_mix(term);
   }
 }
 
 #define print(t) fputs(t, stdout);
 
+typedef struct MapPrint {
+  vm_t *vm;
+  bool first;
+  bool set;
+} MapPrint;
+
+static void print_map_entry(owl_term key, owl_term value, void *context) {
+  MapPrint *printing = context;
+
+  if (!printing->first) {
+    print(", ");
+  }
+  printing->first = false;
+  owl_term_print(printing->vm, key);
+  if (!printing->set) {
+    print(" => ");
+    owl_term_print(printing->vm, value);
+  }
+}
+
 void owl_term_print(vm_t *vm, owl_term term) {
   switch(term) {
   case OWL_TRUE:
@@ -193,11 +455,12 @@ void owl_term_print(vm_t *vm, owl_term term) {
     }
     case LIST:
     {
-      uint64_t count = int_from_owl_int(owl_list_count(term));
+      ListCursor cursor;
+      list_cursor_init(&cursor, term);
       print("[");
-      for(uint64_t i = 0; i < count; i++) {
-        owl_term_print(vm, owl_list_nth(term, owl_int_from(i)));
-        if (i != count - 1) {
+      while (list_cursor_has_next(&cursor)) {
+        owl_term_print(vm, list_cursor_next(&cursor));
+        if (list_cursor_has_next(&cursor)) {
           print(", ");
         }
       }
@@ -205,11 +468,19 @@ void owl_term_print(vm_t *vm, owl_term term) {
       return;
     }
     case STRING:
-      print(owl_extract_ptr(term));
+      owl_string_print(term);
       return;
     case FUNCTION:
-      print(owl_extract_ptr(owl_function_name(term)));
+      print(owl_term_to_function(term)->name);
       return;
+    case MAP:
+    {
+      MapPrint printing = {vm, true, owl_map_is_set(term)};
+      print(printing.set ? "#{" : "%{");
+      owl_map_each(term, print_map_entry, &printing);
+      print("}");
+      return;
+    }
     default:
       print("???");
   }
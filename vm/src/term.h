@@ -31,7 +31,9 @@ owl_term owl_concat(vm_t *vm, owl_term left, owl_term right);
 owl_term owl_term_to_string(vm_t *vm, owl_term term);
 void owl_term_print(vm_t *vm, owl_term term);
 bool owl_terms_eq(owl_term left, owl_term right);
-owl_term owl_type_of(owl_term term);
+uint64_t owl_term_hash(owl_term term);
+int owl_terms_compare(owl_term left, owl_term right);
+const char* owl_type_name(owl_term term);
 owl_term owl_tuple_nth(owl_term tuple, uint8_t index);
 
 #endif  // TERM_H
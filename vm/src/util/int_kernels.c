@@ -0,0 +1,231 @@
+#include <string.h>
+
+#include "term.h"
+#include "util/int_kernels.h"
+
+// Loops over the children of list leaves, mostly of those marked LEAF_INTS.
+// On x86-64 they look at several terms at once: two with SSE2, which every
+// such CPU has, or four with AVX2 when the CPU the VM runs on supports it.
+// Whatever is left over, and everything on other architectures, goes through
+// the plain loops.
+//
+// The tag of an int sits below its value, so tagged ints are ordered the same
+// way as the values they hold and can be compared without untagging them.
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_SSE2 1
+#define AVX2 __attribute__((target("avx2")))
+#define avx2_supported() __builtin_cpu_supports("avx2")
+#endif
+
+// Every term is an int
+
+static bool ints_only_scalar(const owl_term *terms, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    if (owl_tag_of(terms[i]) != INT) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#ifdef HAVE_SSE2
+static bool ints_only_sse2(const owl_term *terms, uint32_t n) {
+  const __m128i mask = _mm_set1_epi64x(0x7);
+  const __m128i tag = _mm_set1_epi64x(INT);
+  uint32_t i = 0;
+
+  // The upper halves of the masked lanes are zero either way
+  for (; i + 2 <= n; i += 2) {
+    __m128i tags = _mm_and_si128(_mm_loadu_si128((const __m128i *) &terms[i]), mask);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(tags, tag)) != 0xFFFF) {
+      return false;
+    }
+  }
+  return ints_only_scalar(terms + i, n - i);
+}
+
+AVX2 static bool ints_only_avx2(const owl_term *terms, uint32_t n) {
+  const __m256i mask = _mm256_set1_epi64x(0x7);
+  const __m256i tag = _mm256_set1_epi64x(INT);
+  uint32_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    __m256i tags = _mm256_and_si256(_mm256_loadu_si256((const __m256i *) &terms[i]), mask);
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(tags, tag)) != -1) {
+      return false;
+    }
+  }
+  return ints_only_scalar(terms + i, n - i);
+}
+#endif
+
+bool ints_only(const owl_term *terms, uint32_t n) {
+#ifdef HAVE_SSE2
+  return avx2_supported() ? ints_only_avx2(terms, n) : ints_only_sse2(terms, n);
+#else
+  return ints_only_scalar(terms, n);
+#endif
+}
+
+// Sum of the values, wrapping around like OP_ADD does
+
+static uint64_t ints_sum_scalar(const owl_term *ints, uint32_t n) {
+  uint64_t sum = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    sum += int_from_owl_int(ints[i]);
+  }
+  return sum;
+}
+
+#ifdef HAVE_SSE2
+static uint64_t ints_sum_sse2(const owl_term *ints, uint32_t n) {
+  __m128i sums = _mm_setzero_si128();
+  uint32_t i = 0;
+
+  for (; i + 2 <= n; i += 2) {
+    __m128i values = _mm_srli_epi64(_mm_loadu_si128((const __m128i *) &ints[i]), 3);
+    sums = _mm_add_epi64(sums, values);
+  }
+
+  uint64_t lanes[2];
+  _mm_storeu_si128((__m128i *) lanes, sums);
+  return lanes[0] + lanes[1] + ints_sum_scalar(ints + i, n - i);
+}
+
+AVX2 static uint64_t ints_sum_avx2(const owl_term *ints, uint32_t n) {
+  __m256i sums = _mm256_setzero_si256();
+  uint32_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    __m256i values = _mm256_srli_epi64(_mm256_loadu_si256((const __m256i *) &ints[i]), 3);
+    sums = _mm256_add_epi64(sums, values);
+  }
+
+  uint64_t lanes[4];
+  _mm256_storeu_si256((__m256i *) lanes, sums);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + ints_sum_scalar(ints + i, n - i);
+}
+#endif
+
+uint64_t ints_sum(const owl_term *ints, uint32_t n) {
+#ifdef HAVE_SSE2
+  return avx2_supported() ? ints_sum_avx2(ints, n) : ints_sum_sse2(ints, n);
+#else
+  return ints_sum_scalar(ints, n);
+#endif
+}
+
+// Largest or smallest of at least one int. SSE2 has no 64 bit comparisons, so
+// only AVX2 gets a vectorised version.
+
+static owl_term ints_extreme_scalar(const owl_term *ints, uint32_t n, owl_term best, bool max) {
+  for (uint32_t i = 0; i < n; i++) {
+    if (max ? ints[i] > best : ints[i] < best) {
+      best = ints[i];
+    }
+  }
+  return best;
+}
+
+#ifdef HAVE_SSE2
+AVX2 static owl_term ints_extreme_avx2(const owl_term *ints, uint32_t n, bool max) {
+  if (n < 8) {
+    return ints_extreme_scalar(ints, n, ints[0], max);
+  }
+
+  // Flipping the top bit makes the signed comparison order them as unsigned
+  const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+  __m256i best = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) ints), bias);
+  uint32_t i = 4;
+
+  for (; i + 4 <= n; i += 4) {
+    __m256i next = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) &ints[i]), bias);
+    __m256i better = max ? _mm256_cmpgt_epi64(next, best) : _mm256_cmpgt_epi64(best, next);
+    best = _mm256_blendv_epi8(best, next, better);
+  }
+
+  owl_term lanes[4];
+  _mm256_storeu_si256((__m256i *) lanes, _mm256_xor_si256(best, bias));
+  owl_term found = ints_extreme_scalar(lanes + 1, 3, lanes[0], max);
+  return ints_extreme_scalar(ints + i, n - i, found, max);
+}
+#endif
+
+static owl_term ints_extreme(const owl_term *ints, uint32_t n, bool max) {
+#ifdef HAVE_SSE2
+  if (avx2_supported()) {
+    return ints_extreme_avx2(ints, n, max);
+  }
+#endif
+  return ints_extreme_scalar(ints + 1, n - 1, ints[0], max);
+}
+
+owl_term ints_max(const owl_term *ints, uint32_t n) {
+  return ints_extreme(ints, n, true);
+}
+
+owl_term ints_min(const owl_term *ints, uint32_t n) {
+  return ints_extreme(ints, n, false);
+}
+
+// Same terms in the same order. Only tells equal lists apart from unequal ones
+// if neither holds anything but ints. The C library vectorises this already.
+
+bool terms_identical(const owl_term *left, const owl_term *right, uint32_t n) {
+  return memcmp(left, right, n * sizeof(owl_term)) == 0;
+}
+
+// Index of the first occurrence of `term` itself, or -1. Finds equal ints, but
+// not equal strings, tuples or lists that are stored elsewhere.
+
+static int64_t terms_index_of_scalar(const owl_term *terms, uint32_t from, uint32_t n, owl_term term) {
+  for (uint32_t i = from; i < n; i++) {
+    if (terms[i] == term) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+#ifdef HAVE_SSE2
+static int64_t terms_index_of_sse2(const owl_term *terms, uint32_t n, owl_term term) {
+  const __m128i needle = _mm_set1_epi64x(term);
+  uint32_t i = 0;
+
+  // A lane matches if both of its halves do
+  for (; i + 2 <= n; i += 2) {
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *) &terms[i]), needle));
+    if ((mask & 0xFF) == 0xFF) {
+      return i;
+    }
+    if ((mask >> 8) == 0xFF) {
+      return i + 1;
+    }
+  }
+  return terms_index_of_scalar(terms, i, n, term);
+}
+
+AVX2 static int64_t terms_index_of_avx2(const owl_term *terms, uint32_t n, owl_term term) {
+  const __m256i needle = _mm256_set1_epi64x(term);
+  uint32_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    __m256i found = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *) &terms[i]), needle);
+    int mask = _mm256_movemask_pd(_mm256_castsi256_pd(found));
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return terms_index_of_scalar(terms, i, n, term);
+}
+#endif
+
+int64_t terms_index_of(const owl_term *terms, uint32_t n, owl_term term) {
+#ifdef HAVE_SSE2
+  return avx2_supported() ? terms_index_of_avx2(terms, n, term) : terms_index_of_sse2(terms, n, term);
+#else
+  return terms_index_of_scalar(terms, 0, n, term);
+#endif
+}
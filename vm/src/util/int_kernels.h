@@ -0,0 +1,14 @@
+#ifndef UTIL_INT_KERNELS_H
+#define UTIL_INT_KERNELS_H 1
+
+#include <stdbool.h>
+#include "owl.h"
+
+bool ints_only(const owl_term *terms, uint32_t n);
+uint64_t ints_sum(const owl_term *ints, uint32_t n);
+owl_term ints_max(const owl_term *ints, uint32_t n);
+owl_term ints_min(const owl_term *ints, uint32_t n);
+bool terms_identical(const owl_term *left, const owl_term *right, uint32_t n);
+int64_t terms_index_of(const owl_term *terms, uint32_t n, owl_term term);
+
+#endif  // UTIL_INT_KERNELS_H
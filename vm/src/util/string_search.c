@@ -0,0 +1,286 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "util/string_search.h"
+
+// Finds the first place a string occurs in another. Strings may hold NULs, so
+// this goes by lengths rather than strstr.
+//
+// Needles are looked for by their first and last bytes, at 16 places at once
+// with SSE2, or 32 with AVX2 when the CPU the VM runs on supports it. The bytes
+// in between are only compared where both of those match, which in most text
+// is rarely, for short and long needles alike. Where the two bytes turn up a
+// lot without the rest of the needle, say in a run of the same byte, that
+// could take time proportional to the lengths of both strings. Every place
+// that gets compared is counted as the whole length of the needle, and once
+// that adds up to more than the bytes searched so far, and a few needle
+// lengths on top, the rest of the haystack goes through the Two-Way algorithm
+// instead, which never looks at a byte of the haystack more than twice. Either
+// way the search takes time linear in the lengths of the two. Single bytes are
+// left to memchr, which the C library vectorises already.
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_SSE2 1
+#define AVX2 __attribute__((target("avx2")))
+#define avx2_supported() __builtin_cpu_supports("avx2")
+#endif
+
+#define MAX(a,b) (((a)>(b))?(a):(b))
+
+// Places where the first and last bytes match without the rest of the needle
+// that may be compared before Two-Way takes over, on top of one for every
+// needle length searched. Setting up Two-Way takes about as long as these.
+#define ALLOWED_MISMATCHES 4
+
+// TWO-WAY
+//
+// From "Two-way string-matching" by Crochemore and Perrin. The needle is split
+// in two where its left and right parts have no period in common. The right
+// part is compared first, from left to right, and a mismatch there moves the
+// needle past it. Only once all of it matches is the left part compared, from
+// right to left, and a mismatch there moves the needle by the period of the
+// needle. Indexes that count down past 0 wrap around to SIZE_MAX.
+//
+// Wherever the first byte of the right part is not where it would have to be,
+// memchr finds the next place it is, which saves going through runs of bytes
+// that no occurrence could start at one at a time.
+
+// Where the split goes, with the period of the needle
+static size_t critical_factorization(const uint8_t *needle, size_t needle_length, size_t *period) {
+  size_t suffixes[2];
+  size_t periods[2];
+
+  // The maximal suffix with bytes ordered one way and then the other
+  for (int reverse = 0; reverse < 2; reverse++) {
+    size_t suffix = SIZE_MAX, j = 0, k = 1, p = 1;
+
+    while (j + k < needle_length) {
+      uint8_t a = needle[j + k];
+      uint8_t b = needle[suffix + k];
+
+      if (reverse ? b < a : a < b) {
+        j += k;
+        k = 1;
+        p = j - suffix;
+      } else if (a == b) {
+        if (k != p) {
+          k++;
+        } else {
+          j += p;
+          k = 1;
+        }
+      } else {
+        suffix = j++;
+        k = p = 1;
+      }
+    }
+    suffixes[reverse] = suffix;
+    periods[reverse] = p;
+  }
+
+  int longer = suffixes[1] + 1 < suffixes[0] + 1 ? 0 : 1;
+  *period = periods[longer];
+  return suffixes[longer] + 1;
+}
+
+// The smallest start past `j` that would put the first byte of the right part,
+// at `split`, where that byte is in the haystack. Past the end if there is none.
+static size_t next_split_byte(const uint8_t *haystack, size_t length, const uint8_t *needle, size_t split, size_t j) {
+  const uint8_t *next = memchr(haystack + j + split + 1, needle[split], length - (j + split + 1));
+  return next ? (size_t) (next - haystack) - split : length;
+}
+
+static int64_t search_two_way(const uint8_t *haystack, size_t length, const uint8_t *needle, size_t needle_length, size_t from) {
+  size_t period;
+  size_t split = critical_factorization(needle, needle_length, &period);
+  size_t i, j = from;
+
+  if (memcmp(needle, needle + period, split) == 0) {
+    // The whole needle repeats with the period, so after a match of the right
+    // part the bytes that the needle moves past again are known to match
+    size_t memory = 0;
+
+    while (j + needle_length <= length) {
+      i = MAX(split, memory);
+      while (i < needle_length && needle[i] == haystack[i + j]) {
+        i++;
+      }
+      if (i < needle_length) {
+        j = i == split ? next_split_byte(haystack, length, needle, split, j) : j + i - split + 1;
+        memory = 0;
+        continue;
+      }
+
+      i = split - 1;
+      while (memory < i + 1 && needle[i] == haystack[i + j]) {
+        i--;
+      }
+      if (i + 1 < memory + 1) {
+        return j;
+      }
+      j += period;
+      memory = needle_length - period;
+    }
+  } else {
+    // Any mismatch in the left part moves the needle as far as it can go
+    period = MAX(split, needle_length - split) + 1;
+
+    while (j + needle_length <= length) {
+      i = split;
+      while (i < needle_length && needle[i] == haystack[i + j]) {
+        i++;
+      }
+      if (i < needle_length) {
+        j = i == split ? next_split_byte(haystack, length, needle, split, j) : j + i - split + 1;
+        continue;
+      }
+
+      i = split - 1;
+      while (i != SIZE_MAX && needle[i] == haystack[i + j]) {
+        i--;
+      }
+      if (i == SIZE_MAX) {
+        return j;
+      }
+      j += period;
+    }
+  }
+  return -1;
+}
+
+static int64_t two_way(const char *haystack, uint32_t length, const char *needle, uint32_t needle_length, uint32_t from) {
+  return search_two_way((const uint8_t *) haystack, length, (const uint8_t *) needle, needle_length, from);
+}
+
+static inline bool over_budget(uint64_t compared, uint32_t searched, uint32_t needle_length) {
+  return compared > (uint64_t) ALLOWED_MISMATCHES * needle_length + searched;
+}
+
+// FIRST AND LAST BYTES
+//
+// Needles are at least 2 bytes long and no longer than the haystack
+
+static int64_t search_scalar(const char *haystack, uint32_t length, const char *needle, uint32_t needle_length, uint32_t from, uint64_t compared) {
+  const char *at = haystack + from;
+  const char *last = haystack + (length - needle_length);
+
+  while (at <= last && (at = memchr(at, needle[0], last - at + 1)) != NULL) {
+    if (at[needle_length - 1] == needle[needle_length - 1] && memcmp(at + 1, needle + 1, needle_length - 2) == 0) {
+      return at - haystack;
+    }
+    compared += needle_length;
+    if (over_budget(compared, at - haystack, needle_length)) {
+      return two_way(haystack, length, needle, needle_length, at - haystack + 1);
+    }
+    at++;
+  }
+  return -1;
+}
+
+#ifdef HAVE_SSE2
+// Looks for the whole needle at the places set in `mask`, counted from `i`.
+// Returns true once the search is over, with where the needle is, if anywhere,
+// in `found`.
+static inline bool verify(const char *haystack, uint32_t length, const char *needle, uint32_t needle_length,
+                          uint32_t i, uint32_t mask, uint64_t *compared, int64_t *found) {
+  for (; mask; mask &= mask - 1) {
+    uint32_t at = i + __builtin_ctz(mask);
+    if (memcmp(haystack + at + 1, needle + 1, needle_length - 2) == 0) {
+      *found = at;
+      return true;
+    }
+    *compared += needle_length;
+    if (over_budget(*compared, at, needle_length)) {
+      *found = two_way(haystack, length, needle, needle_length, at + 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint32_t candidates_sse2(const char *at, uint32_t needle_length, __m128i first, __m128i last) {
+  __m128i starts = _mm_loadu_si128((const __m128i *) at);
+  __m128i ends = _mm_loadu_si128((const __m128i *) (at + needle_length - 1));
+  return _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(starts, first), _mm_cmpeq_epi8(ends, last)));
+}
+
+static int64_t search_sse2(const char *haystack, uint32_t length, const char *needle, uint32_t needle_length) {
+  // Places where the needle could start
+  uint32_t end = length - needle_length + 1;
+  if (end < 16) {
+    return search_scalar(haystack, length, needle, needle_length, 0, 0);
+  }
+
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[needle_length - 1]);
+  uint64_t compared = 0;
+  int64_t found = -1;
+  uint32_t i = 0;
+
+  for (; i + 16 <= end; i += 16) {
+    uint32_t mask = candidates_sse2(haystack + i, needle_length, first, last);
+    if (verify(haystack, length, needle, needle_length, i, mask, &compared, &found)) {
+      return found;
+    }
+  }
+  // The places left over, in a block that overlaps the last one
+  if (i < end) {
+    uint32_t mask = candidates_sse2(haystack + end - 16, needle_length, first, last) & (0xFFFF << (i - (end - 16)));
+    verify(haystack, length, needle, needle_length, end - 16, mask, &compared, &found);
+  }
+  return found;
+}
+
+AVX2 static uint32_t candidates_avx2(const char *at, uint32_t needle_length, __m256i first, __m256i last) {
+  __m256i starts = _mm256_loadu_si256((const __m256i *) at);
+  __m256i ends = _mm256_loadu_si256((const __m256i *) (at + needle_length - 1));
+  return _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(starts, first), _mm256_cmpeq_epi8(ends, last)));
+}
+
+AVX2 static int64_t search_avx2(const char *haystack, uint32_t length, const char *needle, uint32_t needle_length) {
+  uint32_t end = length - needle_length + 1;
+  if (end < 32) {
+    return search_sse2(haystack, length, needle, needle_length);
+  }
+
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[needle_length - 1]);
+  uint64_t compared = 0;
+  int64_t found = -1;
+  uint32_t i = 0;
+
+  for (; i + 32 <= end; i += 32) {
+    uint32_t mask = candidates_avx2(haystack + i, needle_length, first, last);
+    if (verify(haystack, length, needle, needle_length, i, mask, &compared, &found)) {
+      return found;
+    }
+  }
+  if (i < end) {
+    uint32_t mask = candidates_avx2(haystack + end - 32, needle_length, first, last) & (0xFFFFFFFFu << (i - (end - 32)));
+    verify(haystack, length, needle, needle_length, end - 32, mask, &compared, &found);
+  }
+  return found;
+}
+#endif
+
+// Index of the first byte of the first occurrence of `needle`, or -1
+int64_t string_search(const char *haystack, uint32_t length, const char *needle, uint32_t needle_length) {
+  if (needle_length == 0) {
+    return 0;
+  }
+  if (needle_length > length) {
+    return -1;
+  }
+  if (needle_length == 1) {
+    const char *found = memchr(haystack, needle[0], length);
+    return found ? found - haystack : -1;
+  }
+
+#ifdef HAVE_SSE2
+  return avx2_supported() ? search_avx2(haystack, length, needle, needle_length) : search_sse2(haystack, length, needle, needle_length);
+#else
+  return search_scalar(haystack, length, needle, needle_length, 0, 0);
+#endif
+}
@@ -0,0 +1,8 @@
+#ifndef UTIL_STRING_SEARCH_H
+#define UTIL_STRING_SEARCH_H 1
+
+#include <stdint.h>
+
+int64_t string_search(const char *haystack, uint32_t length, const char *needle, uint32_t needle_length);
+
+#endif  // UTIL_STRING_SEARCH_H
@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "term.h"
+#include "util/term_sort.h"
+
+// Stable sorting of items by their keys, in the order of owl_terms_compare.
+//
+// Items with nothing but ints for keys are radix sorted. Anything else goes
+// through a merge sort along the lines of Timsort: it looks for runs that are
+// in order already, or in reverse order, extends short ones with an insertion
+// sort and merges them pairwise, keeping the lengths of the runs waiting to be
+// merged such that merges stay balanced. Input that is mostly in order takes
+// close to a single pass.
+//
+// Comparing terms never allocates, so nothing moves while sorting.
+
+#define MIN_MERGE 32                     // Shorter inputs are only insertion sorted
+#define MAX_RUNS 64                      // Enough for any 32 bit length, see merge_collapse
+#define RADIX_MIN 64                     // Fewer ints are not worth counting bytes for
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+
+static void* checked_malloc(size_t size) {
+  void *memory = malloc(size);
+  if (memory == NULL) {
+    puts("Unable to allocate memory for sorting");
+    exit(1);
+  }
+  return memory;
+}
+
+static inline bool item_less(const SortItem *left, const SortItem *right) {
+  return owl_terms_compare(left->key, right->key) < 0;
+}
+
+// RADIX SORT
+//
+// The tag of an int sits below its value, so tagged ints are ordered the same
+// way as the values they hold. Bytes that are the same in every key, like the
+// high ones of small ints, do not get a pass.
+
+static bool keys_ints_only(const SortItem *items, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    if (owl_tag_of(items[i].key) != INT) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void radix_sort(SortItem *items, uint32_t n) {
+  uint32_t counts[8][256] = {{0}};
+
+  for (uint32_t i = 0; i < n; i++) {
+    for (uint32_t byte = 0; byte < 8; byte++) {
+      counts[byte][(items[i].key >> (byte * 8)) & 0xFF]++;
+    }
+  }
+
+  SortItem *buffer = checked_malloc(n * sizeof(SortItem));
+  SortItem *from = items;
+  SortItem *to = buffer;
+
+  for (uint32_t byte = 0; byte < 8; byte++) {
+    uint32_t *count = counts[byte];
+    if (count[(items[0].key >> (byte * 8)) & 0xFF] == n) {
+      continue;
+    }
+
+    uint32_t offset = 0;
+    for (uint32_t digit = 0; digit < 256; digit++) {
+      uint32_t digits = count[digit];
+      count[digit] = offset;
+      offset += digits;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      to[count[(from[i].key >> (byte * 8)) & 0xFF]++] = from[i];
+    }
+
+    SortItem *swap = from;
+    from = to;
+    to = swap;
+  }
+
+  if (from != items) {
+    memcpy(items, from, n * sizeof(SortItem));
+  }
+  free(buffer);
+}
+
+// MERGE SORT
+
+// Sorts `items` given that the first `sorted` of them are in order already
+static void insertion_sort(SortItem *items, uint32_t n, uint32_t sorted) {
+  for (uint32_t i = sorted; i < n; i++) {
+    SortItem item = items[i];
+
+    // After any equal ones, which keeps it stable
+    uint32_t low = 0, high = i;
+    while (low < high) {
+      uint32_t mid = low + (high - low) / 2;
+      if (item_less(&item, &items[mid])) {
+        high = mid;
+      } else {
+        low = mid + 1;
+      }
+    }
+
+    memmove(&items[low + 1], &items[low], (i - low) * sizeof(SortItem));
+    items[low] = item;
+  }
+}
+
+// Length of the run starting at `items`, which is put in order if it was in
+// strictly descending order. Equal items never reverse, which keeps it stable.
+static uint32_t run_length(SortItem *items, uint32_t n) {
+  if (n < 2) {
+    return n;
+  }
+
+  uint32_t length = 2;
+  if (item_less(&items[1], &items[0])) {
+    while (length < n && item_less(&items[length], &items[length - 1])) {
+      length++;
+    }
+    for (uint32_t i = 0, j = length - 1; i < j; i++, j--) {
+      SortItem swap = items[i];
+      items[i] = items[j];
+      items[j] = swap;
+    }
+  } else {
+    while (length < n && !item_less(&items[length], &items[length - 1])) {
+      length++;
+    }
+  }
+  return length;
+}
+
+// Runs shorter than this are extended, such that the number of runs is a power
+// of two or just below one
+static uint32_t min_run_length(uint32_t n) {
+  uint32_t low_bits = 0;
+  while (n >= MIN_MERGE) {
+    low_bits |= n & 1;
+    n >>= 1;
+  }
+  return n + low_bits;
+}
+
+typedef struct MergeState {
+  SortItem *items;
+  SortItem *buffer;                    // Room for the shorter half of any merge
+  uint32_t n_runs;
+  uint32_t run_start[MAX_RUNS];
+  uint32_t run_length[MAX_RUNS];
+} MergeState;
+
+// Merges runs `i` and `i + 1`
+static void merge_at(MergeState *state, uint32_t i) {
+  SortItem *left = state->items + state->run_start[i];
+  uint32_t left_n = state->run_length[i];
+  SortItem *right = left + left_n;
+  uint32_t right_n = state->run_length[i + 1];
+
+  state->run_length[i] = left_n + right_n;
+  if (i + 2 < state->n_runs) {
+    state->run_start[i + 1] = state->run_start[i + 2];
+    state->run_length[i + 1] = state->run_length[i + 2];
+  }
+  state->n_runs--;
+
+  // Items of the left run that are not greater than the first one on the
+  // right, and of the right run that are less than the last one on the left,
+  // stay where they are
+  while (left_n > 0 && !item_less(&right[0], &left[0])) {
+    left++;
+    left_n--;
+  }
+  while (right_n > 0 && left_n > 0 && !item_less(&right[right_n - 1], &left[left_n - 1])) {
+    right_n--;
+  }
+  if (left_n == 0 || right_n == 0) {
+    return;
+  }
+
+  if (left_n <= right_n) {
+    // Forwards, out of the buffered left run and the right one in place
+    memcpy(state->buffer, left, left_n * sizeof(SortItem));
+    SortItem *l = state->buffer, *l_end = state->buffer + left_n;
+    SortItem *r = right, *r_end = right + right_n;
+    SortItem *out = left;
+
+    while (l < l_end && r < r_end) {
+      *out++ = item_less(r, l) ? *r++ : *l++;
+    }
+    memcpy(out, l, (l_end - l) * sizeof(SortItem));
+  } else {
+    // Backwards, out of the left run in place and the buffered right one
+    memcpy(state->buffer, right, right_n * sizeof(SortItem));
+    SortItem *l = left + left_n, *r = state->buffer + right_n;
+    SortItem *out = right + right_n;
+
+    while (l > left && r > state->buffer) {
+      *--out = item_less(r - 1, l - 1) ? *--l : *--r;
+    }
+    memcpy(left, state->buffer, (r - state->buffer) * sizeof(SortItem));
+  }
+}
+
+// Merges until, from the bottom of the stack up, every run is longer than the
+// two above it together, and longer than the one above it. Run lengths then
+// grow at least as fast as the Fibonacci numbers going down the stack.
+static void merge_collapse(MergeState *state) {
+  while (state->n_runs > 1) {
+    uint32_t k = state->n_runs - 2;
+    uint32_t *length = state->run_length;
+
+    if ((k > 0 && length[k - 1] <= length[k] + length[k + 1]) ||
+        (k > 1 && length[k - 2] <= length[k - 1] + length[k])) {
+      if (length[k - 1] < length[k + 1]) {
+        k--;
+      }
+    } else if (length[k] > length[k + 1]) {
+      break;
+    }
+    merge_at(state, k);
+  }
+}
+
+static void merge_sort(SortItem *items, uint32_t n) {
+  if (n < MIN_MERGE) {
+    insertion_sort(items, n, run_length(items, n));
+    return;
+  }
+
+  MergeState state = {.items = items, .buffer = checked_malloc((n / 2 + 1) * sizeof(SortItem)), .n_runs = 0};
+  const uint32_t min_run = min_run_length(n);
+  uint32_t start = 0;
+
+  while (start < n) {
+    uint32_t length = run_length(items + start, n - start);
+    if (length < min_run) {
+      uint32_t extended = MIN(min_run, n - start);
+      insertion_sort(items + start, extended, length);
+      length = extended;
+    }
+
+    state.run_start[state.n_runs] = start;
+    state.run_length[state.n_runs] = length;
+    state.n_runs++;
+    merge_collapse(&state);
+    start += length;
+  }
+
+  while (state.n_runs > 1) {
+    uint32_t k = state.n_runs - 2;
+    if (k > 0 && state.run_length[k - 1] < state.run_length[k + 1]) {
+      k--;
+    }
+    merge_at(&state, k);
+  }
+  free(state.buffer);
+}
+
+void items_sort(SortItem *items, uint32_t n) {
+  if (n >= RADIX_MIN && keys_ints_only(items, n)) {
+    radix_sort(items, n);
+  } else {
+    merge_sort(items, n);
+  }
+}
@@ -0,0 +1,14 @@
+#ifndef UTIL_TERM_SORT_H
+#define UTIL_TERM_SORT_H 1
+
+#include "owl.h"
+
+// A term to sort and what to sort it by, which may be the term itself
+typedef struct SortItem {
+  owl_term key;
+  owl_term term;
+} SortItem;
+
+void items_sort(SortItem *items, uint32_t n);
+
+#endif  // UTIL_TERM_SORT_H
@@ -2,11 +2,16 @@
 #include <string.h>
 #include <stdio.h>
 #include <dirent.h>
+#include <assert.h>
 
 #include "vm.h"
+#include "term.h"
 #include "opcodes.h"
+#include "alloc.h"
+#include "heap_profile.h"
 #include "util/file.h"
 #include "std/owl_code.h"
+#include "std/owl_function.h"
 
 GCState* gc_init(uint64_t size) {
   GCState* gc = malloc(sizeof(GCState));
@@ -16,6 +21,66 @@ GCState* gc_init(uint64_t size) {
   gc->from_space = mem + size / 2;
   gc->alloc_ptr = gc->to_space;
   gc->size = size;
+  gc->threads = 1;
+  gc->pool = NULL;
+  gc->large_objects = NULL;
+  gc->large_count = 0;
+  gc->large_capacity = 0;
+  gc->large_bytes = 0;
+  gc->large_limit = size;
+  gc->pause_budget = 0;
+  gc->cycle_active = false;
+  gc->forwards = NULL;
+  gc->gray = NULL;
+  gc->gray_count = 0;
+  gc->gray_capacity = 0;
+  memset(gc->pauses, 0, sizeof(gc->pauses));
+  gc->max_pause = 0;
+  memset(&gc->stats, 0, sizeof(GCStats));
+  gc->stats.started_at = gc_clock();
+  gc->log = getenv("OWL_GC_LOG") != NULL;
+  gc->immortal = false;
+  gc->immortal_ptr = NULL;
+  gc->immortal_end = NULL;
+  gc->immix = NULL;
+  gc->profile = NULL;
+  gc->dedup = NULL;
+  gc->compaction = NULL;
+
+  char *threads = getenv("OWL_GC_THREADS");
+  if (threads && atoi(threads) > 1) {
+    gc->threads = atoi(threads);
+  }
+
+  // Pause budget in microseconds, turns on incremental collection
+  char *pause_budget = getenv("OWL_GC_PAUSE_BUDGET");
+  if (pause_budget && atoi(pause_budget) > 0) {
+    gc->pause_budget = atoi(pause_budget) * 1000ULL;
+    gc->forwards = calloc(size / 2 / 8 + 1, sizeof(void*));
+  }
+
+  // Mark-region instead of semispace copying, takes precedence over the options above
+  char *collector = getenv("OWL_GC");
+  if (collector && strcmp(collector, "immix") == 0) {
+    gc_immix_init(gc);
+  }
+
+  // Share one copy between equal strings at least this long, serial and incremental collections only
+  char *dedup = getenv("OWL_GC_DEDUP");
+  if (dedup) {
+    gc->dedup = gc_dedup_new(atoi(dedup));
+  }
+
+  // Rebuild concatenated and sliced lists with full leaves, serial collections only
+  if (getenv("OWL_GC_COMPACT_LISTS")) {
+    gc->compaction = gc_compaction_new();
+  }
+
+  char *profile = getenv("OWL_HEAP_PROFILE");
+  if (profile) {
+    char *rate = getenv("OWL_HEAP_PROFILE_RATE");
+    gc->profile = heap_profile_new(profile, rate ? atoll(rate) : 0);
+  }
 
   return gc;
 }
@@ -36,17 +101,32 @@ vm_t *vm_new() {
   memset(vm->code, '\0', 0xFFFF);
   vm->code_size = 0;
 
-  // Allocate a 64k heap
-  GCState* gc = gc_init(0xFFFF * 2);
+  // Allocate a 64k heap unless told otherwise
+  uint64_t heap_size = 0xFFFF * 2;
+  char *configured_size = getenv("OWL_HEAP_SIZE");
+  if (configured_size && atoll(configured_size) > 0) {
+    heap_size = atoll(configured_size);
+  }
+
+  GCState* gc = gc_init(heap_size);
   vm->gc = gc;
 
   vm->function_names = strings_new();
   vm->intern_pool = strings_new();
+  memset(vm->interned_strings, 0, sizeof(vm->interned_strings));
   vm->ip = 0;
+  vm->instruction = 0;
   vm->current_frame = 0;
   vm->current_function = NULL;
   memset(vm->functions, NO_FUNCTION, MAX_FUNCTIONS * sizeof(uint64_t));
 
+  // Threads to run List.pmap and List.preduce on, including this one
+  vm->threads = 1;
+  char *threads = getenv("OWL_THREADS");
+  if (threads && atoi(threads) > 1) {
+    vm->threads = atoi(threads) < MAX_THREADS ? atoi(threads) : MAX_THREADS;
+  }
+
   opcode_init(vm);
 
   return vm;
@@ -117,6 +197,18 @@ void vm_load_module(vm_t *vm, const char *module_name) {
 }
 
 void vm_run(vm_t *vm) {
+  // Opcodes move the instruction pointer along as they decode, so the profiler
+  // would not know which instruction allocated otherwise
+  if (vm->gc->profile) {
+    while (true) {
+      int opcode = vm->code[vm->ip];
+      vm->instruction = vm->ip;
+
+      if (vm->opcodes[opcode] != NULL)
+        vm->opcodes[opcode] (vm);
+    }
+  }
+
   while (true) {
     int opcode = vm->code[vm->ip];
 
@@ -126,6 +218,82 @@ void vm_run(vm_t *vm) {
   }
 }
 
+// Calls an Owl function from native code and returns its result once it has
+// returned. Only to be used by opcodes that the compiler treats as safepoints,
+// with the instruction pointer left at the start of the instruction: its frame
+// is suspended there just like for a call, and the collector may run before the
+// function is entered as well as while it runs. Anything the caller still needs
+// afterwards has to be rooted with vm_root.
+owl_term vm_call(vm_t *vm, owl_term function, uint8_t argc, const owl_term *args) {
+  if (owl_tag_of(function) != FUNCTION) {
+    printf("TypeError: expected Function, got %s\n", owl_type_name(function));
+    exit(1);
+  }
+
+  unsigned int caller = vm->current_frame;
+  unsigned int ip = vm->ip;
+  unsigned int instruction = vm->instruction;
+  assert(caller + 1 < STACK_DEPTH);
+
+  owl_term *rooted = vm_root(vm, function);
+  for (uint8_t i = 0; i < argc; i++) {
+    vm_root(vm, args[i]);
+  }
+  gc_safepoint(vm);
+
+  Function *fun = owl_term_to_function(rooted[0]);
+  frame_t *frame = &vm->frames[caller + 1];
+  frame->registers[0] = 0;             // See setup_next_stackframe
+  for (uint8_t i = 0; i < argc; i++) {
+    frame->registers[i + 1] = rooted[i + 1];
+  }
+  vm_unroot(vm, argc + 1);
+
+  frame->ret_address = gc_return_address(vm, ip);
+  frame->ret_register = NATIVE_RETURN;
+  frame->function = fun;
+  vm->current_frame += 1;
+  vm->current_function = fun;
+  vm->ip = fun->location;
+
+  // Runs until the function returns into the frame that called it
+  while (vm->current_frame > caller) {
+    int opcode = vm->code[vm->ip];
+    vm->instruction = vm->ip;
+
+    vm->opcodes[opcode] (vm);
+  }
+
+  vm->ip = ip;
+  vm->instruction = instruction;
+  return vm->frames[caller].registers[NATIVE_RETURN];
+}
+
+// Keeps `term` alive and up to date across vm_call until vm_unroot. Read it
+// through the returned slot, the collector may move it.
+owl_term* vm_root(vm_t *vm, owl_term term) {
+  assert(vm->native_root_count < NATIVE_ROOTS);
+
+  owl_term *root = &vm->native_roots[vm->native_root_count++];
+  vm_root_set(vm, root, term);
+  return root;
+}
+
+// Stores into a rooted slot, telling a running cycle about the new reference
+// like set_reg does for registers
+void vm_root_set(vm_t *vm, owl_term *root, owl_term term) {
+  *root = term;
+
+  if (vm->gc->cycle_active) {
+    gc_write_barrier(vm, term);
+  }
+}
+
+// Releases the `n` most recently rooted terms
+void vm_unroot(vm_t *vm, uint32_t n) {
+  vm->native_root_count -= n;
+}
+
 void vm_run_function(vm_t *vm, const char *function_name) {
   uint8_t function_id = strings_lookup(vm->function_names, function_name);
 
@@ -136,6 +304,8 @@ void vm_run_function(vm_t *vm, const char *function_name) {
     };
 
     memcpy(&vm->code[vm->code_size], &call_code, 6);
+    // Nothing is live in the bottom frame while the function runs
+    gc_add_live_map(vm, vm->code_size, vm->code_size + 4, NULL, 0);
     vm->ip = vm->code_size;
     vm->code_size += 6;
     vm_run(vm);
@@ -7,5 +7,9 @@ vm_t *vm_new();
 void vm_load_module_from_file(vm_t *vm, const char *filename);
 void vm_load_module(vm_t *vm, const char *module_name);
 void vm_run_function(vm_t *vm, const char *function_name);
+owl_term vm_call(vm_t *vm, owl_term function, uint8_t argc, const owl_term *args);
+owl_term* vm_root(vm_t *vm, owl_term term);
+void vm_root_set(vm_t *vm, owl_term *root, owl_term term);
+void vm_unroot(vm_t *vm, uint32_t n);
 
 #endif // VM_H
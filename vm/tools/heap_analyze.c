@@ -0,0 +1,341 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "heap_dump.h"
+
+// Reads a snapshot written by VM.heap_dump and reports, per type of object, how
+// much memory the objects of that type keep alive, along with the objects that
+// keep alive the most.
+//
+// An object dominates another when every path from the roots to the other goes
+// through it. What an object retains is everything it dominates, which is what
+// would be freed if it went away. Dominators are found with the iterative
+// algorithm from "A Simple, Fast Dominance Algorithm" by Cooper, Harvey and
+// Kennedy.
+
+#define DEFAULT_TOP 10
+#define NONE UINT32_MAX
+
+static const char *type_names[HEAP_DUMP_TYPE_COUNT] = {
+  "roots", "tuple", "list", "list node", "size table", "string", "function", "map"
+};
+
+typedef struct Heap {
+  uint32_t count;
+  uint32_t capacity;
+  uint8_t *types;
+  uint64_t *ids;
+  uint32_t *sizes;
+  uint64_t *ref_start;                 // Refs of object i are ref_start[i] until ref_start[i + 1]
+  uint64_t *ref_ids;
+  uint32_t *refs;                      // The same, as object indexes
+  uint64_t ref_count;
+  uint64_t ref_capacity;
+} Heap;
+
+static void fail(const char *message) {
+  printf("%s\n", message);
+  exit(1);
+}
+
+static void read_exactly(void *into, size_t size, size_t count, FILE *in) {
+  if (fread(into, size, count, in) != count) {
+    fail("Truncated heap dump");
+  }
+}
+
+static void read_dump(Heap *heap, FILE *in) {
+  char magic[HEAP_DUMP_MAGIC_SIZE];
+  if (fread(magic, 1, HEAP_DUMP_MAGIC_SIZE, in) != HEAP_DUMP_MAGIC_SIZE ||
+      memcmp(magic, HEAP_DUMP_MAGIC, HEAP_DUMP_MAGIC_SIZE) != 0) {
+    fail("Not a heap dump");
+  }
+
+  uint8_t type;
+  while (fread(&type, sizeof(type), 1, in) == 1) {
+    if (heap->count + 1 >= heap->capacity) {
+      heap->capacity = heap->capacity == 0 ? 1024 : heap->capacity * 2;
+      heap->types = realloc(heap->types, heap->capacity * sizeof(uint8_t));
+      heap->ids = realloc(heap->ids, heap->capacity * sizeof(uint64_t));
+      heap->sizes = realloc(heap->sizes, heap->capacity * sizeof(uint32_t));
+      heap->ref_start = realloc(heap->ref_start, heap->capacity * sizeof(uint64_t));
+    }
+
+    uint32_t n_refs;
+    uint32_t i = heap->count++;
+    if (type >= HEAP_DUMP_TYPE_COUNT) {
+      fail("Unknown object type in heap dump");
+    }
+    heap->types[i] = type;
+    read_exactly(&heap->ids[i], sizeof(uint64_t), 1, in);
+    read_exactly(&heap->sizes[i], sizeof(uint32_t), 1, in);
+    read_exactly(&n_refs, sizeof(uint32_t), 1, in);
+
+    while (heap->ref_count + n_refs > heap->ref_capacity) {
+      heap->ref_capacity = heap->ref_capacity == 0 ? 4096 : heap->ref_capacity * 2;
+      heap->ref_ids = realloc(heap->ref_ids, heap->ref_capacity * sizeof(uint64_t));
+    }
+    heap->ref_start[i] = heap->ref_count;
+    read_exactly(heap->ref_ids + heap->ref_count, sizeof(uint64_t), n_refs, in);
+    heap->ref_count += n_refs;
+  }
+
+  if (heap->count == 0 || heap->types[0] != HEAP_DUMP_ROOTS) {
+    fail("Heap dump does not start with its roots");
+  }
+  heap->ref_start[heap->count] = heap->ref_count;
+}
+
+static uint64_t slot_of(uint64_t id, uint64_t capacity) {
+  return (id * 0x9E3779B97F4A7C15ULL >> 17) & (capacity - 1);
+}
+
+// Replaces the ids that objects refer to with their indexes
+static void link_refs(Heap *heap) {
+  uint64_t capacity = 1024;
+  while (capacity < heap->count * 2ULL) {
+    capacity *= 2;
+  }
+
+  uint32_t *index_of = malloc(capacity * sizeof(uint32_t));
+  memset(index_of, 0xFF, capacity * sizeof(uint32_t));
+  for (uint32_t i = 1; i < heap->count; i++) {
+    uint64_t slot = slot_of(heap->ids[i], capacity);
+    while (index_of[slot] != NONE) {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    index_of[slot] = i;
+  }
+
+  heap->refs = malloc((heap->ref_count + 1) * sizeof(uint32_t));
+  for (uint64_t r = 0; r < heap->ref_count; r++) {
+    uint64_t slot = slot_of(heap->ref_ids[r], capacity);
+    while (index_of[slot] != NONE && heap->ids[index_of[slot]] != heap->ref_ids[r]) {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    if (index_of[slot] == NONE) {
+      fail("Heap dump refers to an object it does not contain");
+    }
+    heap->refs[r] = index_of[slot];
+  }
+
+  free(index_of);
+}
+
+// Reverse postorder from the roots, without recursion
+static uint32_t* reverse_postorder(Heap *heap, uint32_t *n_reached) {
+  uint32_t *order = malloc(heap->count * sizeof(uint32_t));
+  uint32_t *stack = malloc(heap->count * sizeof(uint32_t));
+  uint64_t *next_ref = malloc(heap->count * sizeof(uint64_t));
+  bool *visited = calloc(heap->count, sizeof(bool));
+  uint32_t depth = 0;
+  uint32_t done = 0;
+
+  stack[depth++] = 0;
+  visited[0] = true;
+  next_ref[0] = heap->ref_start[0];
+
+  while (depth > 0) {
+    uint32_t node = stack[depth - 1];
+
+    if (next_ref[node] < heap->ref_start[node + 1]) {
+      uint32_t child = heap->refs[next_ref[node]++];
+      if (!visited[child]) {
+        visited[child] = true;
+        next_ref[child] = heap->ref_start[child];
+        stack[depth++] = child;
+      }
+    } else {
+      order[done++] = node;
+      depth--;
+    }
+  }
+
+  for (uint32_t i = 0; i < done / 2; i++) {
+    uint32_t swap = order[i];
+    order[i] = order[done - 1 - i];
+    order[done - 1 - i] = swap;
+  }
+
+  free(stack);
+  free(next_ref);
+  free(visited);
+  *n_reached = done;
+  return order;
+}
+
+static uint32_t intersect(uint32_t *idom, uint32_t *rank, uint32_t a, uint32_t b) {
+  while (a != b) {
+    while (rank[a] > rank[b]) {
+      a = idom[a];
+    }
+    while (rank[b] > rank[a]) {
+      b = idom[b];
+    }
+  }
+  return a;
+}
+
+static uint32_t* dominators(Heap *heap, uint32_t *order, uint32_t n_reached) {
+  uint32_t *rank = malloc(heap->count * sizeof(uint32_t));
+  uint32_t *idom = malloc(heap->count * sizeof(uint32_t));
+  for (uint32_t i = 0; i < heap->count; i++) {
+    rank[i] = NONE;
+    idom[i] = NONE;
+  }
+  for (uint32_t i = 0; i < n_reached; i++) {
+    rank[order[i]] = i;
+  }
+
+  // Predecessors of every object
+  uint64_t *pred_start = calloc(heap->count + 1, sizeof(uint64_t));
+  uint32_t *preds = malloc((heap->ref_count + 1) * sizeof(uint32_t));
+  for (uint64_t r = 0; r < heap->ref_count; r++) {
+    pred_start[heap->refs[r] + 1]++;
+  }
+  for (uint32_t i = 0; i < heap->count; i++) {
+    pred_start[i + 1] += pred_start[i];
+  }
+  uint64_t *fill = malloc((heap->count + 1) * sizeof(uint64_t));
+  memcpy(fill, pred_start, (heap->count + 1) * sizeof(uint64_t));
+  for (uint32_t from = 0; from < heap->count; from++) {
+    for (uint64_t r = heap->ref_start[from]; r < heap->ref_start[from + 1]; r++) {
+      preds[fill[heap->refs[r]]++] = from;
+    }
+  }
+
+  idom[0] = 0;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+
+    for (uint32_t i = 1; i < n_reached; i++) {
+      uint32_t node = order[i];
+      uint32_t new_idom = NONE;
+
+      for (uint64_t p = pred_start[node]; p < pred_start[node + 1]; p++) {
+        uint32_t pred = preds[p];
+        if (idom[pred] == NONE) {
+          continue;
+        }
+        new_idom = new_idom == NONE ? pred : intersect(idom, rank, pred, new_idom);
+      }
+
+      if (idom[node] != new_idom) {
+        idom[node] = new_idom;
+        changed = true;
+      }
+    }
+  }
+
+  free(rank);
+  free(pred_start);
+  free(preds);
+  free(fill);
+  return idom;
+}
+
+static uint64_t *sort_retained;
+
+static int by_retained(const void *a, const void *b) {
+  uint64_t left = sort_retained[*(const uint32_t*) a];
+  uint64_t right = sort_retained[*(const uint32_t*) b];
+
+  return left < right ? 1 : left > right ? -1 : 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    printf("Usage: %s heap-dump [number of dominators to list]\n", argv[0]);
+    return 0;
+  }
+
+  uint32_t top = argc > 2 ? (uint32_t) atoi(argv[2]) : DEFAULT_TOP;
+  FILE *in = fopen(argv[1], "rb");
+  if (!in) {
+    fail("Could not open heap dump");
+  }
+
+  Heap heap;
+  memset(&heap, 0, sizeof(Heap));
+  read_dump(&heap, in);
+  fclose(in);
+  link_refs(&heap);
+
+  uint32_t n_reached;
+  uint32_t *order = reverse_postorder(&heap, &n_reached);
+  uint32_t *idom = dominators(&heap, order, n_reached);
+
+  // Dominated objects come after their dominators in reverse postorder
+  uint64_t *retained = calloc(heap.count, sizeof(uint64_t));
+  for (uint32_t i = n_reached; i-- > 1;) {
+    uint32_t node = order[i];
+    retained[node] += heap.sizes[node];
+    retained[idom[node]] += retained[node];
+  }
+
+  // Objects that are dominated by an object of their own type are already
+  // counted towards that one
+  uint8_t *dominating_types = calloc(heap.count, sizeof(uint8_t));
+  uint64_t count[HEAP_DUMP_TYPE_COUNT] = {0};
+  uint64_t shallow[HEAP_DUMP_TYPE_COUNT] = {0};
+  uint64_t retained_by[HEAP_DUMP_TYPE_COUNT] = {0};
+  uint64_t total = 0;
+  for (uint32_t i = 1; i < n_reached; i++) {
+    uint32_t node = order[i];
+    uint8_t type = heap.types[node];
+
+    dominating_types[node] = dominating_types[idom[node]] | (idom[node] == 0 ? 0 : 1 << heap.types[idom[node]]);
+    count[type]++;
+    shallow[type] += heap.sizes[node];
+    total += heap.sizes[node];
+    if (!(dominating_types[node] & (1 << type))) {
+      retained_by[type] += retained[node];
+    }
+  }
+
+  printf("%u objects, %llu bytes\n\n", n_reached - 1, (unsigned long long) total);
+  printf("%-12s %10s %12s %12s\n", "type", "count", "shallow", "retained");
+  for (uint32_t type = 1; type < HEAP_DUMP_TYPE_COUNT; type++) {
+    if (count[type] > 0) {
+      printf("%-12s %10llu %12llu %12llu\n", type_names[type],
+             (unsigned long long) count[type],
+             (unsigned long long) shallow[type],
+             (unsigned long long) retained_by[type]);
+    }
+  }
+
+  uint32_t n_objects = n_reached - 1;
+  sort_retained = retained;
+  qsort(order + 1, n_objects, sizeof(uint32_t), by_retained);
+  if (top > n_objects) {
+    top = n_objects;
+  }
+
+  printf("\n%-12s %18s %12s %12s  %s\n", "dominator", "id", "shallow", "retained", "dominated by");
+  for (uint32_t i = 1; i <= top; i++) {
+    uint32_t node = order[i];
+    uint32_t dominator = idom[node];
+
+    printf("%-12s %18llx %12u %12llu  ", type_names[heap.types[node]],
+           (unsigned long long) heap.ids[node], heap.sizes[node], (unsigned long long) retained[node]);
+    if (dominator == 0) {
+      printf("roots\n");
+    } else {
+      printf("%s %llx\n", type_names[heap.types[dominator]], (unsigned long long) heap.ids[dominator]);
+    }
+  }
+
+  free(order);
+  free(idom);
+  free(retained);
+  free(dominating_types);
+  free(heap.types);
+  free(heap.ids);
+  free(heap.sizes);
+  free(heap.ref_start);
+  free(heap.ref_ids);
+  free(heap.refs);
+  return 0;
+}
@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "util/string_search.h"
+
+// Times string_search, which String.contains?, index_of and split go through,
+// against strstr and against the memchr and memcmp loop that String.contains?
+// used before it, for haystacks and needles of several sizes.
+//
+// Text haystacks are made of words like those in log lines, and needles are
+// cut out of them with their last byte changed, so that they start like
+// something that is there but never match. Run haystacks repeat one byte, and
+// needles are made of it too apart from a different one in the middle, which
+// is as bad as it gets for comparing the bytes at every place the needle could
+// start. Every search goes through the whole haystack. Each cell is the
+// throughput in GB/s of haystack searched.
+//
+// Usage: string_search_bench [bytes to search per cell, default 256MB]
+
+#define DEFAULT_TOTAL (256ULL << 20)
+
+static const uint32_t haystack_sizes[] = {64, 1024, 64 << 10, 1 << 20};
+static const uint32_t needle_sizes[] = {2, 4, 8, 16, 32, 64, 256};
+
+#define N_HAYSTACKS (sizeof(haystack_sizes) / sizeof(haystack_sizes[0]))
+#define N_NEEDLES (sizeof(needle_sizes) / sizeof(needle_sizes[0]))
+
+typedef int64_t (*Search)(const char *haystack, uint32_t length, const char *needle, uint32_t needle_length);
+
+static int64_t search_strstr(const char *haystack, uint32_t length, const char *needle, uint32_t needle_length) {
+  (void) length;
+  (void) needle_length;
+  const char *found = strstr(haystack, needle);
+  return found ? found - haystack : -1;
+}
+
+static int64_t search_memchr(const char *haystack, uint32_t length, const char *needle, uint32_t needle_length) {
+  const char *at = haystack;
+  const char *last = haystack + (length - needle_length);
+
+  while (at <= last && (at = memchr(at, needle[0], last - at + 1)) != NULL) {
+    if (memcmp(at, needle, needle_length) == 0) {
+      return at - haystack;
+    }
+    at++;
+  }
+  return -1;
+}
+
+static const struct {
+  const char *name;
+  Search search;
+} searches[] = {
+  {"strstr", search_strstr},
+  {"memchr", search_memchr},
+  {"string_search", string_search},
+};
+
+#define N_SEARCHES (sizeof(searches) / sizeof(searches[0]))
+
+static const char *words[] = {
+  "GET", "POST", "/api/v1/users", "/static/app.js", "200", "404", "500", "INFO", "WARN",
+  "ERROR", "request", "completed", "in", "ms", "user_id=", "session", "timeout", "-", "[worker-3]",
+};
+
+#define N_WORDS (sizeof(words) / sizeof(words[0]))
+
+static char* make_text(uint32_t size) {
+  char *haystack = malloc(size + 1);
+  uint32_t at = 0;
+
+  while (at < size) {
+    const char *word = words[rand() % N_WORDS];
+    for (uint32_t i = 0; word[i] && at < size; i++) {
+      haystack[at++] = word[i];
+    }
+    if (at < size) {
+      haystack[at++] = rand() % 8 == 0 ? '\n' : ' ';
+    }
+  }
+  haystack[size] = '\0';
+  return haystack;
+}
+
+static char* make_run(uint32_t size) {
+  char *haystack = malloc(size + 1);
+  memset(haystack, 'a', size);
+  haystack[size] = '\0';
+  return haystack;
+}
+
+static char* make_needle(const char *haystack, uint32_t size, uint32_t needle_length, bool run) {
+  char *needle = malloc(needle_length + 1);
+
+  memcpy(needle, haystack + (size - needle_length) / 2, needle_length);
+  if (run) {
+    needle[needle_length / 2] = 'b';
+  } else {
+    needle[needle_length - 1] = '#';
+  }
+  needle[needle_length] = '\0';
+  return needle;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  uint64_t total = argc > 1 ? strtoull(argv[1], NULL, 10) : DEFAULT_TOTAL;
+  srand(42);
+
+  printf("%-5s %-10s %-8s", "kind", "haystack", "needle");
+  for (uint32_t s = 0; s < N_SEARCHES; s++) {
+    printf(" %14s", searches[s].name);
+  }
+  printf("\n");
+
+  for (uint32_t h = 0; h < 2 * N_HAYSTACKS; h++) {
+    bool run = h >= N_HAYSTACKS;
+    uint32_t size = haystack_sizes[h % N_HAYSTACKS];
+    char *haystack = run ? make_run(size) : make_text(size);
+
+    for (uint32_t n = 0; n < N_NEEDLES && needle_sizes[n] <= size; n++) {
+      uint32_t needle_length = needle_sizes[n];
+      char *needle = make_needle(haystack, size, needle_length, run);
+
+      printf("%-5s %-10u %-8u", run ? "run" : "text", size, needle_length);
+      for (uint32_t s = 0; s < N_SEARCHES; s++) {
+        uint64_t rounds = total / size + 1;
+        int64_t found = 0;
+
+        double started = now();
+        for (uint64_t r = 0; r < rounds; r++) {
+          found += searches[s].search(haystack, size, needle, needle_length);
+        }
+        double elapsed = now() - started;
+
+        if (found != -(int64_t) rounds) {
+          printf("\n%s found a needle that is not there\n", searches[s].name);
+          return 1;
+        }
+        printf(" %14.2f", rounds * size / elapsed / 1e9);
+      }
+      printf("\n");
+      free(needle);
+    }
+    free(haystack);
+  }
+
+  return 0;
+}